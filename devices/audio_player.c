@@ -2,7 +2,8 @@
 #include <stdint.h>
 #include <string.h>
 #include "ev3.h"
-#include "ev3_sound.h"
+#include "../program/audio_cache.h"
+#include "../program/event_loop.h"
 
 #ifdef __WIN32__
 #include <windows.h>
@@ -35,6 +36,31 @@ const char* get_button_name(uint8_t keys) {
     return NULL;
 }
 
+typedef struct {
+    evloop_t loop;
+    int clips[NUM_FILES];
+    int index;
+} player_t;
+
+static void on_button(void* ctx, uint8_t keys, uint8_t changed, uint64_t t_ns) {
+    player_t* p = ctx;
+    (void)t_ns;
+    if (!(keys & changed)) return;   // ignore releases
+
+    // Play sound on CENTER press: only queues the preloaded clip
+    if (changed & EV3_KEY_CENTER) {
+        printf("Playing: %s\n", audio_files[p->index]);
+        if (p->clips[p->index] >= 0) audio_play(p->clips[p->index]);
+        p->index = (p->index + 1) % NUM_FILES;
+    }
+
+    // Exit on BACK press
+    if (changed & EV3_KEY_BACK) {
+        printf("BACK button pressed. Exiting.\n");
+        evloop_stop(&p->loop);
+    }
+}
+
 int main(void) {
     printf("Initializing EV3...\n");
     if (ev3_init() < 1) {
@@ -42,35 +68,32 @@ int main(void) {
         return 1;
     }
 
-    uint8_t current_keys = 0;
-    uint8_t previous_keys = 0;
-    int index = 0;
+    // Decode every clip once, up front
+    player_t player = { .index = 0 };
+    if (!audio_init(NULL, 0, true)) {
+        printf("Failed to open the sound device.\n");
+        ev3_uninit();
+        return 1;
+    }
+    for (int i = 0; i < NUM_FILES; i++) {
+        player.clips[i] = audio_load_wav(audio_files[i]);
+    }
+
+    if (!evloop_init(&player.loop) || evloop_add_buttons(&player.loop, NULL, on_button, &player) < 0) {
+        printf("Failed to open the button device.\n");
+        evloop_close(&player.loop);
+        audio_shutdown();
+        ev3_uninit();
+        return 1;
+    }
 
     printf("*** Audio Player Started ***\n");
     printf("Press CENTER to play next sound, BACK to exit.\n");
+    evloop_run(&player.loop);
+    evloop_close(&player.loop);
 
-    while (1) {
-        ev3_read_keys(&current_keys);
-        uint8_t pressed_now = current_keys & ~previous_keys;
-
-        // Play sound on CENTER press
-        if (pressed_now & EV3_KEY_CENTER) {
-            printf("Playing: %s\n", audio_files[index]);
-            ev3_sound_file(audio_files[index], 100); // 100 = max volume
-
-            index = (index + 1) % NUM_FILES;
-        }
-
-        // Exit on BACK press
-        if (current_keys & EV3_KEY_BACK) {
-            printf("BACK button pressed. Exiting.\n");
-            break;
-        }
-
-        previous_keys = current_keys;
-        Sleep(50); // debounce
-    }
-
+    audio_print_stats(stdout);
+    audio_shutdown();
     ev3_uninit();
     printf("*** Audio Player Ended ***\n");
     return 0;
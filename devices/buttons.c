@@ -1,6 +1,9 @@
 #include <stdio.h>   // For printf for console output
 #include <string.h>  // Included for string operations, though not heavily used here
 #include "ev3.h"     // Core EV3 system functions, including button definitions
+#include "../program/event_loop.h" // epoll loop delivering evdev button events
+#include "../program/gestures.h"   // press / long-press / double-tap / chord recognizer
+#include <time.h>    // clock_gettime for gesture timing
 
 // For Sleep/usleep compatibility across different operating systems
 #ifdef __WIN32__
@@ -26,6 +29,76 @@ const char* get_button_name(uint8_t keys) {
     return NULL; // No single recognized button in the bitmask
 }
 
+// Everything the event-loop callbacks need.
+typedef struct {
+    evloop_t loop;
+    gesture_t gestures;
+    int timer;      // one-shot timer, armed for the next gesture deadline
+} button_monitor_t;
+
+/**
+ * @brief Prints every recognized gesture and stops the loop on a BACK press.
+ * Chords (several buttons pressed together) are reported with all their names.
+ */
+static void report_gestures(button_monitor_t* mon) {
+    gesture_event_t ev;
+    char names[48];
+    while (gesture_poll(&mon->gestures, &ev)) {
+        if (ev.type == GESTURE_RELEASE) continue;
+        printf("Button %s: %s (t=%u ms)\n", gesture_type_name(ev.type),
+               gesture_keys_name(ev.keys, names, sizeof(names)), ev.t_ms);
+
+        // Check for the exit condition: the BACK button was pressed.
+        if (ev.type == GESTURE_PRESS && (ev.keys & EV3_KEY_BACK)) {
+            printf("BACK button pressed. Exiting...\n");
+            evloop_stop(&mon->loop);
+        }
+    }
+}
+
+/**
+ * @brief Arms the timer for the next debounce or long-press timeout, or disarms
+ * it when nothing is pending, so an idle monitor is never woken up.
+ * @param now Current time in ms (same clock as the button events).
+ */
+static void arm_gesture_timer(button_monitor_t* mon, uint32_t now) {
+    uint32_t due, delay_us = 0; // 0 disarms the timer
+    if (gesture_next_deadline(&mon->gestures, &due)) {
+        int32_t ms = (int32_t)(due - now);
+        delay_us = ms >= 0 ? (uint32_t)(ms + 1) * 1000 : 1;
+    }
+    evloop_set_timer(&mon->loop, mon->timer, 0, delay_us);
+}
+
+/**
+ * @brief Called by the event loop whenever a button goes down or up.
+ * @param keys Bitmask of the buttons held after this event.
+ * @param t_ns Kernel timestamp of the event (CLOCK_MONOTONIC, ns).
+ */
+static void on_button(void* ctx, uint8_t keys, uint8_t changed, uint64_t t_ns) {
+    button_monitor_t* mon = ctx;
+    (void)changed;
+    uint32_t t_ms = (uint32_t)(t_ns / 1000000ull);
+    gesture_input(&mon->gestures, keys, t_ms);
+    report_gestures(mon);
+    arm_gesture_timer(mon, t_ms);
+}
+
+/**
+ * @brief One-shot timer: a debounce or long-press timeout is due without a new key event.
+ */
+static bool on_tick(void* ctx, uint64_t expirations) {
+    button_monitor_t* mon = ctx;
+    (void)expirations;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint32_t t_ms = (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+    gesture_tick(&mon->gestures, t_ms);
+    report_gestures(mon);
+    arm_gesture_timer(mon, t_ms);
+    return true;
+}
+
 int main(void) {
     printf("Waiting the EV3 brick online...\n");
     // Initialize the EV3 system. Returns 1 on success, < 1 on failure.
@@ -33,51 +106,24 @@ int main(void) {
         printf("ERROR: Failed to initialize EV3 system.\n");
         return 1;
     }
-    printf("*** ( EV3 ) Button Monitor Started! ***\n");
-    printf("Press any button to see its name. Press the BACK button to exit.\n");
-
-    uint8_t current_keys = 0;  // Stores the button state in the current iteration
-    uint8_t previous_keys = 0; // Stores the button state from the previous iteration
-    const char* button_name;   // To store the name of the pressed button
-
-    // Main loop: Continues indefinitely until the BACK button is pressed
-    while (1) {
-        // Read the current state of all EV3 buttons
-        // ev3_read_keys populates 'current_keys' with a bitmask where each bit
-        // corresponds to a button's pressed state.
-        ev3_read_keys(&current_keys);
-
-        // Detect which buttons were just pressed (edge detection).
-        // This calculates buttons that are currently down (current_keys)
-        // AND were not down in the previous iteration (~previous_keys).
-        uint8_t pressed_now = current_keys & ~previous_keys;
-
-        // If 'pressed_now' is not zero, at least one button was just pressed.
-        if (pressed_now != 0) {
-            button_name = get_button_name(pressed_now); // Get the name of the pressed button
 
-            if (button_name) {
-                printf("Button Pressed: %s\n", button_name);
-            } else {
-                // This case handles situations where multiple buttons might be pressed
-                // simultaneously in a way that doesn't match a single EV3_KEY_X constant.
-                printf("Button Pressed: Unknown combination (Raw bitmask: 0x%02X)\n", pressed_now);
-            }
-        }
-
-        // Check for the exit condition: If the BACK button is currently held down.
-        if (current_keys & EV3_KEY_BACK) {
-            printf("BACK button pressed. Exiting...\n");
-            break; // Exit the while loop
-        }
-
-        // Update previous_keys for the next iteration.
-        previous_keys = current_keys;
-
-        // Introduce a small delay to prevent busy-waiting and to debounce button presses.
-        // A 50ms delay is usually sufficient for button monitoring.
-        Sleep(50);
+    // Button presses arrive from the kernel input device through epoll,
+    // so there is no polling delay between a press and its handler.
+    button_monitor_t mon;
+    gesture_init(&mon.gestures, NULL);
+    if (!evloop_init(&mon.loop) || evloop_add_buttons(&mon.loop, NULL, on_button, &mon) < 0 ||
+        (mon.timer = evloop_add_timer(&mon.loop, 0, 0, on_tick, &mon)) < 0) {
+        printf("ERROR: Cannot open the button input device.\n");
+        evloop_close(&mon.loop);
+        ev3_uninit();
+        return 1;
     }
+    printf("*** ( EV3 ) Button Monitor Started! ***\n");
+    printf("Press, hold, double-tap or combine buttons. Press the BACK button to exit.\n");
+
+    // Main loop: sleeps in epoll until a button event arrives, runs until BACK.
+    evloop_run(&mon.loop);
+    evloop_close(&mon.loop);
 
     // Uninitialize the EV3 system and release resources.
     ev3_uninit();
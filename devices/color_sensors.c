@@ -9,6 +9,7 @@
 #include "ev3.h"
 #include "ev3_port.h"
 #include "ev3_sensor.h"
+#include "../program/sensor_modes.h"   // link with sensor_modes.c and histogram.c
 
 #ifdef __WIN32__
 #include <windows.h>
@@ -63,8 +64,10 @@ int main( void ) {
 
     if ( sn_color1 != SENSOR__NONE_ && sn_color2 != SENSOR__NONE_ ) {
         printf( "Both COLOR sensors found. Reading COLORS...\n" );
-        set_sensor_mode( sn_color1, "COL-COLOR" );
-        set_sensor_mode( sn_color2, "COL-COLOR" );
+        // Both switch at once (and not at all if already in COL-COLOR)
+        smode_request( sn_color1, "COL-COLOR" );
+        smode_request( sn_color2, "COL-COLOR" );
+        printf( "%d sensor(s) switched to COL-COLOR.\n", smode_apply());
 
         while ( !_check_pressed( sn_touch )) {
             if ( !get_sensor_value( 0, sn_color1, &val1 ) || val1 < 0 || val1 >= COLOR_COUNT ) val1 = 0;
@@ -78,7 +81,9 @@ int main( void ) {
         printf( "ERROR: Two COLOR sensors not found.\n" );
     }
 
+    printf( "\n" );
+    smode_print_stats( stdout );
     ev3_uninit();
-    printf( "\n*** ( EV3 ) Bye! ***\n" );
+    printf( "*** ( EV3 ) Bye! ***\n" );
     return ( 0 );
 }
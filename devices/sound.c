@@ -1,6 +1,21 @@
-#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "../program/audio_cache.h"
+#include "../program/speech.h"
+
+#define Sleep(ms) usleep((ms) * 1000)
 
 int main() {
-    system("espeak -s 140 -p 60 \"I am speaking slowly and clearly\"");
+    if (!audio_init(NULL, 0, false) || !speech_init(256 * 1024)) {
+        printf("Speech unavailable.\n");
+        return 1;
+    }
+
+    speech_say("I am speaking slowly and clearly", 140, 60);
+    while (speech_busy()) Sleep(20);
+
+    audio_shutdown();
+    speech_print_stats(stdout);
+    speech_shutdown();
     return 0;
 }
@@ -0,0 +1,444 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#ifndef AUDIO_NULL_OUTPUT
+#include <alsa/asoundlib.h>
+#endif
+#include "spsc_ring.h"
+#include "histogram.h"
+#include "timing.h"
+#include "logger.h"
+#include "audio_cache.h"
+
+#define AUDIO_PERIOD_FRAMES 256     // ~12 ms at 22050 Hz
+#define AUDIO_LATENCY_US    30000   // ALSA buffer target
+#define AUDIO_QUEUE_SLOTS   32
+#define AUDIO_IDLE_POLL_US  10000   // audio_wait_idle() check interval
+// Threads that trigger sounds: main, the speech worker and the navigator's
+// pipeline stages, with room to spare.
+#define AUDIO_MAX_PRODUCERS 8
+
+enum { REQ_PLAY, REQ_PLAY_BUFFER, REQ_STOP_ALL };
+
+typedef struct {
+    uint8_t cmd;
+    int16_t clip;
+    const int16_t* pcm;         // REQ_PLAY_BUFFER only
+    size_t frames;
+    audio_done_fn done;
+    void* ctx;
+    uint64_t t_ns;              // trigger time, for latency statistics
+} audio_req_t;
+
+typedef struct {
+    int16_t* pcm;
+    size_t frames;
+} audio_clip_t;
+
+typedef struct {
+    const int16_t* pcm;
+    size_t frames;
+    size_t pos;
+    uint64_t t_ns;
+    bool measured;
+    audio_done_fn done;
+    void* ctx;
+} audio_voice_t;
+
+typedef struct {
+    spsc_ring_t ring;
+    audio_req_t slots[AUDIO_QUEUE_SLOTS];
+    _Atomic bool ready;         // ring initialised; set once by its producer
+} audio_queue_t;
+
+static audio_clip_t clips[AUDIO_MAX_CLIPS];
+static int clip_count = 0;
+static audio_voice_t voices[AUDIO_MAX_VOICES];
+static audio_queue_t queues[AUDIO_MAX_PRODUCERS];
+static _Atomic int queue_count = 0;
+static _Thread_local audio_queue_t* my_queue = NULL;
+static _Thread_local bool my_queue_claimed = false;
+
+static unsigned out_rate = AUDIO_DEFAULT_RATE;
+static bool mixing = true;
+static _Atomic bool running = false;
+static pthread_t audio_thread;
+#ifndef AUDIO_NULL_OUTPUT
+static snd_pcm_t* pcm_handle = NULL;
+#endif
+
+static _Atomic uint64_t dropped = 0;
+static _Atomic uint64_t pushed = 0;         // requests queued, by all producers
+static _Atomic uint64_t taken = 0;          // requests the audio thread acted on
+static _Atomic int voices_playing = 0;      // as of the last period written
+static uint64_t underruns = 0;
+static histogram_t latency_hist;
+
+// ---------- WAV Decoding ----------
+static uint32_t rd_u32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t rd_u16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+// Linear-interpolating resampler into a new buffer at out_rate.
+int16_t* audio_resample(const int16_t* in, size_t frames, unsigned rate, size_t* out_frames) {
+    if (rate == out_rate) {
+        int16_t* copy = malloc(frames * sizeof(int16_t));
+        if (copy) memcpy(copy, in, frames * sizeof(int16_t));
+        *out_frames = frames;
+        return copy;
+    }
+    size_t n = (size_t)((uint64_t)frames * out_rate / rate);
+    int16_t* out = malloc((n ? n : 1) * sizeof(int16_t));
+    if (!out) return NULL;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t pos = (uint64_t)i * rate * 256 / out_rate;   // 8-bit fraction
+        size_t k = (size_t)(pos >> 8);
+        int frac = (int)(pos & 255);
+        int a = in[k];
+        int b = (k + 1 < frames) ? in[k + 1] : a;
+        out[i] = (int16_t)(a + (((b - a) * frac) >> 8));
+    }
+    *out_frames = n;
+    return out;
+}
+
+int audio_add_clip(const int16_t* pcm, size_t frames, unsigned rate) {
+    if (clip_count >= AUDIO_MAX_CLIPS || frames == 0 || rate == 0) return -1;
+    size_t n = 0;
+    int16_t* data = audio_resample(pcm, frames, rate, &n);
+    if (!data) return -1;
+    clips[clip_count].pcm = data;
+    clips[clip_count].frames = n;
+    return clip_count++;
+}
+
+int audio_load_wav(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        log_warn("audio: cannot open %s\n", path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* file = (size > 12) ? malloc((size_t)size) : NULL;
+    if (!file || fread(file, 1, (size_t)size, f) != (size_t)size ||
+        memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0) {
+        log_warn("audio: %s is not a RIFF/WAVE file\n", path);
+        free(file);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    uint16_t format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    const uint8_t* data = NULL;
+    uint32_t data_len = 0;
+    for (long off = 12; off + 8 <= size; ) {
+        uint32_t len = rd_u32(file + off + 4);
+        const uint8_t* body = file + off + 8;
+        if (off + 8 + (long)len > size) len = (uint32_t)(size - off - 8);
+        if (memcmp(file + off, "fmt ", 4) == 0 && len >= 16) {
+            format   = rd_u16(body);
+            channels = rd_u16(body + 2);
+            rate     = rd_u32(body + 4);
+            bits     = rd_u16(body + 14);
+        } else if (memcmp(file + off, "data", 4) == 0) {
+            data = body;
+            data_len = len;
+        }
+        off += 8 + len + (len & 1);
+    }
+    if (format != 1 || channels < 1 || (bits != 8 && bits != 16) || !data || rate == 0) {
+        log_warn("audio: %s: only 8/16-bit PCM WAV is supported\n", path);
+        free(file);
+        return -1;
+    }
+
+    // Down-mix to mono 16-bit.
+    size_t bytes_per_frame = (size_t)channels * (bits / 8);
+    size_t frames = data_len / bytes_per_frame;
+    int16_t* mono = malloc((frames ? frames : 1) * sizeof(int16_t));
+    if (!mono) {
+        free(file);
+        return -1;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        const uint8_t* fp = data + i * bytes_per_frame;
+        int32_t sum = 0;
+        for (int c = 0; c < channels; c++) {
+            sum += (bits == 16) ? (int16_t)rd_u16(fp + c * 2) : ((int)fp[c] - 128) * 256;
+        }
+        mono[i] = (int16_t)(sum / channels);
+    }
+    free(file);
+
+    int id = audio_add_clip(mono, frames, rate);
+    free(mono);
+    return id;
+}
+
+// ---------- Output ----------
+static bool output_open(const char* device) {
+#ifdef AUDIO_NULL_OUTPUT
+    (void)device;
+    return true;
+#else
+    int err = snd_pcm_open(&pcm_handle, device ? device : "default", SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0) {
+        log_error("audio: snd_pcm_open failed: %s\n", snd_strerror(err));
+        return false;
+    }
+    err = snd_pcm_set_params(pcm_handle, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+                             1, out_rate, 1, AUDIO_LATENCY_US);
+    if (err < 0) {
+        log_error("audio: snd_pcm_set_params failed: %s\n", snd_strerror(err));
+        snd_pcm_close(pcm_handle);
+        pcm_handle = NULL;
+        return false;
+    }
+    return true;
+#endif
+}
+
+// Writes one period; returns frames queued ahead of the speaker afterwards.
+static long output_write(const int16_t* buf, size_t frames) {
+#ifdef AUDIO_NULL_OUTPUT
+    static uint64_t next_ns = 0;
+    uint64_t period_ns = (uint64_t)frames * 1000000000ull / out_rate;
+    if (next_ns == 0) next_ns = now_ns();
+    next_ns += period_ns;
+    struct timespec ts = ns_to_timespec(next_ns);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    (void)buf;
+    return (long)frames;
+#else
+    size_t done = 0;
+    while (done < frames) {
+        snd_pcm_sframes_t n = snd_pcm_writei(pcm_handle, buf + done, frames - done);
+        if (n < 0) {
+            underruns++;
+            if (snd_pcm_recover(pcm_handle, (int)n, 1) < 0) return -1;
+            continue;
+        }
+        done += (size_t)n;
+    }
+    snd_pcm_sframes_t delay = 0;
+    if (snd_pcm_delay(pcm_handle, &delay) < 0) delay = (snd_pcm_sframes_t)frames;
+    return (long)delay;
+#endif
+}
+
+static void output_close(void) {
+#ifndef AUDIO_NULL_OUTPUT
+    if (pcm_handle) {
+        snd_pcm_drain(pcm_handle);
+        snd_pcm_close(pcm_handle);
+        pcm_handle = NULL;
+    }
+#endif
+}
+
+// ---------- Playback Thread ----------
+static void finish_voice(audio_voice_t* vc) {
+    if (vc->pcm && vc->done) vc->done(vc->ctx);
+    memset(vc, 0, sizeof(*vc));
+}
+
+static void finish_all_voices(void) {
+    for (int v = 0; v < AUDIO_MAX_VOICES; v++) finish_voice(&voices[v]);
+}
+
+static void start_voice(const audio_req_t* req) {
+    audio_voice_t voice = { .pcm = req->pcm, .frames = req->frames, .t_ns = req->t_ns,
+                            .done = req->done, .ctx = req->ctx };
+    if (req->cmd == REQ_PLAY) {
+        if (req->clip < 0 || req->clip >= clip_count) return;
+        voice.pcm = clips[req->clip].pcm;
+        voice.frames = clips[req->clip].frames;
+    }
+    int slot = 0;
+    if (mixing) {
+        // Free voice, else steal the one closest to finishing.
+        size_t least_left = (size_t)-1;
+        for (int v = 0; v < AUDIO_MAX_VOICES; v++) {
+            if (!voices[v].pcm) { slot = v; break; }
+            size_t left = voices[v].frames - voices[v].pos;
+            if (left < least_left) { least_left = left; slot = v; }
+        }
+        finish_voice(&voices[slot]);
+    } else {
+        finish_all_voices();
+    }
+    voices[slot] = voice;
+}
+
+static uint64_t requests_taken = 0;         // audio thread only; published as 'taken'
+
+static void take_requests(void) {
+    int count = atomic_load(&queue_count);
+    if (count > AUDIO_MAX_PRODUCERS) count = AUDIO_MAX_PRODUCERS;
+    audio_req_t req;
+    for (int q = 0; q < count; q++) {
+        if (!atomic_load_explicit(&queues[q].ready, memory_order_acquire)) continue;
+        while (spsc_pop(&queues[q].ring, &req)) {
+            if (req.cmd == REQ_STOP_ALL) finish_all_voices();
+            else                         start_voice(&req);
+            requests_taken++;
+        }
+    }
+}
+
+static void mix_period(int16_t* out, size_t frames) {
+    int32_t acc[AUDIO_PERIOD_FRAMES];
+    memset(acc, 0, sizeof(acc));
+    for (int v = 0; v < AUDIO_MAX_VOICES; v++) {
+        audio_voice_t* vc = &voices[v];
+        if (!vc->pcm) continue;
+        size_t n = vc->frames - vc->pos;
+        if (n > frames) n = frames;
+        for (size_t i = 0; i < n; i++) acc[i] += vc->pcm[vc->pos + i];
+        vc->pos += n;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        int32_t s = acc[i];
+        out[i] = (int16_t)(s > 32767 ? 32767 : (s < -32768 ? -32768 : s));
+    }
+}
+
+static void* audio_main(void* arg) {
+    (void)arg;
+    int16_t period[AUDIO_PERIOD_FRAMES];
+    // The stream runs continuously (silence when idle), so a trigger only
+    // waits for the next period plus the ALSA buffer.
+    while (atomic_load_explicit(&running, memory_order_acquire)) {
+        take_requests();
+        mix_period(period, AUDIO_PERIOD_FRAMES);
+        long delay = output_write(period, AUDIO_PERIOD_FRAMES);
+        if (delay < 0) break;
+
+        uint64_t now = now_ns();
+        long ahead = delay - AUDIO_PERIOD_FRAMES;   // frames before this period reaches the DAC
+        if (ahead < 0) ahead = 0;
+        for (int v = 0; v < AUDIO_MAX_VOICES; v++) {
+            audio_voice_t* vc = &voices[v];
+            if (!vc->pcm) continue;
+            if (!vc->measured) {
+                uint64_t out_ns = now + (uint64_t)ahead * 1000000000ull / out_rate;
+                hist_record(&latency_hist, out_ns - vc->t_ns);
+                vc->measured = true;
+            }
+            if (vc->pos >= vc->frames) finish_voice(vc);
+        }
+        // Voices first, so a waiter that sees all its requests taken also
+        // sees the voices they started.
+        int playing = 0;
+        for (int v = 0; v < AUDIO_MAX_VOICES; v++) playing += voices[v].pcm != NULL;
+        atomic_store_explicit(&voices_playing, playing, memory_order_relaxed);
+        atomic_store_explicit(&taken, requests_taken, memory_order_release);
+    }
+    // Release buffers still playing or queued at shutdown.
+    take_requests();
+    finish_all_voices();
+    output_close();
+    return NULL;
+}
+
+// ---------- Lifecycle ----------
+bool audio_init(const char* device, unsigned rate, bool mix) {
+    if (atomic_load(&running)) return true;
+    out_rate = rate ? rate : AUDIO_DEFAULT_RATE;
+    mixing = mix;
+    hist_reset(&latency_hist);
+    memset(voices, 0, sizeof(voices));
+    if (!output_open(device)) return false;
+    atomic_store(&running, true);
+    if (pthread_create(&audio_thread, NULL, audio_main, NULL) != 0) {
+        atomic_store(&running, false);
+        output_close();
+        return false;
+    }
+    return true;
+}
+
+void audio_shutdown(void) {
+    if (atomic_load(&running)) {
+        atomic_store(&running, false);
+        pthread_join(audio_thread, NULL);
+    }
+    for (int i = 0; i < clip_count; i++) free(clips[i].pcm);
+    clip_count = 0;
+}
+
+unsigned audio_rate(void) {
+    return out_rate;
+}
+
+// ---------- Playback Requests ----------
+static bool push_request(audio_req_t* req) {
+    if (!my_queue_claimed) {
+        my_queue_claimed = true;
+        int idx = atomic_fetch_add(&queue_count, 1);
+        if (idx < AUDIO_MAX_PRODUCERS) {
+            spsc_init(&queues[idx].ring, queues[idx].slots, sizeof(audio_req_t), AUDIO_QUEUE_SLOTS);
+            atomic_store_explicit(&queues[idx].ready, true, memory_order_release);
+            my_queue = &queues[idx];
+        } else {
+            log_warn("audio: more than %d threads play sounds, dropping this one's\n", AUDIO_MAX_PRODUCERS);
+        }
+    }
+    req->t_ns = now_ns();
+    if (!my_queue || !atomic_load_explicit(&running, memory_order_relaxed) ||
+        !spsc_push(&my_queue->ring, req)) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    atomic_fetch_add(&pushed, 1);
+    return true;
+}
+
+bool audio_play(int clip_id) {
+    if (clip_id < 0 || clip_id >= clip_count) return false;
+    audio_req_t req = { .cmd = REQ_PLAY, .clip = (int16_t)clip_id };
+    return push_request(&req);
+}
+
+bool audio_play_buffer(const int16_t* pcm, size_t frames, audio_done_fn done, void* ctx) {
+    if (!pcm || frames == 0) return false;
+    audio_req_t req = { .cmd = REQ_PLAY_BUFFER, .clip = -1, .pcm = pcm, .frames = frames,
+                        .done = done, .ctx = ctx };
+    return push_request(&req);
+}
+
+void audio_stop_all(void) {
+    audio_req_t req = { .cmd = REQ_STOP_ALL, .clip = -1 };
+    push_request(&req);
+}
+
+bool audio_wait_idle(uint32_t timeout_ms) {
+    uint64_t deadline = now_ns() + timeout_ms * 1000000ull;
+    while (atomic_load(&running)) {
+        uint64_t want = atomic_load(&pushed);
+        if (atomic_load_explicit(&taken, memory_order_acquire) >= want &&
+            atomic_load_explicit(&voices_playing, memory_order_relaxed) == 0) return true;
+        if (now_ns() >= deadline) return false;
+        struct timespec ts = { 0, AUDIO_IDLE_POLL_US * 1000L };
+        nanosleep(&ts, NULL);
+    }
+    return true;
+}
+
+// ---------- Statistics ----------
+uint64_t audio_dropped(void) {
+    return atomic_load(&dropped);
+}
+
+void audio_print_stats(FILE* out) {
+    fprintf(out, "--- Audio stats ---\n");
+    fprintf(out, "%d clips, %llu dropped requests, %llu underruns\n", clip_count,
+            (unsigned long long)audio_dropped(), (unsigned long long)underruns);
+    hist_print(&latency_hist, out, "trigger->sound", 1000, "us");
+}
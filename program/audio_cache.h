@@ -0,0 +1,53 @@
+#ifndef AUDIO_CACHE_H
+#define AUDIO_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Preloaded sound effects. Clips are decoded once at startup into 16-bit
+// mono PCM at the output rate; a dedicated thread plays them through ALSA.
+// audio_play() only pushes the clip id onto a lock-free queue and returns,
+// so control loops never wait on flash reads, decoding or the sound card.
+//
+// Build with -DAUDIO_NULL_OUTPUT to run without ALSA (PCM is discarded at
+// real-time pace), e.g. on a host.
+
+#define AUDIO_MAX_CLIPS     24
+#define AUDIO_MAX_VOICES    4       // clips that can overlap when mixing
+#define AUDIO_DEFAULT_RATE  22050
+
+// Called on the audio thread when a buffer passed to audio_play_buffer()
+// finished, was cut off, or was discarded at shutdown.
+typedef void (*audio_done_fn)(void* ctx);
+
+// --- Lifecycle ---
+// mix = false: a new clip cuts off the one playing instead of overlapping.
+bool audio_init(const char* device, unsigned rate, bool mix);
+void audio_shutdown(void);
+unsigned audio_rate(void);
+
+// --- Clips (call before audio_play from the control thread) ---
+int  audio_load_wav(const char* path);    // returns clip id, -1 on error
+int  audio_add_clip(const int16_t* pcm, size_t frames, unsigned rate);  // copies/resamples
+// Returns a malloc'd copy of 'in' converted to audio_rate().
+int16_t* audio_resample(const int16_t* in, size_t frames, unsigned rate, size_t* out_frames);
+
+// --- Playback (never blocks) ---
+bool audio_play(int clip_id);
+// Plays caller-owned PCM already at audio_rate(). The buffer must stay valid
+// until 'done' runs; if this returns false 'done' is never called.
+bool audio_play_buffer(const int16_t* pcm, size_t frames, audio_done_fn done, void* ctx);
+void audio_stop_all(void);
+
+// --- Draining (blocks; for shutdown, not control loops) ---
+// Waits until every request queued so far has finished playing, for at most
+// timeout_ms; returns false on timeout.
+bool audio_wait_idle(uint32_t timeout_ms);
+
+// --- Statistics ---
+uint64_t audio_dropped(void);             // requests lost because a queue was full
+void audio_print_stats(FILE* out);        // trigger-to-sound latency, underruns
+
+#endif // AUDIO_CACHE_H
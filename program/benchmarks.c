@@ -0,0 +1,747 @@
+// benchmarks.c
+// CPU-only micro-benchmarks for the control-path libraries. Needs no motors
+// or sensors, so it runs the same on the brick (ARM926EJ-S, 300 MHz) and on
+// a host for comparison. Usage: benchmarks [name ...] (default: all).
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "timing.h"
+#include "filters.h"
+#include "motion_profile.h"
+#include "explore.h"
+#include "dstar_lite.h"
+#include "route_cache.h"
+#include "localize.h"
+#include "tasks.h"
+#include "latency_stats.h"
+#include "trace.h"
+#include <pthread.h>
+#include <semaphore.h>
+
+#define BENCH_SAMPLES 200000
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} benchmark_t;
+
+static volatile int sink;
+static int inputs[4096];
+
+// Deterministic sensor-like input: slow ramp plus noise and rare spikes.
+static void make_inputs(void) {
+    uint32_t x = 12345;
+    for (int i = 0; i < 4096; i++) {
+        x = x * 1103515245u + 12345u;
+        int noise = (int)((x >> 16) % 21) - 10;
+        int spike = ((x >> 8) % 97 == 0) ? 2000 : 0;
+        inputs[i] = 300 + (i % 512) + noise + spike;
+    }
+}
+
+static void report(const char* name, uint64_t ns, long samples) {
+    printf("  %-28s %8.1f ns/sample\n", name, (double)ns / samples);
+}
+
+// ---------- Filters ----------
+static void bench_filters(void) {
+    printf("Filters (%d samples):\n", BENCH_SAMPLES);
+    int windows[] = { 3, 5, 9, 15 };
+    for (int w = 0; w < 4; w++) {
+        median_filter_t m;
+        median_init(&m, windows[w]);
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < BENCH_SAMPLES; i++) sink = median_update(&m, inputs[i & 4095]);
+        char label[32];
+        snprintf(label, sizeof(label), "median window %d", windows[w]);
+        report(label, now_ns() - t0, BENCH_SAMPLES);
+    }
+
+    ema_t e;
+    ema_init(&e, 3);
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BENCH_SAMPLES; i++) sink = ema_update(&e, inputs[i & 4095]);
+    report("ema shift 3", now_ns() - t0, BENCH_SAMPLES);
+
+    hysteresis_t h;
+    hysteresis_init(&h, 500, 600, false);
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_SAMPLES; i++) sink = hysteresis_update(&h, inputs[i & 4095]);
+    report("hysteresis", now_ns() - t0, BENCH_SAMPLES);
+
+    majority_t v;
+    majority_init(&v, 5);
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_SAMPLES; i++) sink = majority_update(&v, inputs[i & 4095] & 7);
+    report("majority window 5", now_ns() - t0, BENCH_SAMPLES);
+}
+
+// ---------- Motion Profiles ----------
+// Planning cost, and the time one grid tile (253 wheel degrees) takes per
+// profile and peak speed. The step profile at 200 deg/s is today's move.
+static void bench_motion(void) {
+    const int tile_deg = 253;
+    const int loops = 20000;
+    motion_limits_t lim = { 400, 1000, 8000 };
+    motion_profile_t p;
+
+    printf("Motion profiles:\n");
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < loops; i++) motion_plan_type(&p, tile_deg + (i & 63), &lim, PROFILE_SCURVE);
+    report("plan s-curve", now_ns() - t0, loops);
+    t0 = now_ns();
+    double acc = 0;
+    for (int i = 0; i < loops; i++) acc += motion_velocity_at(&p, (i % 1000) * p.total / 1000);
+    sink = (int)acc;
+    report("velocity_at s-curve", now_ns() - t0, loops);
+
+    printf("  Tile move (%d deg), a_max %d deg/s^2, j_max %d deg/s^3:\n", tile_deg, lim.a_max, lim.j_max);
+    printf("    %-10s %6s %6s %8s %8s\n", "profile", "v_max", "v_pk", "time ms", "vs step");
+    const double base = (double)tile_deg / 200;
+    const int speeds[] = { 200, 300, 400, 600 };
+    for (int type = PROFILE_STEP; type <= PROFILE_SCURVE; type++) {
+        for (int k = 0; k < 4; k++) {
+            lim.v_max = speeds[k];
+            motion_plan_type(&p, tile_deg, &lim, (profile_type_t)type);
+            printf("    %-10s %6d %6d %8.0f %7.0f%%\n", motion_profile_name(p.type), lim.v_max, p.v_peak,
+                   p.total * 1000, 100.0 * (p.total - base) / base);
+        }
+    }
+
+    // Straight runs: one profiled move over n tiles against n tile moves.
+    motion_limits_t tile = { 400, 1000, 8000 }, run = { 900, 1000, 8000 };
+    printf("  Straight runs (tile moves at %d, runs at %d deg/s peak):\n", tile.v_max, run.v_max);
+    printf("    %5s %10s %10s %10s\n", "tiles", "per-tile", "one run", "deg/s");
+    for (int n = 1; n <= 6; n++) {
+        motion_plan(&p, tile_deg, &tile);
+        double separate = n * p.total;
+        motion_plan(&p, n * tile_deg, &run);
+        printf("    %5d %8.0fms %8.0fms %10.0f\n", n, separate * 1000, p.total * 1000, n * tile_deg / p.total);
+    }
+}
+
+// ---------- Exploration ----------
+// Simulated missions on random mazes, timed with the navigator's move costs
+// (a profiled tile, tank_turn at 70 deg/s). The legacy policy is navigation_loop's "forward, else random
+// left/right, else turn around"; entering a dark tile costs a move plus the
+// reverse, as on the robot.
+#define SIM_MOVE_MS      1160
+#define SIM_TURN90_MS    2900
+#define SIM_TURN180_MS   5600
+#define SIM_BUMP_MS      (SIM_MOVE_MS + 700)
+#define SIM_MAX_MS       (4 * 3600 * 1000)
+
+typedef struct {
+    int w, h;
+    uint8_t* truth;             // CELL_FREE / CELL_BLOCKED
+    uint8_t* known;             // what the robot has seen
+    int x, y, dir;
+    int known_free, reachable;
+    uint64_t ms;
+    uint32_t rng;
+} sim_t;
+
+static const int sim_dx[4] = { 0, 1, 0, -1 };
+static const int sim_dy[4] = { 1, 0, -1, 0 };
+
+static uint32_t sim_rand(sim_t* s) {
+    s->rng = s->rng * 1103515245u + 12345u;
+    return s->rng >> 16;
+}
+
+static bool sim_in(const sim_t* s, int x, int y) {
+    return x >= 0 && x < s->w && y >= 0 && y < s->h;
+}
+
+// Free cells reachable from the start, by flood fill
+static int sim_reachable(const sim_t* s, int* stack) {
+    uint8_t* seen = calloc((size_t)s->w * s->h, 1);
+    int top = 0, count = 0;
+    stack[top++] = 0;
+    seen[0] = 1;
+    while (top > 0) {
+        int c = stack[--top];
+        count++;
+        for (int d = 0; d < 4; d++) {
+            int nx = c % s->w + sim_dx[d], ny = c / s->w + sim_dy[d];
+            int n = ny * s->w + nx;
+            if (sim_in(s, nx, ny) && !seen[n] && s->truth[n] == CELL_FREE) {
+                seen[n] = 1;
+                stack[top++] = n;
+            }
+        }
+    }
+    bool goal = seen[s->w * s->h - 1];
+    free(seen);
+    return goal ? count : -1;
+}
+
+// Random maze with the goal in the far corner reachable from the start
+static void sim_make(sim_t* s, int w, int h, uint32_t seed) {
+    s->w = w;
+    s->h = h;
+    s->rng = seed;
+    s->truth = malloc((size_t)w * h);
+    s->known = malloc((size_t)w * h);
+    int* stack = malloc((size_t)w * h * sizeof(int));
+    do {
+        for (int i = 0; i < w * h; i++) s->truth[i] = (sim_rand(s) % 100 < 25) ? CELL_BLOCKED : CELL_FREE;
+        s->truth[0] = s->truth[w * h - 1] = CELL_FREE;
+        s->reachable = sim_reachable(s, stack);
+    } while (s->reachable < 0);
+    free(stack);
+}
+
+static void sim_reset(sim_t* s, explorer_t* e) {
+    memset(s->known, CELL_UNKNOWN, (size_t)s->w * s->h);
+    s->known[0] = CELL_FREE;
+    s->x = s->y = s->dir = 0;
+    s->known_free = 1;
+    s->ms = 0;
+    if (e) explore_set_cell(e, 0, 0, CELL_FREE);
+}
+
+static void sim_turn_to(sim_t* s, int dir) {
+    int diff = (dir - s->dir + 4) % 4;
+    if (diff == 2) s->ms += SIM_TURN180_MS;
+    else if (diff != 0) s->ms += SIM_TURN90_MS;
+    s->dir = dir;
+}
+
+// One tile forward; returns false on a dark tile (the robot backs off).
+static bool sim_forward(sim_t* s, explorer_t* e) {
+    int nx = s->x + sim_dx[s->dir], ny = s->y + sim_dy[s->dir];
+    if (!sim_in(s, nx, ny)) return false;
+    int n = ny * s->w + nx;
+    if (s->known[n] == CELL_UNKNOWN) {
+        s->known[n] = s->truth[n];
+        if (s->truth[n] == CELL_FREE) s->known_free++;
+        if (e) explore_set_cell(e, nx, ny, s->truth[n]);
+    }
+    if (s->truth[n] == CELL_BLOCKED) {
+        s->ms += SIM_BUMP_MS;
+        return false;
+    }
+    s->ms += SIM_MOVE_MS;
+    s->x = nx;
+    s->y = ny;
+    return true;
+}
+
+static bool sim_open(const sim_t* s, int d) {
+    int nx = s->x + sim_dx[d], ny = s->y + sim_dy[d];
+    return sim_in(s, nx, ny) && s->known[ny * s->w + nx] != CELL_BLOCKED;
+}
+
+static bool sim_done(const sim_t* s, bool to_goal) {
+    if (to_goal) return s->x == s->w - 1 && s->y == s->h - 1;
+    return s->known_free == s->reachable;
+}
+
+static void sim_legacy(sim_t* s, bool to_goal) {
+    while (!sim_done(s, to_goal) && s->ms < SIM_MAX_MS) {
+        if (sim_open(s, s->dir)) {
+            if (!sim_forward(s, NULL)) sim_turn_to(s, (s->dir + 2) % 4);
+            continue;
+        }
+        bool l = sim_open(s, (s->dir + 3) % 4), r = sim_open(s, (s->dir + 1) % 4);
+        if (l && r) sim_turn_to(s, (s->dir + ((sim_rand(s) & 1) ? 1 : 3)) % 4);
+        else if (l) sim_turn_to(s, (s->dir + 3) % 4);
+        else if (r) sim_turn_to(s, (s->dir + 1) % 4);
+        else sim_turn_to(s, (s->dir + 2) % 4);
+        if (!sim_forward(s, NULL)) sim_turn_to(s, (s->dir + 2) % 4);
+    }
+}
+
+static void sim_frontier(sim_t* s, explorer_t* e, bool to_goal, uint64_t* decide_ns, long* decisions) {
+    while (!sim_done(s, to_goal) && s->ms < SIM_MAX_MS) {
+        int tiles = 0;
+        uint64_t t0 = now_ns();
+        int dir = explore_next_dir(e, s->x, s->y, s->dir, &tiles);
+        *decide_ns += now_ns() - t0;
+        (*decisions)++;
+        if (dir < 0) break;
+        sim_turn_to(s, dir);
+        for (int i = 0; i < tiles; i++) {
+            if (!sim_forward(s, e)) break;
+        }
+    }
+}
+
+static void bench_explore(void) {
+    const int sizes[] = { 4, 8, 16, 32 };
+    const int maps = 20;
+    const explore_costs_t costs = { SIM_MOVE_MS, SIM_TURN90_MS, SIM_TURN180_MS };
+    printf("Exploration (%d random maps per size, 25%% dark tiles, mean simulated minutes):\n", maps);
+    printf("    %5s %12s %12s %12s %12s %10s\n", "grid", "goal legacy", "goal front.", "cover legacy",
+           "cover front.", "us/decide");
+    for (int z = 0; z < 4; z++) {
+        int n = sizes[z];
+        double goal_l = 0, goal_f = 0, cover_l = 0, cover_f = 0;
+        int stuck_l = 0, stuck_f = 0;
+        uint64_t decide_ns = 0;
+        long decisions = 0;
+        for (int m = 0; m < maps; m++) {
+            sim_t s;
+            explorer_t e;
+            sim_make(&s, n, n, 1000u + (uint32_t)m * 7919u);
+            for (int goal = 1; goal >= 0; goal--) {
+                sim_reset(&s, NULL);
+                sim_legacy(&s, goal);
+                if (!sim_done(&s, goal)) stuck_l++;
+                *(goal ? &goal_l : &cover_l) += s.ms / 60000.0;
+
+                explore_init(&e, n, n, &costs);
+                if (goal) explore_set_goal(&e, n - 1, n - 1);
+                sim_reset(&s, &e);
+                sim_frontier(&s, &e, goal, &decide_ns, &decisions);
+                if (!sim_done(&s, goal)) stuck_f++;
+                *(goal ? &goal_f : &cover_f) += s.ms / 60000.0;
+                explore_free(&e);
+            }
+            free(s.truth);
+            free(s.known);
+        }
+        char grid[24];
+        snprintf(grid, sizeof(grid), "%dx%d", n, n);
+        printf("    %5s %12.1f %12.1f %12.1f %12.1f %10.1f\n", grid, goal_l / maps, goal_f / maps, cover_l / maps,
+               cover_f / maps, decisions ? decide_ns / 1000.0 / decisions : 0);
+        if (stuck_l || stuck_f) {
+            printf("          unfinished after %d min: legacy %d, frontier %d of %d runs\n", SIM_MAX_MS / 60000,
+                   stuck_l, stuck_f, 2 * maps);
+        }
+    }
+}
+
+// ---------- Replanning ----------
+// A robot drives to the far corner of a large grid that starts out unknown
+// (unknown counts as free) and learns each blocked cell when it tries to
+// enter it. After every reveal the route is repaired with D* Lite and, for
+// comparison, planned from scratch with A*; both must agree on the length.
+typedef struct {
+    int w, h;
+    int32_t* g;
+    uint32_t* stamp;
+    uint32_t search_id;
+    uint64_t* heap;             // (f << 32) | cell
+    int heap_len;
+    long expanded;
+} astar_t;
+
+static void astar_push(astar_t* a, uint64_t key) {
+    int i = a->heap_len++;
+    while (i > 0 && a->heap[(i - 1) / 2] > key) {
+        a->heap[i] = a->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    a->heap[i] = key;
+}
+
+static uint64_t astar_pop(astar_t* a) {
+    uint64_t top = a->heap[0], key = a->heap[--a->heap_len];
+    int i = 0;
+    while (true) {
+        int c = i * 2 + 1;
+        if (c >= a->heap_len) break;
+        if (c + 1 < a->heap_len && a->heap[c + 1] < a->heap[c]) c++;
+        if (key <= a->heap[c]) break;
+        a->heap[i] = a->heap[c];
+        i = c;
+    }
+    a->heap[i] = key;
+    return top;
+}
+
+// Shortest 4-connected path length from start to goal, -1 if none
+static int astar_plan(astar_t* a, const uint8_t* blocked, int start, int goal) {
+    const int dx[4] = { 0, 1, 0, -1 }, dy[4] = { 1, 0, -1, 0 };
+    int gx = goal % a->w, gy = goal / a->w;
+    a->search_id++;
+    a->heap_len = 0;
+    a->g[start] = 0;
+    a->stamp[start] = a->search_id;
+    astar_push(a, ((uint64_t)(abs(start % a->w - gx) + abs(start / a->w - gy)) << 32) | (uint32_t)start);
+    while (a->heap_len > 0) {
+        uint64_t top = astar_pop(a);
+        int c = (int)(uint32_t)top;
+        int h = abs(c % a->w - gx) + abs(c / a->w - gy);
+        if ((int)(top >> 32) != a->g[c] + h) continue;     // stale
+        a->expanded++;
+        if (c == goal) return a->g[c];
+        for (int d = 0; d < 4; d++) {
+            int nx = c % a->w + dx[d], ny = c / a->w + dy[d];
+            if (nx < 0 || nx >= a->w || ny < 0 || ny >= a->h) continue;
+            int n = ny * a->w + nx;
+            if (blocked[n]) continue;
+            int g = a->g[c] + 1;
+            if (a->stamp[n] == a->search_id && a->g[n] <= g) continue;
+            a->stamp[n] = a->search_id;
+            a->g[n] = g;
+            astar_push(a, ((uint64_t)(g + abs(nx - gx) + abs(ny - gy)) << 32) | (uint32_t)n);
+        }
+    }
+    return -1;
+}
+
+static void bench_replan(void) {
+    const int sizes[] = { 32, 64, 128, 256 };
+    printf("Replanning after each obstacle reveal (20%% blocked, robot drives to the far corner):\n");
+    printf("    %7s %7s %11s %11s %11s %11s %9s\n", "grid", "reveals", "D* mean us", "D* max us", "A* mean us",
+           "A* max us", "expand/A*");
+    for (int z = 0; z < 4; z++) {
+        int n = sizes[z], cells = n * n;
+        uint8_t* truth = malloc((size_t)cells);
+        uint8_t* known = calloc((size_t)cells, 1);
+        astar_t a = { .w = n, .h = n };
+        a.g = malloc((size_t)cells * sizeof(int32_t));
+        a.stamp = calloc((size_t)cells, sizeof(uint32_t));
+        a.heap = malloc((size_t)cells * 4 * sizeof(uint64_t));
+        uint32_t rng = 4242u + (uint32_t)n;
+        do {
+            for (int i = 0; i < cells; i++) {
+                rng = rng * 1103515245u + 12345u;
+                truth[i] = ((rng >> 16) % 100) < 20;
+            }
+            truth[0] = truth[cells - 1] = 0;
+        } while (astar_plan(&a, truth, 0, cells - 1) < 0);
+        a.expanded = 0;
+        dstar_t d;
+        dstar_init(&d, n, n, n - 1, n - 1);
+        dstar_set_start(&d, 0, 0);
+        dstar_plan(&d);
+
+        int x = 0, y = 0, dir = 0, reveals = 0, mismatches = 0;
+        uint64_t d_sum = 0, d_max = 0, a_sum = 0, a_max = 0;
+        long d_expanded = 0;
+        bool reachable = true;
+        while (!(x == n - 1 && y == n - 1)) {
+            int next = dstar_next_dir(&d, x, y, dir);
+            if (next < 0) {
+                reachable = false;
+                break;
+            }
+            int nx = x + sim_dx[next], ny = y + sim_dy[next];
+            if (truth[ny * n + nx]) {
+                known[ny * n + nx] = 1;
+                reveals++;
+                uint64_t t0 = now_ns();
+                dstar_set_blocked(&d, nx, ny, true);
+                bool ok = dstar_plan(&d);
+                uint64_t t1 = now_ns();
+                int full = astar_plan(&a, known, y * n + x, cells - 1);
+                uint64_t t2 = now_ns();
+                d_sum += t1 - t0;
+                a_sum += t2 - t1;
+                if (t1 - t0 > d_max) d_max = t1 - t0;
+                if (t2 - t1 > a_max) a_max = t2 - t1;
+                d_expanded += (long)d.last_expanded;
+                if ((ok ? dstar_distance(&d, x, y) : -1) != full) mismatches++;
+                continue;
+            }
+            x = nx;
+            y = ny;
+            dir = next;
+            dstar_set_start(&d, x, y);
+        }
+
+        char grid[24];
+        snprintf(grid, sizeof(grid), "%dx%d", n, n);
+        if (reveals > 0) {
+            printf("    %7s %7d %11.1f %11.1f %11.1f %11.1f %8.0f%%\n", grid, reveals, d_sum / 1000.0 / reveals,
+                   d_max / 1000.0, a_sum / 1000.0 / reveals, a_max / 1000.0, 100.0 * d_expanded / a.expanded);
+        }
+        if (!reachable) printf("            lost the route to the goal\n");
+        if (mismatches) printf("            %d route lengths differed from A*!\n", mismatches);
+        dstar_free(&d);
+        free(a.g);
+        free(a.stamp);
+        free(a.heap);
+        free(truth);
+        free(known);
+    }
+}
+
+// ---------- Route Cache ----------
+// Build time and memory of the all-pairs cache on fields with 20% blocked
+// tiles, route query cost, and how many target rows a single tile change
+// invalidates.
+static void bench_routes(void) {
+    const int sizes[] = { 16, 32, 64, 96 };
+    printf("Route cache (20%% blocked):\n");
+    printf("    %6s %6s %10s %10s %10s %10s %10s\n", "grid", "tiles", "build ms", "memory KB", "ns/hop",
+           "update us", "rows stale");
+    for (int z = 0; z < 4; z++) {
+        int n = sizes[z], cells = n * n;
+        uint8_t* field = malloc((size_t)cells);
+        uint32_t rng = 777u + (uint32_t)n;
+        for (int i = 0; i < cells; i++) {
+            rng = rng * 1103515245u + 12345u;
+            field[i] = ((rng >> 16) % 100) < 20 ? CELL_BLOCKED : CELL_FREE;
+        }
+        route_cache_t rc;
+        if (!route_cache_build(&rc, n, n, field)) {
+            printf("    %4dx%-4d out of memory\n", n, n);
+            free(field);
+            continue;
+        }
+
+        // Queries between random free tiles
+        static uint8_t dirs[1 << 16];
+        long hops = 0;
+        uint64_t t0 = now_ns();
+        for (int q = 0; q < 2000; q++) {
+            rng = rng * 1103515245u + 12345u;
+            int a = (int)((rng >> 8) % (uint32_t)cells);
+            rng = rng * 1103515245u + 12345u;
+            int b = (int)((rng >> 8) % (uint32_t)cells);
+            int len = route_cache_route(&rc, a % n, a / n, b % n, b / n, dirs, sizeof(dirs));
+            if (len > 0) hops += len;
+        }
+        uint64_t query_ns = now_ns() - t0;
+
+        // Single tiles turning dark, then back to free
+        const int changes = 20;
+        uint64_t before = rc.rows_invalidated;
+        t0 = now_ns();
+        for (int k = 0; k < changes; k++) {
+            rng = rng * 1103515245u + 12345u;
+            int c = (int)((rng >> 8) % (uint32_t)cells);
+            if (field[c] != CELL_FREE) continue;
+            route_cache_set_cell(&rc, c % n, c / n, CELL_BLOCKED);
+            route_cache_set_cell(&rc, c % n, c / n, CELL_FREE);
+        }
+        uint64_t update_ns = now_ns() - t0;
+        double stale = 100.0 * (rc.rows_invalidated - before) / (2.0 * changes) / rc.n;
+
+        char grid[24];
+        snprintf(grid, sizeof(grid), "%dx%d", n, n);
+        printf("    %6s %6d %10.1f %10zu %10.1f %10.1f %9.1f%%\n", grid, rc.n, rc.build_ns / 1e6,
+               route_cache_bytes(&rc) / 1024, hops ? (double)query_ns / hops : 0.0,
+               update_ns / 1000.0 / (2 * changes), stale);
+        route_cache_free(&rc);
+        free(field);
+    }
+}
+
+// ---------- Localization ----------
+// Cost of one move + observe step per particle count, then a simulated walk
+// over a stored 16x16 field where 5% of moves really go one tile short or
+// long: how often dead reckoning and the filter estimate are on the right
+// tile.
+#define LOC_SIM_STEPS 400
+
+static void bench_localize(void) {
+    const int n = 16, cells = n * n;
+    uint8_t field[16 * 16];
+    uint32_t rng = 4242u;
+    for (int i = 0; i < cells; i++) {
+        rng = rng * 1103515245u + 12345u;
+        field[i] = ((rng >> 16) % 100) < 25 ? CELL_BLOCKED : CELL_FREE;
+    }
+
+    const int counts[] = { 1024, 4096, 16384 };
+    printf("Localization (16x16 field, 25%% dark):\n");
+    printf("    %9s %12s %12s\n", "particles", "us/step", "ns/particle");
+    for (int k = 0; k < 3; k++) {
+        localizer_t l;
+        if (!localize_init(&l, n, n, field, counts[k])) continue;
+        localize_reset_at(&l, 0, 0, 1);
+        const int steps = 200;
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < steps; i++) {
+            localize_move(&l, 1);
+            localize_observe(&l, false);
+            if (i % 8 == 7) localize_turn(&l, 1);
+        }
+        uint64_t ns = now_ns() - t0;
+        printf("    %9d %12.1f %12.2f\n", counts[k], ns / 1000.0 / steps, (double)ns / steps / counts[k]);
+        localize_free(&l);
+    }
+
+    localizer_t l;
+    if (!localize_init(&l, n, n, field, 4096)) return;
+    int x = 0, y = 0, dir = 1;          // truth
+    int rx = 0, ry = 0, rdir = 1;       // dead reckoning
+    localize_reset_at(&l, 0, 0, 1);
+    int dead_right = 0, est_right = 0;
+    for (int i = 0; i < LOC_SIM_STEPS; i++) {
+        rng = rng * 1103515245u + 12345u;
+        int nx = x + sim_dx[dir], ny = y + sim_dy[dir];
+        if (!(nx >= 0 && nx < n && ny >= 0 && ny < n) || (rng >> 16) % 100 < 15) {
+            int q = ((rng >> 8) & 1) ? 1 : -1;  // wall ahead or a random turn
+            dir = (dir + q) & 3;
+            rdir = (rdir + q) & 3;
+            localize_turn(&l, q);
+        } else {
+            rng = rng * 1103515245u + 12345u;
+            uint32_t p = (rng >> 16) % 100;
+            int step = 1 - (p < LOC_MISCOUNT_PCT) + (p >= 100 - LOC_MISCOUNT_PCT);
+            x += sim_dx[dir] * step;
+            y += sim_dy[dir] * step;
+            x = x < 0 ? 0 : x >= n ? n - 1 : x;
+            y = y < 0 ? 0 : y >= n ? n - 1 : y;
+            rx += sim_dx[rdir];
+            ry += sim_dy[rdir];
+            rx = rx < 0 ? 0 : rx >= n ? n - 1 : rx;
+            ry = ry < 0 ? 0 : ry >= n ? n - 1 : ry;
+            localize_move(&l, 1);
+            // Noisy color reading of the tile actually under the robot
+            rng = rng * 1103515245u + 12345u;
+            float u = ((rng >> 8) % 10000) / 10000.0f;
+            float p_dark = field[y * n + x] == CELL_BLOCKED ? LOC_DARK_IF_BLOCKED : LOC_DARK_IF_FREE;
+            localize_observe(&l, u < p_dark);
+        }
+        int ex, ey, edir;
+        float conf;
+        dead_right += (rx == x && ry == y);
+        if (localize_estimate(&l, &ex, &ey, &edir, &conf)) est_right += (ex == x && ey == y);
+    }
+    printf("    %d-step walk, 4096 particles: on the right tile %.0f%% (dead reckoning) vs %.0f%% (filter)\n",
+           LOC_SIM_STEPS, 100.0 * dead_right / LOC_SIM_STEPS, 100.0 * est_right / LOC_SIM_STEPS);
+    localize_free(&l);
+}
+
+// ---------- Tasks ----------
+// Cost of a cooperative switch (TASK_YIELD through the scheduler heap) with
+// every task slot in use, against handing control between two threads with
+// semaphores, which is what a thread per behavior would cost.
+#define TASK_BENCH_YIELDS 20000
+
+typedef struct {
+    int left;
+} yield_ctx_t;
+
+static task_status_t yield_task(task_t* t, void* ctx) {
+    yield_ctx_t* y = ctx;
+    TASK_BEGIN(t);
+    while (y->left > 0) {
+        y->left--;
+        TASK_YIELD(t);
+    }
+    TASK_END(t);
+}
+
+typedef struct {
+    sem_t go[2];
+    int rounds;
+} pingpong_t;
+
+static void* pong_main(void* arg) {
+    pingpong_t* p = arg;
+    for (int i = 0; i < p->rounds; i++) {
+        sem_wait(&p->go[1]);
+        sem_post(&p->go[0]);
+    }
+    return NULL;
+}
+
+static void bench_tasks(void) {
+    printf("Cooperative tasks (%d tasks, %d yields each):\n", TASKS_MAX, TASK_BENCH_YIELDS);
+    tasks_t ts;
+    yield_ctx_t ctx[TASKS_MAX];
+    tasks_init(&ts);
+    for (int i = 0; i < TASKS_MAX; i++) {
+        ctx[i].left = TASK_BENCH_YIELDS;
+        tasks_add(&ts, "yield", yield_task, &ctx[i]);
+    }
+    uint64_t t0 = now_ns();
+    tasks_run(&ts);
+    report("task switch", now_ns() - t0, (long)ts.switches);
+
+    pingpong_t p = { .rounds = TASK_BENCH_YIELDS };
+    sem_init(&p.go[0], 0, 0);
+    sem_init(&p.go[1], 0, 0);
+    pthread_t th;
+    if (pthread_create(&th, NULL, pong_main, &p) != 0) return;
+    t0 = now_ns();
+    for (int i = 0; i < p.rounds; i++) {
+        sem_post(&p.go[1]);
+        sem_wait(&p.go[0]);
+    }
+    uint64_t ns = now_ns() - t0;
+    pthread_join(th, NULL);
+    report("thread handoff", ns, 2L * p.rounds);
+    sem_destroy(&p.go[0]);
+    sem_destroy(&p.go[1]);
+}
+
+// ---------- Latency probes ----------
+// What LAT_SCOPE adds to a wrapper: two clock reads and a histogram update.
+static __attribute__((noinline)) int bare_call(int v) {
+    sink = v;
+    return v + 1;
+}
+
+#ifdef LATENCY_STATS
+static __attribute__((noinline)) int probed_call(int v) {
+    LAT_SCOPE(motors_running);
+    sink = v;
+    return v + 1;
+}
+#endif
+
+static void bench_latency(void) {
+    printf("Latency probes (%d calls):\n", BENCH_SAMPLES);
+#ifdef LATENCY_STATS
+    int v = 0;
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BENCH_SAMPLES; i++) v = bare_call(v);
+    uint64_t bare = now_ns() - t0;
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_SAMPLES; i++) v = probed_call(v);
+    uint64_t probed = now_ns() - t0;
+    report("bare call", bare, BENCH_SAMPLES);
+    report("with LAT_SCOPE", probed, BENCH_SAMPLES);
+    lat_reset();
+#else
+    (void)bare_call;
+    printf("  built without -DLATENCY_STATS, nothing to measure\n");
+#endif
+}
+
+// ---------- Tracing ----------
+static __attribute__((noinline)) int traced_call(int v) {
+    TRACE_SCOPE("bench", "traced_call");
+    sink = v;
+    return v + 1;
+}
+
+static void bench_trace(void) {
+    printf("Trace spans (%d calls):\n", BENCH_SAMPLES);
+    int v = 0;
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BENCH_SAMPLES; i++) v = traced_call(v);
+    report("tracing off", now_ns() - t0, BENCH_SAMPLES);
+    trace_enable(true);
+    t0 = now_ns();
+    for (int i = 0; i < BENCH_SAMPLES; i++) v = traced_call(v);
+    report("tracing on", now_ns() - t0, BENCH_SAMPLES);
+    trace_enable(false);
+}
+
+static const benchmark_t benchmarks[] = {
+    { "filters", bench_filters },
+    { "motion", bench_motion },
+    { "explore", bench_explore },
+    { "replan", bench_replan },
+    { "routes", bench_routes },
+    { "localize", bench_localize },
+    { "tasks", bench_tasks },
+    { "latency", bench_latency },
+    { "trace", bench_trace },
+};
+static const int benchmark_count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+int main(int argc, char** argv) {
+    make_inputs();
+    for (int b = 0; b < benchmark_count; b++) {
+        bool selected = (argc < 2);
+        for (int a = 1; a < argc; a++) {
+            if (strcmp(argv[a], benchmarks[b].name) == 0) selected = true;
+        }
+        if (selected) benchmarks[b].run();
+    }
+    return 0;
+}
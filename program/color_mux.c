@@ -0,0 +1,298 @@
+#include <math.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "ev3.h"
+#include "ev3_sensor.h"
+#include "histogram.h"
+#include "sensor_modes.h"
+#include "tasks.h"
+#include "timing.h"
+#include "logger.h"
+#include "color_mux.h"
+
+typedef struct {
+    int value;
+    uint64_t t_ns;                      // 0 = no sample yet
+    uint64_t samples;
+    histogram_t gap;                    // ns between two samples
+} mux_reading_t;
+
+typedef struct {
+    uint8_t sn;
+    int index;
+    char name[16];
+    uint32_t phase_ms;                  // first switch after this long
+    int mode;                           // mode being visited
+    int left;                           // samples left in this visit
+    bool switched;                      // this visit needed a switch
+    uint64_t wait_start, switch_start;
+
+    uint32_t switches, failures, read_errors;
+    histogram_t settle;                 // ns from switch to first new value
+    histogram_t wait;                   // ns waiting for the switch window
+    mux_reading_t readings[COLOR_MUX_MAX_MODES];
+} mux_sensor_t;
+
+static struct {
+    color_mux_rate_t rates[COLOR_MUX_MAX_MODES];
+    int mode_count;
+    mux_sensor_t sensors[COLOR_MUX_MAX_SENSORS];
+    int sensor_count;
+    int switching;                      // sensor index holding the switch window, -1 = none
+
+    // Plan
+    uint64_t settle_ns;                 // settling time planned with
+    uint64_t frame_ns;                  // one visit to every mode
+    uint32_t interval_ms;               // between samples
+    int samples[COLOR_MUX_MAX_MODES];   // per visit, -1 = never leave
+    double scale;                       // < 1 when the rates did not fit
+    uint32_t switches;
+    histogram_t settle;                 // all sensors, for planning
+
+    uint64_t start_ns, stop_ns;
+    tasks_t tasks;
+    pthread_t thread;
+} mux;
+
+static _Atomic bool active = false;
+static _Atomic bool stop_requested = false;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;   // readings
+
+// ---------- Planning ----------
+static void plan(void) {
+    int n = mux.sensor_count, m = mux.mode_count;
+    if (m == 1) {
+        // Nothing to switch: sample at the wanted rate, capped by the sensor.
+        uint32_t hz = mux.rates[0].hz ? mux.rates[0].hz : 1;
+        mux.interval_ms = 1000 / hz > COLOR_MUX_SAMPLE_MS ? 1000 / hz : COLOR_MUX_SAMPLE_MS;
+        mux.samples[0] = -1;
+        mux.frame_ns = mux.interval_ms * 1000000ull;
+        mux.scale = 1.0;
+        return;
+    }
+
+    double busy = 0.0;                  // share of a frame spent sampling
+    for (int i = 0; i < m; i++) busy += mux.rates[i].hz * COLOR_MUX_SAMPLE_MS / 1000.0;
+    mux.scale = busy > COLOR_MUX_MAX_LOAD ? COLOR_MUX_MAX_LOAD / busy : 1.0;
+    busy *= mux.scale;
+
+    // The switches take m * S of each frame and the samples 'busy' of it;
+    // all sensors' switches, one at a time, must fit in it as well.
+    double settle = mux.settle_ns / 1e9;
+    double frame = m * settle / (1.0 - busy);
+    if (frame < n * m * settle) frame = n * m * settle;
+
+    uint64_t sampling_ns = 0;
+    for (int i = 0; i < m; i++) {
+        long k = lround(mux.rates[i].hz * mux.scale * frame);
+        mux.samples[i] = k > 0 ? (int)k : 1;
+        sampling_ns += (uint64_t)mux.samples[i] * COLOR_MUX_SAMPLE_MS * 1000000ull;
+    }
+    uint64_t switching_ns = (uint64_t)m * mux.settle_ns;
+    mux.frame_ns = switching_ns + sampling_ns;
+    if (mux.frame_ns < n * switching_ns) mux.frame_ns = n * switching_ns;
+    mux.interval_ms = COLOR_MUX_SAMPLE_MS;
+}
+
+// ---------- Mux Task ----------
+static bool begin_visit(mux_sensor_t* s) {
+    const char* mode = mux.rates[s->mode].mode;
+    const char* current = smode_current(s->sn);
+    s->switched = !current || strcmp(current, mode) != 0;
+    s->left = mux.samples[s->mode];
+    smode_request(s->sn, mode);
+    if (!s->switched) return true;
+    if (!smode_start(s->sn)) {
+        s->failures++;
+        s->mode = (s->mode + 1) % mux.mode_count;
+        return false;
+    }
+    mux.switching = s->index;
+    s->switch_start = now_ns();
+    return true;
+}
+
+static void end_switch(mux_sensor_t* s, uint64_t t) {
+    if (!s->switched) return;
+    mux.switching = -1;
+    hist_record(&s->settle, t - s->switch_start);
+    hist_record(&mux.settle, t - s->switch_start);
+    s->switches++;
+    if (++mux.switches % COLOR_MUX_REPLAN == 0) {
+        mux.settle_ns = hist_percentile(&mux.settle, 90.0);
+        plan();
+    }
+}
+
+static void take_sample(mux_sensor_t* s) {
+    int v;
+    if (!get_sensor_value(0, s->sn, &v)) {
+        s->read_errors++;
+        return;
+    }
+    uint64_t t = now_ns();
+    mux_reading_t* r = &s->readings[s->mode];
+    pthread_mutex_lock(&lock);
+    if (r->t_ns) hist_record(&r->gap, t - r->t_ns);
+    r->value = v;
+    r->t_ns = t;
+    r->samples++;
+    pthread_mutex_unlock(&lock);
+}
+
+static task_status_t mux_task(task_t* t, void* ctx) {
+    mux_sensor_t* s = ctx;
+    TASK_BEGIN(t);
+    TASK_SLEEP_MS(t, s->phase_ms);
+    while (!atomic_load(&stop_requested)) {
+        // One sensor switches at a time, so the sensors' gaps in their
+        // readings do not line up.
+        s->wait_start = t->now;
+        TASK_AWAIT(t, mux.switching < 0 || atomic_load(&stop_requested));
+        if (atomic_load(&stop_requested)) break;
+        hist_record(&s->wait, t->now - s->wait_start);
+        if (!begin_visit(s)) {
+            TASK_SLEEP_MS(t, COLOR_MUX_SAMPLE_MS);
+            continue;
+        }
+        TASK_AWAIT(t, smode_ready(s->sn));
+        end_switch(s, t->now);
+        do {
+            take_sample(s);
+            TASK_SLEEP_MS(t, mux.interval_ms);
+        } while (--s->left != 0 && !atomic_load(&stop_requested));
+        s->mode = (s->mode + 1) % mux.mode_count;
+    }
+    if (mux.switching == s->index) mux.switching = -1;
+    TASK_END(t);
+}
+
+static void* mux_thread(void* arg) {
+    (void)arg;
+    tasks_run(&mux.tasks);
+    return NULL;
+}
+
+// ---------- Lifecycle ----------
+bool color_mux_start(const uint8_t* sn, int sensor_count, const color_mux_rate_t* rates, int rate_count) {
+    if (atomic_load(&active)) color_mux_stop();
+    if (sensor_count < 1 || rate_count < 1) return false;
+    if (sensor_count > COLOR_MUX_MAX_SENSORS) sensor_count = COLOR_MUX_MAX_SENSORS;
+    if (rate_count > COLOR_MUX_MAX_MODES) rate_count = COLOR_MUX_MAX_MODES;
+
+    memset(&mux, 0, sizeof(mux));
+    memcpy(mux.rates, rates, rate_count * sizeof(rates[0]));
+    mux.mode_count = rate_count;
+    mux.sensor_count = sensor_count;
+    mux.switching = -1;
+    mux.settle_ns = SMODE_SETTLE_MAX_MS * 1000000ull;   // until switches are measured
+    plan();
+    if (mux.scale < 1.0) {
+        log_warn("color mux: rates scaled to %.0f%% to fit the switches\n", 100.0 * mux.scale);
+    }
+
+    tasks_init(&mux.tasks);
+    for (int i = 0; i < sensor_count; i++) {
+        mux_sensor_t* s = &mux.sensors[i];
+        s->sn = sn[i];
+        s->index = i;
+        s->phase_ms = (uint32_t)(mux.frame_ns / 1000000ull * i / sensor_count);
+        snprintf(s->name, sizeof(s->name), "color mux %d", i);
+        int id = tasks_add(&mux.tasks, s->name, mux_task, s);
+        tasks_set_poll(&mux.tasks, id, SMODE_POLL_US);
+    }
+
+    atomic_store(&stop_requested, false);
+    mux.start_ns = now_ns();
+    if (pthread_create(&mux.thread, NULL, mux_thread, NULL) != 0) return false;
+    atomic_store(&active, true);
+    return true;
+}
+
+void color_mux_stop(void) {
+    if (!atomic_load(&active)) return;
+    atomic_store(&stop_requested, true);
+    pthread_join(mux.thread, NULL);
+    mux.stop_ns = now_ns();
+    atomic_store(&active, false);
+}
+
+bool color_mux_active(void) {
+    return atomic_load(&active);
+}
+
+// ---------- Readings ----------
+static mux_reading_t* find_reading(uint8_t sn, const char* mode) {
+    for (int i = 0; i < mux.sensor_count; i++) {
+        if (mux.sensors[i].sn != sn) continue;
+        for (int m = 0; m < mux.mode_count; m++) {
+            if (strcmp(mux.rates[m].mode, mode) == 0) return &mux.sensors[i].readings[m];
+        }
+    }
+    return NULL;
+}
+
+bool color_mux_read(uint8_t sn, const char* mode, int* value, uint32_t* age_ms) {
+    mux_reading_t* r = find_reading(sn, mode);
+    if (!r) return false;
+    pthread_mutex_lock(&lock);
+    uint64_t t = r->t_ns;
+    if (t) *value = r->value;
+    pthread_mutex_unlock(&lock);
+    if (!t) return false;
+    if (age_ms) *age_ms = (uint32_t)((now_ns() - t) / 1000000ull);
+    return true;
+}
+
+// ---------- Statistics ----------
+static double run_seconds(void) {
+    uint64_t end = atomic_load(&active) ? now_ns() : mux.stop_ns;
+    return end > mux.start_ns ? (end - mux.start_ns) / 1e9 : 0.0;
+}
+
+double color_mux_rate(uint8_t sn, const char* mode) {
+    mux_reading_t* r = find_reading(sn, mode);
+    double secs = run_seconds();
+    if (!r || secs <= 0.0) return 0.0;
+    pthread_mutex_lock(&lock);
+    uint64_t samples = r->samples;
+    pthread_mutex_unlock(&lock);
+    return samples / secs;
+}
+
+uint64_t color_mux_gap(uint8_t sn, const char* mode, double pct) {
+    mux_reading_t* r = find_reading(sn, mode);
+    if (!r) return 0;
+    pthread_mutex_lock(&lock);
+    uint64_t gap = hist_percentile(&r->gap, pct);
+    pthread_mutex_unlock(&lock);
+    return gap;
+}
+
+void color_mux_print_stats(FILE* out) {
+    fprintf(out, "--- Color mux ---\n");
+    if (mux.sensor_count == 0) return;
+    fprintf(out, "%d sensors x %d modes, frame %.1f ms, settling %.1f ms planned", mux.sensor_count,
+            mux.mode_count, mux.frame_ns / 1e6, mux.settle_ns / 1e6);
+    if (mux.scale < 1.0) fprintf(out, ", rates scaled to %.0f%%", 100.0 * mux.scale);
+    fprintf(out, "\n");
+    for (int i = 0; i < mux.sensor_count; i++) {
+        const mux_sensor_t* s = &mux.sensors[i];
+        fprintf(out, "sensor %d: %u switches, %u failed, %u read errors\n", s->sn, s->switches, s->failures,
+                s->read_errors);
+        if (s->switches) {
+            hist_print(&s->settle, out, "  settle", 1000000, "ms");
+            hist_print(&s->wait, out, "  switch wait", 1000000, "ms");
+        }
+        for (int m = 0; m < mux.mode_count; m++) {
+            fprintf(out, "  %-12s %u Hz wanted, %.1f Hz achieved", mux.rates[m].mode, mux.rates[m].hz,
+                    color_mux_rate(s->sn, mux.rates[m].mode));
+            if (mux.samples[m] > 0) fprintf(out, " (%d per visit)", mux.samples[m]);
+            fprintf(out, "\n");
+            pthread_mutex_lock(&lock);
+            hist_print(&s->readings[m].gap, out, "    gap", 1000000, "ms");
+            pthread_mutex_unlock(&lock);
+        }
+    }
+}
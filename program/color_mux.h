@@ -0,0 +1,59 @@
+#ifndef COLOR_MUX_H
+#define COLOR_MUX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Color sensor mode multiplexer. An EV3 color sensor reports one mode at a
+// time, so getting both the color class and the reflected intensity from
+// one sensor means switching back and forth. The mux does that on a
+// background thread: each sensor visits its modes in turn, switches (and
+// waits for the first value from the new mode, see sensor_modes.h), then
+// takes that mode's share of samples before moving on.
+//
+// Planning, per frame (one visit to every mode):
+// - a mode with rate r gets round(r * F) samples, COLOR_MUX_SAMPLE_MS apart;
+// - each visit first costs one settling time S, learned from the switches
+//   made so far (p90), starting from SMODE_SETTLE_MAX_MS;
+// - only one sensor is switching at any time, and sensors start F/N apart,
+//   so with N sensors and M modes the frame is at least N * M * S long.
+// If the samples alone would fill more than COLOR_MUX_MAX_LOAD of the
+// frame, the rates are scaled down to fit.
+//
+// While the mux runs it owns the sensors: read them with color_mux_read(),
+// not get_color_value() or get_reflect_value(). Mode strings must be
+// string literals (as for smode_request()).
+
+#define COLOR_MUX_MAX_SENSORS   4
+#define COLOR_MUX_MAX_MODES     3
+#define COLOR_MUX_SAMPLE_MS     10      // the sensor's update period
+#define COLOR_MUX_MAX_LOAD      0.8     // share of a frame spent sampling
+#define COLOR_MUX_REPLAN        8       // re-plan after this many switches
+
+typedef struct {
+    const char* mode;                   // e.g. "COL-COLOR"
+    uint32_t hz;                        // wanted samples per second
+} color_mux_rate_t;
+
+// --- Lifecycle ---
+// Multiplexes the same set of modes on every sensor given.
+bool color_mux_start(const uint8_t* sn, int sensor_count, const color_mux_rate_t* rates, int rate_count);
+// Joins the mux thread: up to one sample interval, start phase or switch.
+void color_mux_stop(void);
+bool color_mux_active(void);
+
+// --- Readings ---
+// Latest value of 'mode' from sensor sn and its age; false if none yet.
+bool color_mux_read(uint8_t sn, const char* mode, int* value, uint32_t* age_ms);
+
+// --- Statistics ---
+// Samples per second of 'mode' from sensor sn since the start.
+double   color_mux_rate(uint8_t sn, const char* mode);
+// Percentile of the time between two samples of 'mode', in ns.
+uint64_t color_mux_gap(uint8_t sn, const char* mode, double pct);
+// Frame plan, then per sensor: switches, settling and waits for the switch
+// window, and per mode wanted vs achieved rate and sample gaps.
+void color_mux_print_stats(FILE* out);
+
+#endif // COLOR_MUX_H
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "ev3.h"
+#include "ev3_sensor.h"
+#include "ev3_tacho.h"
+#include "timing.h"
+#include "logger.h"
+#include "sensor_modes.h"
+#include "discovery.h"
+
+#ifndef SENSOR_CLASS_DIR
+#define SENSOR_CLASS_DIR "/sys/class/lego-sensor"
+#define TACHO_CLASS_DIR  "/sys/class/tacho-motor"
+#endif
+#define MANIFEST_VERSION 2
+#define NAME_LEN 32
+#define BOOT_ID_FILE "/proc/sys/kernel/random/boot_id"
+
+typedef struct {
+    char address[NAME_LEN];
+    char driver[NAME_LEN];
+    char mode[NAME_LEN];        // sensors only, "" = unknown
+} device_info_t;
+
+static device_info_t sensor_info[SENSOR_DESC__LIMIT_];
+static device_info_t tacho_info[TACHO_DESC__LIMIT_];
+static char manifest[128];
+static char boot_id[40];        // "" = unknown, recorded modes never trusted
+static bool modes_dirty = false;
+static uint64_t discovery_ns = 0;
+static discovery_result_t last_result = DISCOVERY_FAILED;
+
+// Number of "<prefix>N" entries in a sysfs class directory.
+static int count_class_entries(const char* dir, const char* prefix) {
+    DIR* d = opendir(dir);
+    if (!d) return -1;
+    int count = 0;
+    size_t len = strlen(prefix);
+    struct dirent* de;
+    while ((de = readdir(d)) != NULL) {
+        if (strncmp(de->d_name, prefix, len) == 0) count++;
+    }
+    closedir(d);
+    return count;
+}
+
+static void copy_name(char* dst, const char* src) {
+    snprintf(dst, NAME_LEN, "%s", (src && *src) ? src : "-");
+}
+
+// Sensors come up in their default mode after a reboot, so recorded modes
+// only carry over within one boot.
+static void read_boot_id(void) {
+    boot_id[0] = '\0';
+    FILE* f = fopen(BOOT_ID_FILE, "r");
+    if (!f) return;
+    if (fscanf(f, "%39s", boot_id) != 1) boot_id[0] = '\0';
+    fclose(f);
+}
+
+// ---------- Manifest ----------
+static bool manifest_save(void) {
+    char tmp[sizeof(manifest) + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", manifest);
+    FILE* f = fopen(tmp, "w");
+    if (!f) {
+        log_warn("discovery: cannot write %s\n", tmp);
+        return false;
+    }
+    fprintf(f, "# ev3 device manifest\nv %d\nb %s\n", MANIFEST_VERSION, boot_id[0] ? boot_id : "-");
+    for (int sn = 0; sn < SENSOR_DESC__LIMIT_; sn++) {
+        const EV3_SENSOR* s = &ev3_sensor[sn];
+        if (s->type_inx == SENSOR_TYPE__NONE_) continue;
+        const device_info_t* d = &sensor_info[sn];
+        fprintf(f, "S %d %d %d %d %d %s %s %s\n", sn, s->type_inx, s->port, s->extport, s->addr,
+                d->address, d->driver, d->mode[0] ? d->mode : "-");
+    }
+    for (int sn = 0; sn < TACHO_DESC__LIMIT_; sn++) {
+        const EV3_TACHO* t = &ev3_tacho[sn];
+        if (t->type_inx == TACHO_TYPE__NONE_) continue;
+        const device_info_t* d = &tacho_info[sn];
+        fprintf(f, "T %d %d %d %d %s %s\n", sn, t->type_inx, t->port, t->extport, d->address, d->driver);
+    }
+    bool ok = (fclose(f) == 0) && rename(tmp, manifest) == 0;
+    if (ok) modes_dirty = false;
+    return ok;
+}
+
+// Loads the manifest into ev3_sensor[]/ev3_tacho[] and checks every entry
+// against sysfs. Returns false (tables undefined) on any mismatch.
+static bool manifest_load_and_check(void) {
+    FILE* f = fopen(manifest, "r");
+    if (!f) return false;
+
+    memset(ev3_sensor, 0, sizeof(EV3_SENSOR) * SENSOR_DESC__LIMIT_);
+    memset(ev3_tacho, 0, sizeof(EV3_TACHO) * TACHO_DESC__LIMIT_);
+    for (int i = 0; i < SENSOR_DESC__LIMIT_; i++) ev3_sensor[i].type_inx = SENSOR_TYPE__NONE_;
+    for (int i = 0; i < TACHO_DESC__LIMIT_; i++) ev3_tacho[i].type_inx = TACHO_TYPE__NONE_;
+
+    char line[256], kind, boot[40];
+    int version = 0, sensors = 0, tachos = 0;
+    bool ok = true, same_boot = false;
+    while (ok && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        int sn, type, port, extport, addr;
+        char address[NAME_LEN], driver[NAME_LEN], mode[NAME_LEN], actual[NAME_LEN];
+        if (sscanf(line, "v %d", &version) == 1) {
+            ok = (version == MANIFEST_VERSION);
+        } else if (sscanf(line, "b %39s", boot) == 1) {
+            same_boot = boot_id[0] && strcmp(boot, boot_id) == 0;
+        } else if (sscanf(line, "%c %d %d %d %d %d %31s %31s %31s", &kind, &sn, &type, &port, &extport,
+                          &addr, address, driver, mode) == 9 && kind == 'S') {
+            ok = sn >= 0 && sn < SENSOR_DESC__LIMIT_ &&
+                 get_sensor_address((uint8_t)sn, actual, sizeof(actual)) > 0 && strcmp(actual, address) == 0 &&
+                 get_sensor_driver_name((uint8_t)sn, actual, sizeof(actual)) > 0 && strcmp(actual, driver) == 0;
+            if (ok) {
+                ev3_sensor[sn] = (EV3_SENSOR){ .type_inx = (INX_T)type, .port = (uint8_t)port,
+                                               .extport = (uint8_t)extport, .addr = (uint8_t)addr };
+                copy_name(sensor_info[sn].address, address);
+                copy_name(sensor_info[sn].driver, driver);
+                snprintf(sensor_info[sn].mode, NAME_LEN, "%s", strcmp(mode, "-") ? mode : "");
+                sensors++;
+            }
+        } else if (sscanf(line, "%c %d %d %d %d %31s %31s", &kind, &sn, &type, &port, &extport,
+                          address, driver) == 7 && kind == 'T') {
+            ok = sn >= 0 && sn < TACHO_DESC__LIMIT_ &&
+                 get_tacho_address((uint8_t)sn, actual, sizeof(actual)) > 0 && strcmp(actual, address) == 0 &&
+                 get_tacho_driver_name((uint8_t)sn, actual, sizeof(actual)) > 0 && strcmp(actual, driver) == 0;
+            if (ok) {
+                ev3_tacho[sn] = (EV3_TACHO){ .type_inx = (INX_T)type, .port = (uint8_t)port,
+                                             .extport = (uint8_t)extport };
+                copy_name(tacho_info[sn].address, address);
+                copy_name(tacho_info[sn].driver, driver);
+                tachos++;
+            }
+        } else {
+            ok = false;
+        }
+    }
+    fclose(f);
+
+    // The mapping survives a reboot, the modes do not.
+    if (ok && !same_boot) {
+        for (int sn = 0; sn < SENSOR_DESC__LIMIT_; sn++) sensor_info[sn].mode[0] = '\0';
+        modes_dirty = true;         // rewrite with this boot's id
+    }
+
+    // A device plugged in since the manifest was written.
+    return ok && version == MANIFEST_VERSION &&
+           count_class_entries(SENSOR_CLASS_DIR, "sensor") == sensors &&
+           count_class_entries(TACHO_CLASS_DIR, "motor") == tachos;
+}
+
+// Full scan through ev3dev-c, then records what is needed for the next check.
+static bool scan_devices(void) {
+    int sensors = ev3_sensor_init();
+    int tachos = ev3_tacho_init();
+    if (sensors < 0 || tachos < 0) return false;
+
+    char buf[NAME_LEN];
+    for (int sn = 0; sn < SENSOR_DESC__LIMIT_; sn++) {
+        device_info_t* d = &sensor_info[sn];
+        memset(d, 0, sizeof(*d));
+        if (ev3_sensor[sn].type_inx == SENSOR_TYPE__NONE_) continue;
+        copy_name(d->address, get_sensor_address((uint8_t)sn, buf, sizeof(buf)) ? buf : NULL);
+        copy_name(d->driver, get_sensor_driver_name((uint8_t)sn, buf, sizeof(buf)) ? buf : NULL);
+        if (get_sensor_mode((uint8_t)sn, buf, sizeof(buf))) snprintf(d->mode, NAME_LEN, "%s", buf);
+    }
+    for (int sn = 0; sn < TACHO_DESC__LIMIT_; sn++) {
+        device_info_t* d = &tacho_info[sn];
+        memset(d, 0, sizeof(*d));
+        if (ev3_tacho[sn].type_inx == TACHO_TYPE__NONE_) continue;
+        copy_name(d->address, get_tacho_address((uint8_t)sn, buf, sizeof(buf)) ? buf : NULL);
+        copy_name(d->driver, get_tacho_driver_name((uint8_t)sn, buf, sizeof(buf)) ? buf : NULL);
+    }
+    manifest_save();
+    return true;
+}
+
+// ---------- Lifecycle ----------
+discovery_result_t discovery_init(const char* manifest_path) {
+    uint64_t t0 = now_ns();
+    snprintf(manifest, sizeof(manifest), "%s", manifest_path ? manifest_path : DISCOVERY_MANIFEST);
+    memset(sensor_info, 0, sizeof(sensor_info));
+    memset(tacho_info, 0, sizeof(tacho_info));
+    modes_dirty = false;
+    read_boot_id();
+
+    if (manifest_load_and_check()) {
+        last_result = DISCOVERY_CACHED;
+    } else {
+        log_info("discovery: manifest missing or stale, scanning ports\n");
+        last_result = scan_devices() ? DISCOVERY_SCANNED : DISCOVERY_FAILED;
+    }
+    discovery_ns = now_ns() - t0;
+    // Mode switches are recorded in the manifest; its modes are only a fallback
+    if (last_result != DISCOVERY_FAILED) smode_set_store(discovery_sensor_mode, discovery_note_mode);
+    return last_result;
+}
+
+void discovery_close(void) {
+    if (modes_dirty && last_result != DISCOVERY_FAILED) manifest_save();
+}
+
+// ---------- Sensor Modes ----------
+const char* discovery_sensor_mode(uint8_t sn) {
+    if (sn >= SENSOR_DESC__LIMIT_ || !sensor_info[sn].mode[0]) return NULL;
+    return sensor_info[sn].mode;
+}
+
+void discovery_note_mode(uint8_t sn, const char* mode) {
+    if (sn >= SENSOR_DESC__LIMIT_ || !mode) return;
+    if (strcmp(sensor_info[sn].mode, mode) == 0) return;
+    snprintf(sensor_info[sn].mode, NAME_LEN, "%s", mode);
+    modes_dirty = true;
+}
+
+// ---------- Statistics ----------
+uint64_t discovery_time_ns(void) {
+    return discovery_ns;
+}
+
+void discovery_print(FILE* out) {
+    static const char* result_names[] = { "failed", "cached", "scanned" };
+    fprintf(out, "Discovery: %s in %.1f ms\n", result_names[last_result], discovery_ns / 1e6);
+    char port[32];
+    for (int sn = 0; sn < SENSOR_DESC__LIMIT_; sn++) {
+        if (ev3_sensor[sn].type_inx == SENSOR_TYPE__NONE_) continue;
+        fprintf(out, "  sensor%d  %-6s %-18s %s\n", sn, ev3_sensor_port_name((uint8_t)sn, port),
+                sensor_info[sn].driver, sensor_info[sn].mode[0] ? sensor_info[sn].mode : "?");
+    }
+    for (int sn = 0; sn < TACHO_DESC__LIMIT_; sn++) {
+        if (ev3_tacho[sn].type_inx == TACHO_TYPE__NONE_) continue;
+        fprintf(out, "  motor%d   %-6s %s\n", sn, ev3_tacho_port_name((uint8_t)sn, port), tacho_info[sn].driver);
+    }
+}
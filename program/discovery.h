@@ -0,0 +1,40 @@
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Device discovery with a persisted manifest. The first boot scans all ports
+// with ev3_sensor_init()/ev3_tacho_init() and writes the port-to-device
+// mapping (plus each sensor's current mode) to a small text file. Later boots
+// check that manifest with one address/driver read per device and fill
+// ev3_sensor[]/ev3_tacho[] from it, so ev3_search_sensor()/ev3_search_tacho()
+// work as usual; any mismatch falls back to a full scan.
+//
+// Sensor modes are only kept for the boot that recorded them (the manifest
+// stores the kernel's boot_id): sensors reset to their default mode when
+// powered up. Even then another program may have switched a sensor since,
+// so a recorded mode is a hint, not the sensor's current mode.
+
+#define DISCOVERY_MANIFEST "/home/robot/.ev3_devices"
+
+typedef enum {
+    DISCOVERY_FAILED,
+    DISCOVERY_CACHED,           // manifest matched the hardware
+    DISCOVERY_SCANNED,          // full scan, manifest rewritten
+} discovery_result_t;
+
+// --- Lifecycle (replaces ev3_sensor_init() + ev3_tacho_init(), after ev3_init()) ---
+discovery_result_t discovery_init(const char* manifest_path);  // NULL = DISCOVERY_MANIFEST
+void discovery_close(void);     // saves mode changes made since init
+
+// --- Sensor Modes ---
+const char* discovery_sensor_mode(uint8_t sn);          // last mode seen this boot, NULL if unknown
+void discovery_note_mode(uint8_t sn, const char* mode); // record a mode switch
+
+// --- Statistics ---
+uint64_t discovery_time_ns(void);                       // duration of discovery_init()
+void discovery_print(FILE* out);
+
+#endif // DISCOVERY_H
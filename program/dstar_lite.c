@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dstar_lite.h"
+
+static const int DX[4] = { 0, 1, 0, -1 };  // N, E, S, W
+static const int DY[4] = { 1, 0, -1, 0 };
+
+// ---------- Helpers ----------
+static int neighbor(const dstar_t* d, int c, int dir) {
+    int x = c % d->w + DX[dir], y = c / d->w + DY[dir];
+    if (x < 0 || x >= d->w || y < 0 || y >= d->h) return -1;
+    return y * d->w + x;
+}
+
+static int heuristic(const dstar_t* d, int a, int b) {
+    return abs(a % d->w - b % d->w) + abs(a / d->w - b / d->w);
+}
+
+static int32_t add_cost(int32_t a, int32_t b) {
+    int32_t s = a + b;
+    return s >= DSTAR_INF ? DSTAR_INF : s;
+}
+
+// Cost of the edge between two neighbouring cells
+static int32_t edge_cost(const dstar_t* d, int a, int b) {
+    return (d->blocked[a] || d->blocked[b]) ? DSTAR_INF : 1;
+}
+
+// ---------- Priority Queue ----------
+// Binary heap with a position index, so a queued cell can be re-keyed or
+// removed in O(log n).
+static bool key_less(const dstar_t* d, int a, int b) {
+    return d->key1[a] < d->key1[b] || (d->key1[a] == d->key1[b] && d->key2[a] < d->key2[b]);
+}
+
+static void heap_place(dstar_t* d, int i, int c) {
+    d->heap[i] = c;
+    d->pos[c] = i;
+}
+
+static void sift_up(dstar_t* d, int i) {
+    int c = d->heap[i];
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (!key_less(d, c, d->heap[p])) break;
+        heap_place(d, i, d->heap[p]);
+        i = p;
+    }
+    heap_place(d, i, c);
+}
+
+static void sift_down(dstar_t* d, int i) {
+    int c = d->heap[i];
+    while (true) {
+        int k = i * 2 + 1;
+        if (k >= d->heap_len) break;
+        if (k + 1 < d->heap_len && key_less(d, d->heap[k + 1], d->heap[k])) k++;
+        if (!key_less(d, d->heap[k], c)) break;
+        heap_place(d, i, d->heap[k]);
+        i = k;
+    }
+    heap_place(d, i, c);
+}
+
+static void queue_set(dstar_t* d, int c, int32_t k1, int32_t k2) {
+    d->key1[c] = k1;
+    d->key2[c] = k2;
+    if (d->pos[c] < 0) {
+        heap_place(d, d->heap_len++, c);
+        sift_up(d, d->heap_len - 1);
+    } else {
+        sift_up(d, d->pos[c]);
+        sift_down(d, d->pos[c]);
+    }
+}
+
+static void queue_remove(dstar_t* d, int c) {
+    int i = d->pos[c];
+    if (i < 0) return;
+    d->pos[c] = -1;
+    int last = d->heap[--d->heap_len];
+    if (i == d->heap_len) return;
+    heap_place(d, i, last);
+    sift_up(d, i);
+    sift_down(d, d->pos[last]);
+}
+
+// ---------- D* Lite ----------
+static void calc_key(const dstar_t* d, int c, int32_t* k1, int32_t* k2) {
+    int32_t m = d->g[c] < d->rhs[c] ? d->g[c] : d->rhs[c];
+    *k1 = add_cost(add_cost(m, heuristic(d, d->start, c)), d->km);
+    *k2 = m;
+}
+
+// One-step lookahead: the best g reachable from c in one move
+static int32_t best_rhs(const dstar_t* d, int c) {
+    int32_t best = DSTAR_INF;
+    for (int dir = 0; dir < 4; dir++) {
+        int n = neighbor(d, c, dir);
+        if (n < 0) continue;
+        int32_t v = add_cost(edge_cost(d, c, n), d->g[n]);
+        if (v < best) best = v;
+    }
+    return best;
+}
+
+static void update_vertex(dstar_t* d, int c) {
+    if (d->g[c] != d->rhs[c]) {
+        int32_t k1, k2;
+        calc_key(d, c, &k1, &k2);
+        queue_set(d, c, k1, k2);
+    } else {
+        queue_remove(d, c);
+    }
+}
+
+bool dstar_init(dstar_t* d, int w, int h, int goal_x, int goal_y) {
+    memset(d, 0, sizeof(*d));
+    if (w <= 0 || h <= 0 || goal_x < 0 || goal_x >= w || goal_y < 0 || goal_y >= h) return false;
+    size_t n = (size_t)w * (size_t)h;
+    d->w = w;
+    d->h = h;
+    d->g       = malloc(n * sizeof(int32_t));
+    d->rhs     = malloc(n * sizeof(int32_t));
+    d->key1    = malloc(n * sizeof(int32_t));
+    d->key2    = malloc(n * sizeof(int32_t));
+    d->heap    = malloc(n * sizeof(int32_t));
+    d->pos     = malloc(n * sizeof(int32_t));
+    d->blocked = calloc(n, 1);
+    if (!d->g || !d->rhs || !d->key1 || !d->key2 || !d->heap || !d->pos || !d->blocked) {
+        dstar_free(d);
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        d->g[i] = d->rhs[i] = DSTAR_INF;
+        d->pos[i] = -1;
+    }
+    d->goal = goal_y * w + goal_x;
+    d->start = d->last = d->goal;
+    d->rhs[d->goal] = 0;
+    update_vertex(d, d->goal);
+    return true;
+}
+
+void dstar_free(dstar_t* d) {
+    free(d->g);
+    free(d->rhs);
+    free(d->key1);
+    free(d->key2);
+    free(d->heap);
+    free(d->pos);
+    free(d->blocked);
+    memset(d, 0, sizeof(*d));
+}
+
+void dstar_set_start(dstar_t* d, int x, int y) {
+    if (x < 0 || x >= d->w || y < 0 || y >= d->h) return;
+    d->start = y * d->w + x;
+    if (d->plans == 0) d->last = d->start;     // first plan keys from here
+}
+
+void dstar_set_blocked(dstar_t* d, int x, int y, bool blocked) {
+    if (x < 0 || x >= d->w || y < 0 || y >= d->h) return;
+    int c = y * d->w + x;
+    if (d->blocked[c] == (uint8_t)blocked) return;
+    d->blocked[c] = blocked;
+    d->updates++;
+    // Every edge touching c changed: c and its neighbours need a fresh rhs.
+    if (c != d->goal) d->rhs[c] = best_rhs(d, c);
+    update_vertex(d, c);
+    for (int dir = 0; dir < 4; dir++) {
+        int n = neighbor(d, c, dir);
+        if (n < 0 || n == d->goal) continue;
+        d->rhs[n] = best_rhs(d, n);
+        update_vertex(d, n);
+    }
+}
+
+bool dstar_plan(dstar_t* d) {
+    int s = d->start;
+    uint64_t expanded = 0;
+    // Queued keys were computed for an older start; km keeps them valid
+    // lower bounds instead of re-keying the whole queue.
+    d->km += heuristic(d, d->last, s);
+    d->last = s;
+    while (d->heap_len > 0) {
+        int u = d->heap[0];
+        int32_t s1, s2;
+        calc_key(d, s, &s1, &s2);
+        bool top_before_start = d->key1[u] < s1 || (d->key1[u] == s1 && d->key2[u] < s2);
+        if (!top_before_start && d->rhs[s] == d->g[s]) break;
+
+        int32_t k1, k2;
+        calc_key(d, u, &k1, &k2);
+        expanded++;
+        if (d->key1[u] < k1 || (d->key1[u] == k1 && d->key2[u] < k2)) {
+            queue_set(d, u, k1, k2);                // stale key, re-queue
+        } else if (d->g[u] > d->rhs[u]) {
+            d->g[u] = d->rhs[u];                    // overconsistent: settle
+            queue_remove(d, u);
+            for (int dir = 0; dir < 4; dir++) {
+                int p = neighbor(d, u, dir);
+                if (p < 0 || p == d->goal) continue;
+                int32_t v = add_cost(edge_cost(d, p, u), d->g[u]);
+                if (v < d->rhs[p]) d->rhs[p] = v;
+                update_vertex(d, p);
+            }
+        } else {
+            int32_t g_old = d->g[u];
+            d->g[u] = DSTAR_INF;                    // underconsistent: raise
+            update_vertex(d, u);
+            for (int dir = 0; dir < 4; dir++) {
+                int p = neighbor(d, u, dir);
+                if (p < 0 || p == d->goal) continue;
+                // Only cells whose best step went through u need a new one.
+                if (d->rhs[p] == add_cost(edge_cost(d, p, u), g_old)) d->rhs[p] = best_rhs(d, p);
+                update_vertex(d, p);
+            }
+        }
+    }
+    d->plans++;
+    d->expanded += expanded;
+    d->last_expanded = expanded;
+    return d->rhs[s] < DSTAR_INF;
+}
+
+// ---------- Queries ----------
+int dstar_next_dir(const dstar_t* d, int x, int y, int prefer_dir) {
+    if (x < 0 || x >= d->w || y < 0 || y >= d->h) return -1;
+    int c = y * d->w + x;
+    if (c == d->goal) return -1;
+    int best_dir = -1;
+    int32_t best = DSTAR_INF;
+    for (int k = 0; k < 4; k++) {
+        int dir = (prefer_dir + k) & 3;
+        int n = neighbor(d, c, dir);
+        if (n < 0) continue;
+        int32_t v = add_cost(edge_cost(d, c, n), d->g[n]);
+        if (v < best) {
+            best = v;
+            best_dir = dir;
+        }
+    }
+    return best_dir;
+}
+
+int dstar_distance(const dstar_t* d, int x, int y) {
+    if (x < 0 || x >= d->w || y < 0 || y >= d->h) return -1;
+    int32_t v = d->rhs[y * d->w + x];
+    return v < DSTAR_INF ? v : -1;
+}
+
+// ---------- Statistics ----------
+void dstar_print_stats(const dstar_t* d, FILE* out) {
+    fprintf(out, "--- D* Lite ---\n");
+    fprintf(out, "%llu plans, %llu cell updates, %llu expansions (%.1f per plan)\n", (unsigned long long)d->plans,
+            (unsigned long long)d->updates, (unsigned long long)d->expanded,
+            d->plans ? (double)d->expanded / d->plans : 0.0);
+}
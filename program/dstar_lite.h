@@ -0,0 +1,56 @@
+#ifndef DSTAR_LITE_H
+#define DSTAR_LITE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Incremental route planner (D* Lite, Koenig & Likhachev) on the 4-connected
+// tile grid. The search runs backwards from the goal and keeps its state
+// between calls: when a cell turns out to be blocked, only the part of the
+// search tree that routed through it is repaired, and moving the robot costs
+// nothing until the next change. Unknown cells count as free, so the route is
+// the shortest one the map does not rule out yet.
+//
+// Coordinates and headings follow grid_navigation.c: x grows east, y grows
+// north, headings 0..3 are N, E, S, W.
+
+#define DSTAR_INF 0x3fffffff
+
+typedef struct {
+    int w, h;
+    int goal, start, last;      // cell indices
+    int km;                     // key offset from robot moves
+    int32_t* g;
+    int32_t* rhs;
+    int32_t* key1;              // priority of cells in the queue
+    int32_t* key2;
+    int32_t* heap;              // cell indices
+    int32_t* pos;               // cell -> heap index, -1 = not queued
+    uint8_t* blocked;
+    int heap_len;
+
+    uint64_t plans, expanded, updates;
+    uint64_t last_expanded;     // by the most recent dstar_plan()
+} dstar_t;
+
+// --- Lifecycle ---
+bool dstar_init(dstar_t* d, int w, int h, int goal_x, int goal_y);
+void dstar_free(dstar_t* d);
+
+// --- Updates ---
+void dstar_set_start(dstar_t* d, int x, int y);             // robot moved
+void dstar_set_blocked(dstar_t* d, int x, int y, bool blocked);
+
+// --- Queries ---
+// Brings the route from the start up to date; false if the goal is cut off.
+bool dstar_plan(dstar_t* d);
+// Heading of the next step towards the goal from (x, y); ties go to
+// prefer_dir so the route keeps straight. -1 if there is no route.
+int  dstar_next_dir(const dstar_t* d, int x, int y, int prefer_dir);
+int  dstar_distance(const dstar_t* d, int x, int y);       // tiles, -1 = no route
+
+// --- Statistics ---
+void dstar_print_stats(const dstar_t* d, FILE* out);
+
+#endif // DSTAR_LITE_H
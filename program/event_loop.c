@@ -0,0 +1,233 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <linux/input.h>
+#include "ev3.h"
+#include "ev3_sensor.h"
+#include "timing.h"
+#include "event_loop.h"
+
+// Older kernel headers only have the timeval member
+#ifndef input_event_sec
+#define input_event_sec  time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
+enum { SRC_FREE = 0, SRC_BUTTONS, SRC_TIMER, SRC_SENSOR, SRC_FD };
+
+// ---------- Lifecycle ----------
+bool evloop_init(evloop_t* loop) {
+    memset(loop, 0, sizeof(*loop));
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    return loop->epfd >= 0;
+}
+
+void evloop_close(evloop_t* loop) {
+    for (int i = 0; i < EVLOOP_MAX_SOURCES; i++) {
+        if (loop->sources[i].kind != SRC_FREE) evloop_remove(loop, i);
+    }
+    if (loop->epfd >= 0) close(loop->epfd);
+    loop->epfd = -1;
+}
+
+// ---------- Sources ----------
+static int add_source(evloop_t* loop, int kind, int fd, bool owns_fd, uint32_t events, void* ctx) {
+    for (int i = 0; i < EVLOOP_MAX_SOURCES; i++) {
+        evloop_source_t* src = &loop->sources[i];
+        if (src->kind != SRC_FREE) continue;
+        struct epoll_event ev = { .events = events, .data.u32 = (uint32_t)i };
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) return -1;
+        memset(src, 0, sizeof(*src));
+        src->kind = kind;
+        src->fd = fd;
+        src->owns_fd = owns_fd;
+        src->ctx = ctx;
+        return i;
+    }
+    return -1;
+}
+
+static uint8_t key_code_to_mask(uint16_t code) {
+    switch (code) {
+        case KEY_UP:        return EV3_KEY_UP;
+        case KEY_DOWN:      return EV3_KEY_DOWN;
+        case KEY_LEFT:      return EV3_KEY_LEFT;
+        case KEY_RIGHT:     return EV3_KEY_RIGHT;
+        case KEY_ENTER:     return EV3_KEY_CENTER;
+        case KEY_BACKSPACE: return EV3_KEY_BACK;
+    }
+    return 0;
+}
+
+int evloop_add_buttons_fd(evloop_t* loop, int fd, evloop_key_fn fn, void* ctx) {
+    int id = add_source(loop, SRC_BUTTONS, fd, false, EPOLLIN, ctx);
+    if (id < 0) return -1;
+    evloop_source_t* src = &loop->sources[id];
+    src->cb.key = fn;
+
+    // Real evdev nodes: timestamp on the monotonic clock and seed the current
+    // key state. Both ioctls simply fail on a pipe-backed fake device.
+    int clk = CLOCK_MONOTONIC;
+    src->mono_clock = (ioctl(fd, EVIOCSCLOCKID, &clk) == 0);
+    uint8_t bits[KEY_MAX / 8 + 1];
+    memset(bits, 0, sizeof(bits));
+    if (ioctl(fd, EVIOCGKEY(sizeof(bits)), bits) >= 0) {
+        static const uint16_t codes[] = { KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, KEY_ENTER, KEY_BACKSPACE };
+        for (size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); i++) {
+            if (bits[codes[i] / 8] & (1 << (codes[i] % 8))) loop->keys |= key_code_to_mask(codes[i]);
+        }
+    }
+    return id;
+}
+
+int evloop_add_buttons(evloop_t* loop, const char* device, evloop_key_fn fn, void* ctx) {
+    int fd = open(device ? device : EV3_BUTTONS_DEVICE, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int id = evloop_add_buttons_fd(loop, fd, fn, ctx);
+    if (id < 0) {
+        close(fd);
+        return -1;
+    }
+    loop->sources[id].owns_fd = true;
+    return id;
+}
+
+static bool arm_timerfd(int fd, uint32_t period_us, uint32_t first_us) {
+    struct itimerspec its;
+    if (first_us == 0) first_us = period_us;
+    its.it_value    = ns_to_timespec((uint64_t)first_us * 1000ull);
+    its.it_interval = ns_to_timespec((uint64_t)period_us * 1000ull);
+    return timerfd_settime(fd, 0, &its, NULL) == 0;
+}
+
+static int make_timerfd(uint32_t period_us, uint32_t first_us) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) return -1;
+    if (!arm_timerfd(fd, period_us, first_us)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int evloop_add_timer(evloop_t* loop, uint32_t period_us, uint32_t first_us, evloop_timer_fn fn, void* ctx) {
+    int fd = make_timerfd(period_us, first_us);
+    if (fd < 0) return -1;
+    int id = add_source(loop, SRC_TIMER, fd, true, EPOLLIN, ctx);
+    if (id < 0) {
+        close(fd);
+        return -1;
+    }
+    loop->sources[id].cb.timer = fn;
+    return id;
+}
+
+bool evloop_set_timer(evloop_t* loop, int id, uint32_t period_us, uint32_t first_us) {
+    if (id < 0 || id >= EVLOOP_MAX_SOURCES || loop->sources[id].kind != SRC_TIMER) return false;
+    return arm_timerfd(loop->sources[id].fd, period_us, first_us);
+}
+
+int evloop_add_sensor(evloop_t* loop, uint8_t sn, uint32_t period_us, evloop_sensor_fn fn, void* ctx) {
+    int fd = make_timerfd(period_us, 0);
+    if (fd < 0) return -1;
+    int id = add_source(loop, SRC_SENSOR, fd, true, EPOLLIN, ctx);
+    if (id < 0) {
+        close(fd);
+        return -1;
+    }
+    loop->sources[id].cb.sensor = fn;
+    loop->sources[id].sn = sn;
+    return id;
+}
+
+int evloop_add_fd(evloop_t* loop, int fd, uint32_t events, evloop_fd_fn fn, void* ctx) {
+    int id = add_source(loop, SRC_FD, fd, false, events, ctx);
+    if (id >= 0) loop->sources[id].cb.fd = fn;
+    return id;
+}
+
+void evloop_remove(evloop_t* loop, int id) {
+    if (id < 0 || id >= EVLOOP_MAX_SOURCES) return;
+    evloop_source_t* src = &loop->sources[id];
+    if (src->kind == SRC_FREE) return;
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, src->fd, NULL);
+    if (src->owns_fd) close(src->fd);
+    src->kind = SRC_FREE;
+}
+
+// ---------- Dispatch ----------
+static bool dispatch_buttons(evloop_t* loop, evloop_source_t* src) {
+    struct input_event evs[16];
+    ssize_t n = read(src->fd, evs, sizeof(evs));
+    if (n == 0) return false;                       // fake device closed
+    if (n < 0) return errno == EAGAIN || errno == EINTR;
+
+    for (size_t i = 0; i < (size_t)n / sizeof(evs[0]); i++) {
+        if (evs[i].type != EV_KEY || evs[i].value == 2) continue;   // skip autorepeat
+        uint8_t mask = key_code_to_mask(evs[i].code);
+        if (!mask) continue;
+        uint8_t before = loop->keys;
+        if (evs[i].value) loop->keys |= mask;
+        else              loop->keys &= (uint8_t)~mask;
+        if (loop->keys == before) continue;
+        uint64_t t = src->mono_clock
+            ? (uint64_t)evs[i].input_event_sec * 1000000000ull + (uint64_t)evs[i].input_event_usec * 1000ull
+            : now_ns();
+        if (src->cb.key) src->cb.key(src->ctx, loop->keys, mask, t);
+    }
+    return true;
+}
+
+static bool dispatch(evloop_t* loop, int id, uint32_t events) {
+    evloop_source_t* src = &loop->sources[id];
+    uint64_t expirations = 0;
+
+    switch (src->kind) {
+        case SRC_BUTTONS:
+            return dispatch_buttons(loop, src);
+        case SRC_TIMER:
+            if (read(src->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return true;
+            return src->cb.timer(src->ctx, expirations);
+        case SRC_SENSOR: {
+            if (read(src->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return true;
+            int value;
+            if (!get_sensor_value(0, src->sn, &value)) return true;
+            return src->cb.sensor(src->ctx, src->sn, value, now_ns());
+        }
+        case SRC_FD:
+            return src->cb.fd(src->ctx, src->fd, events);
+    }
+    return false;
+}
+
+int evloop_run_once(evloop_t* loop, int timeout_ms) {
+    struct epoll_event evs[EVLOOP_MAX_SOURCES];
+    int n = epoll_wait(loop->epfd, evs, EVLOOP_MAX_SOURCES, timeout_ms);
+    if (n < 0) return (errno == EINTR) ? 0 : -1;
+    for (int i = 0; i < n; i++) {
+        int id = (int)evs[i].data.u32;
+        if (loop->sources[id].kind == SRC_FREE) continue;   // removed by an earlier callback
+        if (!dispatch(loop, id, evs[i].events)) evloop_remove(loop, id);
+    }
+    return n;
+}
+
+void evloop_run(evloop_t* loop) {
+    loop->stop = false;
+    while (!loop->stop) {
+        if (evloop_run_once(loop, -1) < 0) break;
+    }
+}
+
+void evloop_stop(evloop_t* loop) {
+    loop->stop = true;
+}
+
+uint8_t evloop_keys(const evloop_t* loop) {
+    return loop->keys;
+}
@@ -0,0 +1,67 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Single-threaded epoll event loop. Buttons come straight from the kernel
+// input device (evdev) instead of polling ev3_read_keys(), timers and
+// periodic sensor sampling use timerfd, and any other fd can be watched.
+// Callbacks run on the thread that calls evloop_run()/evloop_run_once().
+
+#define EVLOOP_MAX_SOURCES 16
+#define EV3_BUTTONS_DEVICE "/dev/input/by-path/platform-gpio_keys-event"
+
+// keys: current EV3_KEY_* mask, changed: bits that flipped in this event
+typedef void (*evloop_key_fn)(void* ctx, uint8_t keys, uint8_t changed, uint64_t t_ns);
+// Return false from timer/fd/sensor callbacks to remove the source.
+typedef bool (*evloop_timer_fn)(void* ctx, uint64_t expirations);
+typedef bool (*evloop_fd_fn)(void* ctx, int fd, uint32_t events);
+typedef bool (*evloop_sensor_fn)(void* ctx, uint8_t sn, int value, uint64_t t_ns);
+
+typedef struct {
+    int kind;
+    int fd;
+    bool owns_fd;
+    bool mono_clock;            // evdev timestamps are CLOCK_MONOTONIC
+    void* ctx;
+    uint8_t sn;
+    union {
+        evloop_key_fn key;
+        evloop_timer_fn timer;
+        evloop_fd_fn fd;
+        evloop_sensor_fn sensor;
+    } cb;
+} evloop_source_t;
+
+typedef struct {
+    int epfd;
+    evloop_source_t sources[EVLOOP_MAX_SOURCES];
+    uint8_t keys;               // current button state
+    bool stop;
+} evloop_t;
+
+// --- Lifecycle ---
+bool evloop_init(evloop_t* loop);
+void evloop_close(evloop_t* loop);
+
+// --- Sources (each returns a source id >= 0, or -1) ---
+// device NULL opens the EV3 brick buttons.
+int evloop_add_buttons(evloop_t* loop, const char* device, evloop_key_fn fn, void* ctx);
+// Any fd that delivers struct input_event records, e.g. a pipe or uinput on a host.
+int evloop_add_buttons_fd(evloop_t* loop, int fd, evloop_key_fn fn, void* ctx);
+// period_us 0 makes a one-shot timer; both 0 adds it disarmed.
+int evloop_add_timer(evloop_t* loop, uint32_t period_us, uint32_t first_us, evloop_timer_fn fn, void* ctx);
+// Re-arms a timer source the same way; both 0 disarms it.
+bool evloop_set_timer(evloop_t* loop, int id, uint32_t period_us, uint32_t first_us);
+int evloop_add_sensor(evloop_t* loop, uint8_t sn, uint32_t period_us, evloop_sensor_fn fn, void* ctx);
+int evloop_add_fd(evloop_t* loop, int fd, uint32_t events, evloop_fd_fn fn, void* ctx);
+void evloop_remove(evloop_t* loop, int id);
+
+// --- Dispatch ---
+int  evloop_run_once(evloop_t* loop, int timeout_ms);   // returns events handled, -1 on error
+void evloop_run(evloop_t* loop);                        // until evloop_stop()
+void evloop_stop(evloop_t* loop);
+uint8_t evloop_keys(const evloop_t* loop);
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <string.h>
+#include "explore.h"
+
+#define LEAD_TURNED 0x80
+
+static const int DX[4] = { 0, 1, 0, -1 };  // N, E, S, W
+static const int DY[4] = { 1, 0, -1, 0 };
+
+// ---------- Lifecycle ----------
+bool explore_init(explorer_t* e, int w, int h, const explore_costs_t* costs) {
+    memset(e, 0, sizeof(*e));
+    if (w <= 0 || h <= 0) return false;
+    size_t n = (size_t)w * (size_t)h;
+    e->w = w;
+    e->h = h;
+    e->costs = *costs;
+    e->goal = e->target = -1;
+    e->cell     = calloc(n, 1);
+    e->frontier = malloc(n * sizeof(int));
+    e->slot     = malloc(n * sizeof(int));
+    e->dist     = malloc(n * 4 * sizeof(uint32_t));
+    e->stamp    = calloc(n * 4, sizeof(uint32_t));
+    e->first    = malloc(n * 4);
+    e->lead     = malloc(n * 4);
+    e->heap_cap = (int)(n * 16 + 1);        // every state is relaxed at most 4 times
+    e->heap     = malloc((size_t)e->heap_cap * sizeof(uint64_t));
+    if (!e->cell || !e->frontier || !e->slot || !e->dist || !e->stamp || !e->first || !e->lead || !e->heap) {
+        explore_free(e);
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) e->slot[i] = -1;
+    return true;
+}
+
+void explore_free(explorer_t* e) {
+    free(e->cell);
+    free(e->frontier);
+    free(e->slot);
+    free(e->dist);
+    free(e->stamp);
+    free(e->first);
+    free(e->lead);
+    free(e->heap);
+    memset(e, 0, sizeof(*e));
+    e->goal = e->target = -1;
+}
+
+// ---------- Frontier Set ----------
+static bool in_grid(const explorer_t* e, int x, int y) {
+    return x >= 0 && x < e->w && y >= 0 && y < e->h;
+}
+
+static bool is_frontier(const explorer_t* e, int c) {
+    if (e->cell[c] != CELL_UNKNOWN) return false;
+    int x = c % e->w, y = c / e->w;
+    for (int d = 0; d < 4; d++) {
+        int nx = x + DX[d], ny = y + DY[d];
+        if (in_grid(e, nx, ny) && e->cell[ny * e->w + nx] == CELL_FREE) return true;
+    }
+    return false;
+}
+
+// Adds or removes c so membership matches is_frontier(); swap-remove keeps
+// both directions O(1).
+static void refresh(explorer_t* e, int c) {
+    bool want = is_frontier(e, c);
+    if (want && e->slot[c] < 0) {
+        e->slot[c] = e->count;
+        e->frontier[e->count++] = c;
+    } else if (!want && e->slot[c] >= 0) {
+        int last = e->frontier[--e->count];
+        e->frontier[e->slot[c]] = last;
+        e->slot[last] = e->slot[c];
+        e->slot[c] = -1;
+    }
+}
+
+void explore_set_cell(explorer_t* e, int x, int y, uint8_t state) {
+    if (!in_grid(e, x, y)) return;
+    int c = y * e->w + x;
+    if (e->cell[c] == state) return;
+    e->cell[c] = state;
+    e->updates++;
+    // Only this cell and its neighbours can change membership.
+    refresh(e, c);
+    for (int d = 0; d < 4; d++) {
+        int nx = x + DX[d], ny = y + DY[d];
+        if (in_grid(e, nx, ny)) refresh(e, ny * e->w + nx);
+    }
+}
+
+bool explore_copy_map(explorer_t* dst, const explorer_t* src) {
+    if (!dst->cell || dst->w != src->w || dst->h != src->h) return false;
+    size_t n = (size_t)src->w * (size_t)src->h;
+    memcpy(dst->cell, src->cell, n);
+    memcpy(dst->frontier, src->frontier, (size_t)src->count * sizeof(int));
+    memcpy(dst->slot, src->slot, n * sizeof(int));
+    dst->count = src->count;
+    dst->costs = src->costs;
+    dst->goal = src->goal;
+    dst->target = -1;
+    return true;
+}
+
+void explore_set_goal(explorer_t* e, int x, int y) {
+    e->goal = in_grid(e, x, y) ? y * e->w + x : -1;
+}
+
+int explore_frontier_count(const explorer_t* e) {
+    return e->count;
+}
+
+// Expected gain of driving onto frontier c: the cell itself, plus a share
+// for the unknown cells it opens up.
+static uint32_t frontier_gain(const explorer_t* e, int c) {
+    int x = c % e->w, y = c / e->w;
+    uint32_t gain = 2;
+    for (int d = 0; d < 4; d++) {
+        int nx = x + DX[d], ny = y + DY[d];
+        if (in_grid(e, nx, ny) && e->cell[ny * e->w + nx] == CELL_UNKNOWN) gain++;
+    }
+    return c == e->goal ? gain * EXPLORE_GOAL_BONUS : gain;
+}
+
+// ---------- Search ----------
+static void heap_push(explorer_t* e, uint64_t key) {
+    int i = e->heap_len++;
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (e->heap[p] <= key) break;
+        e->heap[i] = e->heap[p];
+        i = p;
+    }
+    e->heap[i] = key;
+}
+
+static uint64_t heap_pop(explorer_t* e) {
+    uint64_t top = e->heap[0];
+    uint64_t key = e->heap[--e->heap_len];
+    int i = 0;
+    while (true) {
+        int c = i * 2 + 1;
+        if (c >= e->heap_len) break;
+        if (c + 1 < e->heap_len && e->heap[c + 1] < e->heap[c]) c++;
+        if (key <= e->heap[c]) break;
+        e->heap[i] = e->heap[c];
+        i = c;
+    }
+    e->heap[i] = key;
+    return top;
+}
+
+// dist[] is valid only where stamp[] matches the current search, so a
+// search costs what it visits rather than the size of the grid.
+static void relax(explorer_t* e, int s, uint32_t cost, int from, bool forward) {
+    if (e->stamp[s] == e->search_id && e->dist[s] <= cost) return;
+    e->stamp[s] = e->search_id;
+    e->dist[s] = cost;
+    int8_t first = -1;
+    uint8_t lead = 0;
+    if (from >= 0) {
+        first = e->first[from];
+        lead = e->lead[from];
+        if (!forward) {
+            if (first >= 0) lead |= LEAD_TURNED;
+        } else if (first < 0) {
+            first = (int8_t)(s & 3);
+            lead = 1;
+        } else if (!(lead & LEAD_TURNED) && lead < 0x7f) {
+            lead++;
+        }
+    }
+    e->first[s] = first;
+    e->lead[s] = lead;
+    heap_push(e, ((uint64_t)cost << 32) | (uint32_t)s);
+}
+
+// Dijkstra over (cell, heading) from the robot's pose. With want >= 0 it
+// returns the first state that reaches that cell; otherwise the frontier
+// state with the best gain per cost. -1 if nothing qualifies.
+static int search(explorer_t* e, int start, int dir, int want) {
+    if (++e->search_id == 0) {
+        memset(e->stamp, 0, (size_t)e->w * e->h * 4 * sizeof(uint32_t));
+        e->search_id = 1;
+    }
+    e->heap_len = 0;
+    relax(e, start * 4 + dir, 0, -1, false);
+
+    bool goal_open = e->goal >= 0 && e->slot[e->goal] >= 0;
+    uint32_t max_gain = 5 * (goal_open ? EXPLORE_GOAL_BONUS : 1);
+    int best = -1;
+    uint32_t best_gain = 0, best_cost = 0;
+
+    while (e->heap_len > 0) {
+        uint64_t top = heap_pop(e);
+        uint32_t cost = (uint32_t)(top >> 32);
+        int s = (int)(uint32_t)top;
+        if (cost != e->dist[s]) continue;       // stale entry
+        int c = s >> 2, h = s & 3;
+        e->expanded++;
+
+        if (e->cell[c] == CELL_UNKNOWN && c != start) {
+            if (want >= 0) {
+                if (c == want) return s;
+                continue;
+            }
+            uint32_t gain = frontier_gain(e, c);
+            if (best < 0 || (uint64_t)gain * best_cost > (uint64_t)best_gain * cost) {
+                best = s;
+                best_gain = gain;
+                best_cost = cost;
+            }
+            continue;                           // unknown: do not plan through it
+        }
+        // Everything still queued costs at least this much; stop once even
+        // the best possible gain could not beat what we have.
+        if (best >= 0 && (uint64_t)max_gain * best_cost <= (uint64_t)best_gain * cost) break;
+
+        relax(e, c * 4 + ((h + 1) & 3), cost + e->costs.turn90, s, false);
+        relax(e, c * 4 + ((h + 3) & 3), cost + e->costs.turn90, s, false);
+        relax(e, c * 4 + ((h + 2) & 3), cost + e->costs.turn180, s, false);
+        int nx = c % e->w + DX[h], ny = c / e->w + DY[h];
+        if (in_grid(e, nx, ny) && e->cell[ny * e->w + nx] != CELL_BLOCKED) {
+            relax(e, (ny * e->w + nx) * 4 + h, cost + e->costs.move, s, true);
+        }
+    }
+    return want >= 0 ? -1 : best;
+}
+
+// ---------- Decisions ----------
+int explore_next_dir(explorer_t* e, int x, int y, int dir, int* tiles) {
+    if (!in_grid(e, x, y)) return -1;
+    int start = y * e->w + x;
+    int s = -1;
+    // Keep the current target while it is still a frontier, unless the goal
+    // has just become one.
+    bool goal_open = e->goal >= 0 && e->slot[e->goal] >= 0;
+    if (e->target >= 0 && e->slot[e->target] >= 0 && (!goal_open || e->target == e->goal)) {
+        s = search(e, start, dir & 3, e->target);
+        if (s >= 0) e->replans++;
+    }
+    if (s < 0) {
+        s = search(e, start, dir & 3, -1);
+        e->plans++;
+    }
+    if (s < 0) {
+        e->target = -1;
+        return -1;
+    }
+    e->target = s >> 2;
+    if (tiles) *tiles = e->lead[s] & ~LEAD_TURNED;
+    return e->first[s];
+}
+
+bool explore_target(const explorer_t* e, int* x, int* y) {
+    if (e->target < 0) return false;
+    *x = e->target % e->w;
+    *y = e->target / e->w;
+    return true;
+}
+
+// ---------- Statistics ----------
+void explore_print_stats(const explorer_t* e, FILE* out) {
+    fprintf(out, "--- Exploration ---\n");
+    fprintf(out, "%d frontier cells left, %llu cell updates\n", e->count, (unsigned long long)e->updates);
+    fprintf(out, "%llu target picks, %llu path re-plans, %llu states expanded\n", (unsigned long long)e->plans,
+            (unsigned long long)e->replans, (unsigned long long)e->expanded);
+}
@@ -0,0 +1,80 @@
+#ifndef EXPLORE_H
+#define EXPLORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Frontier-based exploration for the tile grid. A frontier is an unknown
+// cell next to known free space, i.e. a cell the robot can drive onto to
+// learn what it is. The frontier set is kept up to date as cells are
+// revealed (O(1) per change), so nothing rescans the map.
+//
+// Each decision scores the reachable frontiers by expected information gain
+// per unit of travel time, with turns priced separately from moves, using a
+// Dijkstra search over (cell, heading) that stops once no further frontier
+// can beat the best one found. A chosen target is kept until it is revealed
+// or cut off, so most steps only re-plan the path to it.
+//
+// Coordinates and headings follow grid_navigation.c: x grows east, y grows
+// north, headings 0..3 are N, E, S, W.
+
+// Cell states; the same values grid_navigation.c keeps in its map
+#define CELL_UNKNOWN 0
+#define CELL_FREE    1
+#define CELL_BLOCKED 2
+
+#define EXPLORE_GOAL_BONUS 8    // gain multiplier for the goal cell
+
+typedef struct {
+    uint32_t move;              // one tile forward, ms
+    uint32_t turn90;
+    uint32_t turn180;
+} explore_costs_t;
+
+typedef struct {
+    int w, h;
+    uint8_t* cell;              // CELL_* per cell
+    int* frontier;              // indices of frontier cells, unordered
+    int* slot;                  // cell -> index in frontier[], -1 if none
+    int count;
+
+    explore_costs_t costs;
+    int goal;                   // cell index, -1 = none
+    int target;                 // current target cell, -1 = none
+
+    // Planning scratch, one entry per (cell, heading)
+    uint32_t* dist;
+    uint32_t* stamp;            // search that last wrote dist[]
+    uint32_t search_id;
+    int8_t* first;              // heading of the first move, -1 = not moved yet
+    uint8_t* lead;              // straight moves before the first turn; bit 7 = turned
+    uint64_t* heap;             // (cost << 32) | state
+    int heap_len, heap_cap;
+
+    uint64_t plans, replans, expanded, updates;
+} explorer_t;
+
+// --- Lifecycle ---
+bool explore_init(explorer_t* e, int w, int h, const explore_costs_t* costs);
+void explore_free(explorer_t* e);
+
+// --- Map updates ---
+void explore_set_cell(explorer_t* e, int x, int y, uint8_t state);
+void explore_set_goal(explorer_t* e, int x, int y);    // out of bounds = no goal
+// Copies the cells, frontier and goal of src into dst (same size), so a
+// decision can be tried on a what-if map without touching src.
+bool explore_copy_map(explorer_t* dst, const explorer_t* src);
+int  explore_frontier_count(const explorer_t* e);
+
+// --- Decisions ---
+// Heading to drive from (x, y) facing dir, and how many tiles to go straight
+// on it before the path turns. Returns -1 if no frontier is reachable.
+int explore_next_dir(explorer_t* e, int x, int y, int dir, int* tiles);
+// Cell the last decision was heading for; false if none.
+bool explore_target(const explorer_t* e, int* x, int* y);
+
+// --- Statistics ---
+void explore_print_stats(const explorer_t* e, FILE* out);
+
+#endif // EXPLORE_H
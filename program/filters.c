@@ -0,0 +1,207 @@
+#include <string.h>
+#include "filters.h"
+
+// ---------- Running Median ----------
+// Mediator layout: heap slot 0 holds the median, slots 1..n form a min-heap
+// of larger values and slots -1..-n a max-heap of smaller ones. pos[] maps
+// each ring entry to its heap slot, so the sample leaving the window is
+// replaced in place and sifted, instead of searched for.
+#define HEAP(m, i) ((m)->heap[(m)->mid + (i)])
+#define MIN_COUNT(m) (((m)->count - 1) / 2)
+#define MAX_COUNT(m) ((m)->count / 2)
+
+static bool heap_less(const median_filter_t* m, int i, int j) {
+    return m->data[HEAP(m, i)] < m->data[HEAP(m, j)];
+}
+
+static void heap_swap(median_filter_t* m, int i, int j) {
+    int8_t t = HEAP(m, i);
+    HEAP(m, i) = HEAP(m, j);
+    HEAP(m, j) = t;
+    m->pos[HEAP(m, i)] = (int8_t)i;
+    m->pos[HEAP(m, j)] = (int8_t)j;
+}
+
+// Swaps if slot i < slot j; returns whether it did.
+static bool heap_order(median_filter_t* m, int i, int j) {
+    if (!heap_less(m, i, j)) return false;
+    heap_swap(m, i, j);
+    return true;
+}
+
+// Sift down starting at child slot i (slot 1 is the median's only child).
+static void min_sort_down(median_filter_t* m, int i) {
+    for (; i <= MIN_COUNT(m); i *= 2) {
+        if (i > 1 && i < MIN_COUNT(m) && heap_less(m, i + 1, i)) i++;
+        if (!heap_order(m, i, i / 2)) break;
+    }
+}
+
+static void max_sort_down(median_filter_t* m, int i) {
+    for (; i >= -MAX_COUNT(m); i *= 2) {
+        if (i < -1 && i > -MAX_COUNT(m) && heap_less(m, i, i - 1)) i--;
+        if (!heap_order(m, i / 2, i)) break;
+    }
+}
+
+// Sift up; true if the item reached the median slot.
+static bool min_sort_up(median_filter_t* m, int i) {
+    while (i > 0 && heap_order(m, i, i / 2)) i /= 2;
+    return i == 0;
+}
+
+static bool max_sort_up(median_filter_t* m, int i) {
+    while (i < 0 && heap_order(m, i / 2, i)) i /= 2;
+    return i == 0;
+}
+
+bool median_init(median_filter_t* m, int window) {
+    if (window < 1 || window > MEDIAN_MAX_WINDOW) return false;
+    memset(m, 0, sizeof(*m));
+    m->window = (uint8_t)window;
+    m->mid = (uint8_t)(window / 2);
+    // Fill order: median, max, min, max, min, ...
+    for (int k = window - 1; k >= 0; k--) {
+        m->pos[k] = (int8_t)(((k + 1) / 2) * ((k & 1) ? -1 : 1));
+        HEAP(m, m->pos[k]) = (int8_t)k;
+    }
+    return true;
+}
+
+int median_update(median_filter_t* m, int value) {
+    bool is_new = m->count < m->window;
+    int p = m->pos[m->idx];
+    int old = m->data[m->idx];
+    m->data[m->idx] = value;
+    m->idx = (uint8_t)((m->idx + 1) % m->window);
+    if (is_new) m->count++;
+
+    if (p > 0) {
+        if (!is_new && old < value)     min_sort_down(m, p * 2);
+        else if (min_sort_up(m, p))     max_sort_down(m, -1);
+    } else if (p < 0) {
+        if (!is_new && value < old)     max_sort_down(m, p * 2);
+        else if (max_sort_up(m, p))     min_sort_down(m, 1);
+    } else {
+        if (MAX_COUNT(m)) max_sort_down(m, -1);
+        if (MIN_COUNT(m)) min_sort_down(m, 1);
+    }
+    return median_value(m);
+}
+
+// Mean of the two middle samples while the count is even.
+int median_value(const median_filter_t* m) {
+    if (m->count == 0) return 0;
+    int v = m->data[HEAP(m, 0)];
+    if ((m->count & 1) == 0) v = (v + m->data[HEAP(m, -1)]) / 2;
+    return v;
+}
+
+// ---------- EMA ----------
+void ema_init(ema_t* e, int shift) {
+    e->acc = 0;
+    e->shift = (uint8_t)(shift < 0 ? 0 : (shift > 15 ? 15 : shift));
+    e->primed = false;
+}
+
+int ema_update(ema_t* e, int value) {
+    if (!e->primed) {
+        e->acc = (int32_t)value << e->shift;
+        e->primed = true;
+    } else {
+        e->acc += value - ema_value(e);
+    }
+    return ema_value(e);
+}
+
+int ema_value(const ema_t* e) {
+    if (e->shift == 0) return e->acc;
+    return (e->acc + (1 << (e->shift - 1))) >> e->shift;     // rounded
+}
+
+// ---------- Hysteresis ----------
+void hysteresis_init(hysteresis_t* h, int low, int high, bool initial) {
+    h->low = low < high ? low : high;
+    h->high = low < high ? high : low;
+    h->state = initial;
+}
+
+bool hysteresis_update(hysteresis_t* h, int value) {
+    if (h->state && value < h->low)         h->state = false;
+    else if (!h->state && value > h->high)  h->state = true;
+    return h->state;
+}
+
+// ---------- Majority Vote ----------
+bool majority_init(majority_t* v, int window) {
+    if (window < 1 || window > MAJORITY_MAX_WINDOW) return false;
+    memset(v, 0, sizeof(*v));
+    v->window = (uint8_t)window;
+    return true;
+}
+
+int majority_update(majority_t* v, int category) {
+    uint8_t c = (uint8_t)(category < 0 || category >= MAJORITY_CLASSES ? 0 : category);
+    if (v->count == v->window) {
+        uint8_t gone = v->ring[v->idx];
+        v->counts[gone]--;
+        if (gone == v->mode) {
+            // The mode lost a vote; another class may now lead.
+            for (int k = 0; k < MAJORITY_CLASSES; k++) {
+                if (v->counts[k] > v->counts[v->mode]) v->mode = (uint8_t)k;
+            }
+        }
+    } else {
+        v->count++;
+    }
+    v->ring[v->idx] = c;
+    v->idx = (uint8_t)((v->idx + 1) % v->window);
+    v->counts[c]++;
+    // Ties keep the current mode, so a single misread cannot flip it.
+    if (v->counts[c] > v->counts[v->mode]) v->mode = c;
+    return v->mode;
+}
+
+int majority_votes(const majority_t* v) {
+    return v->counts[v->mode];
+}
+
+bool majority_strict(const majority_t* v) {
+    return v->counts[v->mode] * 2 > v->count;
+}
+
+// ---------- Filtered Sensor ----------
+void filtered_sensor_init(filtered_sensor_t* f, uint8_t sn, sensor_read_fn read,
+                          int median_window, int ema_shift) {
+    memset(f, 0, sizeof(*f));
+    f->sn = sn;
+    f->read = read;
+    f->min_valid = INT32_MIN;
+    f->max_valid = INT32_MAX;
+    f->use_median = median_init(&f->median, median_window);
+    f->use_ema = ema_shift > 0;
+    ema_init(&f->ema, ema_shift);
+}
+
+void filtered_sensor_set_range(filtered_sensor_t* f, int min_valid, int max_valid) {
+    f->min_valid = min_valid;
+    f->max_valid = max_valid;
+}
+
+bool filtered_sensor_read(filtered_sensor_t* f, int* value) {
+    int raw = 0;
+    if (!f->read(f->sn, &raw)) {
+        f->errors++;
+    } else if (raw < f->min_valid || raw > f->max_valid) {
+        f->rejected++;
+    } else {
+        int v = raw;
+        f->samples++;
+        if (f->use_median) v = median_update(&f->median, v);
+        if (f->use_ema)    v = ema_update(&f->ema, v);
+        f->value = v;
+        f->valid = true;
+    }
+    if (f->valid) *value = f->value;
+    return f->valid;
+}
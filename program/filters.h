@@ -0,0 +1,80 @@
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Streaming sensor filters with fixed capacity: no allocation, state lives
+// in the struct, every update is O(log n) or better.
+
+#define MEDIAN_MAX_WINDOW   15
+#define MAJORITY_MAX_WINDOW 15
+#define MAJORITY_CLASSES    16  // categories 0..15 (color indexes fit)
+
+// --- Running median (two-heap mediator, O(log n) per sample) ---
+typedef struct {
+    int data[MEDIAN_MAX_WINDOW];        // ring of samples
+    int8_t pos[MEDIAN_MAX_WINDOW];      // heap slot of each ring entry
+    int8_t heap[MEDIAN_MAX_WINDOW];     // ring indexes: max-heap < 0 <= min-heap
+    uint8_t window, count, idx, mid;
+} median_filter_t;
+
+bool median_init(median_filter_t* m, int window);   // 1..MEDIAN_MAX_WINDOW
+int  median_update(median_filter_t* m, int value);  // returns the new median
+int  median_value(const median_filter_t* m);
+
+// --- Integer EMA, alpha = 1 / 2^shift ---
+typedef struct {
+    int32_t acc;                // value << shift
+    uint8_t shift;
+    bool primed;
+} ema_t;
+
+void ema_init(ema_t* e, int shift);                 // 0..15
+int  ema_update(ema_t* e, int value);
+int  ema_value(const ema_t* e);
+
+// --- Hysteresis classifier ---
+typedef struct {
+    int low, high;              // switch off below low, on above high
+    bool state;
+} hysteresis_t;
+
+void hysteresis_init(hysteresis_t* h, int low, int high, bool initial);
+bool hysteresis_update(hysteresis_t* h, int value);
+
+// --- Majority vote over a categorical window ---
+typedef struct {
+    uint8_t ring[MAJORITY_MAX_WINDOW];
+    uint8_t counts[MAJORITY_CLASSES];
+    uint8_t window, count, idx, mode;
+} majority_t;
+
+bool majority_init(majority_t* v, int window);      // 1..MAJORITY_MAX_WINDOW
+int  majority_update(majority_t* v, int category);  // returns the most frequent category
+int  majority_votes(const majority_t* v);           // votes for the current mode
+bool majority_strict(const majority_t* v);          // mode holds more than half the window
+
+// --- Filtered sensor: range gate -> median -> EMA over a read function ---
+typedef bool (*sensor_read_fn)(uint8_t sn, int* value);
+
+typedef struct {
+    uint8_t sn;
+    sensor_read_fn read;
+    int min_valid, max_valid;   // readings outside are rejected as outliers
+    bool use_median, use_ema;
+    median_filter_t median;
+    ema_t ema;
+    int value;
+    bool valid;
+    uint32_t samples, rejected, errors;
+} filtered_sensor_t;
+
+// median_window 0 and ema_shift 0 disable that stage.
+void filtered_sensor_init(filtered_sensor_t* f, uint8_t sn, sensor_read_fn read,
+                          int median_window, int ema_shift);
+void filtered_sensor_set_range(filtered_sensor_t* f, int min_valid, int max_valid);
+// Reads once and updates the filter; false until a valid sample was seen.
+bool filtered_sensor_read(filtered_sensor_t* f, int* value);
+
+#endif // FILTERS_H
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <string.h>
+#include "ev3.h"
+#include "gestures.h"
+
+static const uint8_t button_masks[GESTURE_BUTTONS] = {
+    EV3_KEY_UP, EV3_KEY_DOWN, EV3_KEY_LEFT, EV3_KEY_RIGHT, EV3_KEY_CENTER, EV3_KEY_BACK
+};
+static const char* button_names[GESTURE_BUTTONS] = {
+    "UP", "DOWN", "LEFT", "RIGHT", "CENTER", "BACK"
+};
+
+static const gesture_config_t default_config = {
+    .debounce_ms   = 20,
+    .long_press_ms = 600,
+    .double_tap_ms = 250,
+    .chord_ms      = 60,
+};
+
+// Wrap-safe "a is at or after b"
+static bool time_reached(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) >= 0;
+}
+
+// ---------- Setup ----------
+void gesture_init(gesture_t* g, const gesture_config_t* cfg) {
+    memset(g, 0, sizeof(*g));
+    g->cfg = cfg ? *cfg : default_config;
+}
+
+// ---------- Event Queue ----------
+static void emit(gesture_t* g, gesture_type_t type, uint8_t keys, uint32_t t_ms) {
+    uint8_t next = (uint8_t)((g->head + 1) & (GESTURE_QUEUE_SIZE - 1));
+    if (next == g->tail) {
+        g->dropped++;
+        return;
+    }
+    g->queue[g->head] = (gesture_event_t){ .type = (uint8_t)type, .keys = keys, .t_ms = t_ms };
+    g->head = next;
+}
+
+bool gesture_poll(gesture_t* g, gesture_event_t* ev) {
+    if (g->tail == g->head) return false;
+    *ev = g->queue[g->tail];
+    g->tail = (uint8_t)((g->tail + 1) & (GESTURE_QUEUE_SIZE - 1));
+    return true;
+}
+
+// ---------- State Machine ----------
+static void accept_press(gesture_t* g, int i, uint32_t t) {
+    gesture_button_t* b = &g->buttons[i];
+    b->stable = 1;
+    b->press_t = t;
+    b->long_fired = 0;
+    b->in_chord = 0;
+    b->double_tapped = 0;
+    emit(g, GESTURE_PRESS, button_masks[i], t);
+
+    // Chord: other buttons that went down within chord_ms of this one.
+    uint8_t chord = 0;
+    for (int j = 0; j < GESTURE_BUTTONS; j++) {
+        gesture_button_t* o = &g->buttons[j];
+        if (j != i && o->stable && (uint32_t)(t - o->press_t) <= g->cfg.chord_ms) {
+            chord |= button_masks[j];
+        }
+    }
+    if (chord) {
+        chord |= button_masks[i];
+        for (int j = 0; j < GESTURE_BUTTONS; j++) {
+            if (chord & button_masks[j]) {
+                g->buttons[j].in_chord = 1;
+                g->buttons[j].tap_pending = 0;
+            }
+        }
+        emit(g, GESTURE_CHORD, chord, t);
+        return;
+    }
+
+    if (b->tap_pending && (uint32_t)(t - b->release_t) <= g->cfg.double_tap_ms) {
+        b->double_tapped = 1;
+        emit(g, GESTURE_DOUBLE_TAP, button_masks[i], t);
+    }
+    b->tap_pending = 0;
+}
+
+static void accept_release(gesture_t* g, int i, uint32_t t) {
+    gesture_button_t* b = &g->buttons[i];
+    b->stable = 0;
+    emit(g, GESTURE_RELEASE, button_masks[i], t);
+    // Only a plain short tap can start a double tap.
+    b->tap_pending = !(b->long_fired || b->in_chord || b->double_tapped);
+    b->release_t = t;
+}
+
+void gesture_tick(gesture_t* g, uint32_t now_ms) {
+    // Debounce: a level counts once it held for debounce_ms; the event is
+    // stamped with the original edge time. Settled edges are applied oldest
+    // first so chords see their members in order.
+    while (true) {
+        int first = -1;
+        for (int i = 0; i < GESTURE_BUTTONS; i++) {
+            gesture_button_t* b = &g->buttons[i];
+            if (b->raw == b->stable || !time_reached(now_ms, b->raw_since + g->cfg.debounce_ms)) continue;
+            if (first < 0 || !time_reached(b->raw_since, g->buttons[first].raw_since)) first = i;
+        }
+        if (first < 0) break;
+        if (g->buttons[first].raw) accept_press(g, first, g->buttons[first].raw_since);
+        else                       accept_release(g, first, g->buttons[first].raw_since);
+    }
+
+    for (int i = 0; i < GESTURE_BUTTONS; i++) {
+        gesture_button_t* b = &g->buttons[i];
+        if (b->stable && !b->long_fired && !b->in_chord) {
+            uint32_t due = b->press_t + g->cfg.long_press_ms;
+            // A release edge before 'due' that is still debouncing wins.
+            bool released_first = !b->raw && !time_reached(b->raw_since, due);
+            if (!released_first && time_reached(now_ms, due)) {
+                b->long_fired = 1;
+                emit(g, GESTURE_LONG_PRESS, button_masks[i], due);
+            }
+        }
+
+        if (b->tap_pending && !b->raw && !time_reached(b->release_t + g->cfg.double_tap_ms, now_ms)) {
+            b->tap_pending = 0;
+        }
+    }
+}
+
+void gesture_input(gesture_t* g, uint8_t keys, uint32_t t_ms) {
+    // Settle everything that was due before this sample first.
+    gesture_tick(g, t_ms);
+    for (int i = 0; i < GESTURE_BUTTONS; i++) {
+        gesture_button_t* b = &g->buttons[i];
+        uint8_t level = (keys & button_masks[i]) ? 1 : 0;
+        if (level != b->raw) {
+            b->raw = level;
+            b->raw_since = t_ms;
+        }
+    }
+    if (g->cfg.debounce_ms == 0) gesture_tick(g, t_ms);
+}
+
+bool gesture_next_deadline(const gesture_t* g, uint32_t* t_ms) {
+    bool any = false;
+    uint32_t best = 0;
+    for (int i = 0; i < GESTURE_BUTTONS; i++) {
+        const gesture_button_t* b = &g->buttons[i];
+        uint32_t due;
+        if (b->raw != b->stable) {
+            due = b->raw_since + g->cfg.debounce_ms;
+        } else if (b->stable && !b->long_fired && !b->in_chord) {
+            due = b->press_t + g->cfg.long_press_ms;
+        } else {
+            continue;
+        }
+        if (!any || !time_reached(due, best)) best = due;
+        any = true;
+    }
+    if (any) *t_ms = best;
+    return any;
+}
+
+// ---------- Names ----------
+const char* gesture_type_name(uint8_t type) {
+    switch (type) {
+        case GESTURE_PRESS:      return "PRESS";
+        case GESTURE_RELEASE:    return "RELEASE";
+        case GESTURE_LONG_PRESS: return "LONG_PRESS";
+        case GESTURE_DOUBLE_TAP: return "DOUBLE_TAP";
+        case GESTURE_CHORD:      return "CHORD";
+    }
+    return "?";
+}
+
+const char* gesture_keys_name(uint8_t keys, char* buf, size_t size) {
+    size_t len = 0;
+    if (size == 0) return buf;
+    buf[0] = '\0';
+    for (int i = 0; i < GESTURE_BUTTONS; i++) {
+        if (!(keys & button_masks[i])) continue;
+        int n = snprintf(buf + len, size - len, "%s%s", len ? "+" : "", button_names[i]);
+        if (n < 0 || (size_t)n >= size - len) break;
+        len += (size_t)n;
+    }
+    return buf;
+}
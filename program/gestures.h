@@ -0,0 +1,74 @@
+#ifndef GESTURES_H
+#define GESTURES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Button gesture recognizer: a per-button state machine fed with timestamped
+// key masks (from the event loop or ev3_read_keys). Every emitted event
+// carries the time the gesture logically happened (press edge, press +
+// long-press delay, ...), so results do not depend on how often the caller
+// ticks. Fixed footprint, no allocation.
+//
+// Times are in milliseconds on any monotonic clock; wrap-around is handled.
+
+#define GESTURE_BUTTONS     6   // UP, DOWN, LEFT, RIGHT, CENTER, BACK
+#define GESTURE_QUEUE_SIZE  16  // power of two
+
+typedef enum {
+    GESTURE_PRESS,
+    GESTURE_RELEASE,
+    GESTURE_LONG_PRESS,
+    GESTURE_DOUBLE_TAP,
+    GESTURE_CHORD,              // two or more buttons pressed within chord_ms
+} gesture_type_t;
+
+typedef struct {
+    uint8_t type;               // gesture_type_t
+    uint8_t keys;               // EV3_KEY_* mask (several bits for chords)
+    uint32_t t_ms;
+} gesture_event_t;
+
+typedef struct {
+    uint16_t debounce_ms;
+    uint16_t long_press_ms;
+    uint16_t double_tap_ms;     // max gap between release and the next press
+    uint16_t chord_ms;          // max spread between presses of a chord
+} gesture_config_t;
+
+typedef struct {
+    uint8_t raw;                // last raw level
+    uint8_t stable;             // debounced level
+    uint8_t long_fired;
+    uint8_t in_chord;
+    uint8_t tap_pending;        // released after a short tap
+    uint8_t double_tapped;      // current press already completed a double tap
+    uint32_t raw_since;
+    uint32_t press_t;
+    uint32_t release_t;
+} gesture_button_t;
+
+typedef struct {
+    gesture_config_t cfg;
+    gesture_button_t buttons[GESTURE_BUTTONS];
+    gesture_event_t queue[GESTURE_QUEUE_SIZE];
+    uint8_t head, tail;
+    uint16_t dropped;
+} gesture_t;
+
+// --- Setup ---
+void gesture_init(gesture_t* g, const gesture_config_t* cfg);   // cfg NULL = defaults
+
+// --- Input ---
+void gesture_input(gesture_t* g, uint8_t keys, uint32_t t_ms);  // raw key mask seen at t_ms
+void gesture_tick(gesture_t* g, uint32_t now_ms);               // fire pending timeouts
+bool gesture_next_deadline(const gesture_t* g, uint32_t* t_ms); // when gesture_tick() is next needed
+
+// --- Output ---
+bool gesture_poll(gesture_t* g, gesture_event_t* ev);
+const char* gesture_type_name(uint8_t type);
+// Formats a key mask as "UP+CENTER"; returns buf.
+const char* gesture_keys_name(uint8_t keys, char* buf, size_t size);
+
+#endif // GESTURES_H
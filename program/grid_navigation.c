@@ -4,11 +4,28 @@
 #include <time.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include "ev3.h"
 #include "ev3_sensor.h"
 #include "ev3_tacho.h"
 #include "sensor_methods.h"
+#include "discovery.h"
+#include "timing.h"
+#include "filters.h"
+#include "stall_watch.h"
+#include "logger.h"
+#include "map_render.h"
+#include "audio_cache.h"
+#include "speech.h"
+#include "explore.h"
+#include "dstar_lite.h"
+#include "route_cache.h"
+#include "localize.h"
+#include "pipeline.h"
+#include "latency_stats.h"
+#include "trace.h"
+#include "sensor_modes.h"
 
 // ======= CONSTANTS AND GLOBAL VARIABLES =======
 #define START_X 0
@@ -18,6 +35,10 @@
 #define N 4
 #define R 4
 
+// Start and end tiles; main() takes others as "sx sy ex ey"
+int start_x = START_X, start_y = START_Y;
+int end_x = END_X, end_y = END_Y;
+
 // Color Constants for Traversable and Non-Traversable Tiles
 // Define Color Constants for easier swapping
 #define TRAVERSABLE_COLOR_1 6   // Default traversable color 1 (e.g., White)
@@ -31,6 +52,47 @@
 #define TILE_LENGTH 253       // mm
 #define RETURN_LENGTH 70      // mm
 
+// Tile moves follow a velocity profile, so the peak speed can be above SPEED
+// without wheel slip. move_for_time(SPEED, TILE_LENGTH * 1000 / SPEED) turned
+// the wheels TILE_LENGTH degrees, so the profiled move covers the same.
+// With TILE_ACCEL 0 the move is constant-speed at TILE_PEAK_SPEED.
+#define TILE_PEAK_SPEED 400    // deg/s
+#define TILE_ACCEL 1000        // deg/s^2
+#define TILE_JERK 8000         // deg/s^3
+const motion_limits_t tile_limits = { TILE_PEAK_SPEED, TILE_ACCEL, TILE_JERK };
+
+// Straight runs: consecutive known-free tiles ahead are crossed in one move,
+// so only the run pays for speeding up and slowing down. The color under the
+// robot is sampled RUN_SAMPLE_DEG into each tile on the way.
+#define RUN_PEAK_SPEED 900     // deg/s, just under the large motor's top speed
+#define RUN_SAMPLE_DEG (TILE_LENGTH * 3 / 4)
+#define RUN_SETTLE_MS 100      // after cutting a run short, before re-centering
+const motion_limits_t run_limits = { RUN_PEAK_SPEED, TILE_ACCEL, TILE_JERK };
+
+// Exploration: unknown tiles are chosen by expected gain per travel time.
+// Times of one profiled tile and of tank_turn(70, ...) by 90 and 180 degrees.
+#define EXPLORE_MOVE_MS 1160
+#define EXPLORE_TURN90_MS 2900
+#define EXPLORE_TURN180_MS 5600
+const explore_costs_t explore_costs = { EXPLORE_MOVE_MS, EXPLORE_TURN90_MS, EXPLORE_TURN180_MS };
+explorer_t explorer;
+explorer_t ahead_explorer;      // what-if copy for deciding ahead
+
+// Route to the goal, repaired incrementally as dark tiles are found
+dstar_t route;
+
+// Routes over the field stored by earlier runs
+route_cache_t routes;
+bool route_ready = false;
+
+// Position tracking against the stored field: the pose is corrected once
+// the color readings make another tile clearly more likely.
+#define LOC_PARTICLES 4096
+#define LOC_TRUST 0.6f
+localizer_t loc;
+bool loc_ready = false;
+int pose_corrections = 0;
+
 // Directions: 0=NORTH, 1=EAST, 2=SOUTH, 3=WEST
 #define NORTH 0
 #define EAST  1
@@ -45,6 +107,87 @@ int x_pos = START_X;
 int y_pos = START_Y;
 int current_dir = NORTH;
 
+// Live map on console and LCD
+#define MAP_VIEW_W 16
+#define MAP_VIEW_H 12
+#define MAP_FB_PATH "/dev/fb0"
+map_renderer_t map_view;
+
+// Sound effects, decoded once at startup and played without blocking
+enum { SFX_TURN_LEFT, SFX_TURN_RIGHT, SFX_REVERSE, SFX_OBSTACLE, SFX_ARRIVED, SFX_START, SFX_COUNT };
+const char* sfx_files[SFX_COUNT] = {
+    "/home/robot/sounds/line_1_turning_left.wav",
+    "/home/robot/sounds/line_2_turning_right.wav",
+    "/home/robot/sounds/line_3_reversing.wav",
+    "/home/robot/sounds/line_4_black_detected.wav",
+    "/home/robot/sounds/line_7_arrived_at_destination.wav",
+    "/home/robot/sounds/line_8_starting_trip.wav"
+};
+int sfx_clips[SFX_COUNT];
+bool arrival_queued = false;    // wait for the clip before shutting audio down
+
+// Spoken decisions, prerendered at startup; the clip is the fallback when
+// speech is unavailable
+#define SPEECH_CACHE_BYTES (512 * 1024)
+enum { SAY_TURN_LEFT, SAY_TURN_RIGHT, SAY_OBSTACLE, SAY_BACKTRACK, SAY_COUNT };
+const char* say_text[SAY_COUNT] = { "turning left", "turning right", "obstacle", "backtracking" };
+const int say_fallback[SAY_COUNT] = { SFX_TURN_LEFT, SFX_TURN_RIGHT, SFX_OBSTACLE, -1 };
+bool speech_ready = false;
+
+// Startup timing: program start to the first motor command
+uint64_t boot_ns = 0;
+bool moved_yet = false;
+
+// Straight-run statistics
+int runs_made = 0;
+int run_tiles = 0;
+uint64_t run_ns = 0;
+
+// Navigation pipeline messages (see NAVIGATION PIPELINE below)
+#define RUN_MAX_TILES (N > R ? N : R)
+enum { ACT_NONE, ACT_RUN, ACT_RETREAT };
+
+// Act -> sense: what the last action did
+typedef struct {
+    int turned;                 // quarters clockwise
+    int moved;                  // tiles crossed
+    bool collided;              // the tile after the last one crossed is blocked
+    int read;                   // tiles read mid-run
+    int8_t colors[RUN_MAX_TILES];
+} act_report_t;
+
+// Sense -> plan
+typedef struct {
+    act_report_t rep;
+    int color;                  // voted color of the tile the robot is on
+} observation_t;
+
+// Plan -> act
+typedef struct {
+    int kind;
+    int dir;
+    int quarters;               // turn before moving
+    int tiles;
+    char why[64];               // logged when the action is sent
+} action_t;
+
+// The move decided ahead, for the pose the current one should end at
+typedef struct {
+    bool valid;
+    int x, y, dir, tiles;
+    action_t next;
+    int map[N][R];              // the map with the tiles crossed taken as free
+} plan_ahead_t;
+
+pipeline_t nav_pipe;
+bool pipe_ready = false;
+bool lockstep = false;          // "--lockstep": stages in turn on one thread
+bool first_move = true;
+action_t last_action;
+plan_ahead_t ahead;
+int plans_ahead = 0;
+int plans_ahead_used = 0;
+
 // Color sensor(s)
 #define MAX_SENSORS 4
 uint8_t color_sensors[MAX_SENSORS];
@@ -75,70 +218,136 @@ bool in_bounds(int x, int y) {
     return (x >= 0 && x < R && y >= 0 && y < N);
 }
 
-// Print the current map grid
+// Glyph shown for a tile by the map renderer
+char tile_glyph(int x, int y) {
+    if (x_pos == x && y_pos == y) return GLYPH_ROBOT;
+    if (map[y][x] == 2) return GLYPH_BLOCKED;
+    if (map[y][x] == 1) return GLYPH_FREE;
+    return GLYPH_UNKNOWN;
+}
+
+// Update a map tile and the renderer's copy of it
+void set_tile(int x, int y, int value) {
+    map[y][x] = value;
+    explore_set_cell(&explorer, x, y, (uint8_t)value);
+    dstar_set_blocked(&route, x, y, value == 2);
+    if (route_ready) route_cache_set_cell(&routes, x, y, (uint8_t)value);
+    map_render_set_cell(&map_view, x, y, tile_glyph(x, y));
+}
+
+// Move the robot marker; only the two affected cells are redrawn
+void set_robot_pos(int x, int y) {
+    int old_x = x_pos, old_y = y_pos;
+    x_pos = x;
+    y_pos = y;
+    if (in_bounds(old_x, old_y)) map_render_set_cell(&map_view, old_x, old_y, tile_glyph(old_x, old_y));
+    if (in_bounds(x, y))         map_render_set_cell(&map_view, x, y, tile_glyph(x, y));
+}
+
+// Draw the tiles that changed since the last call
 void print_map() {
-    printf("\nMaze Map (Y-down):\n");
-    for (int y = N-1; y >= 0; y--) {
-        for (int x = 0; x < R; x++) {
-            if (x_pos == x && y_pos == y)
-                printf("R ");
-            else if (map[y][x] == 2)
-                printf("N ");
-            else if (map[y][x] == 1)
-                printf("T ");
-            else
-                printf("⋅ ");
-        }
-        printf("\n");
-    }
-    printf("\n");
+    TRACE_SCOPE("ui", "print_map");
+    map_render_follow(&map_view, x_pos, y_pos);
+    map_render_flush(&map_view);
 }
 
 
 // Get tile color using the first color sensor (0=none, 1=black, 5=red, 6=white, 7=brown)
+// Majority of a few quick reads, so one misread at a tile edge does not
+// mark the tile as an obstacle
+#define COLOR_VOTES 5
+#define COLOR_VOTE_GAP_MS 3
 int get_current_tile_color() {
+    TRACE_SCOPE("sense", "color_vote");
+    if (color_sensor_count < 1) return 0;
+    majority_t vote;
+    majority_init(&vote, COLOR_VOTES);
     int color = 0;
-    if (color_sensor_count > 0) {
-        get_color_value(color_sensors[0], &color);
+    for (int i = 0; i < COLOR_VOTES; i++) {
+        if (i > 0) Sleep(COLOR_VOTE_GAP_MS);
+        int sample = 0;
+        get_color_value(color_sensors[0], &sample);
+        color = majority_update(&vote, sample);
+        // Stop early once the remaining reads cannot change the outcome.
+        if (majority_votes(&vote) * 2 > COLOR_VOTES) break;
     }
+    if (!majority_strict(&vote))
+        log_debug("DEBUG: Color vote without majority, using %d (%d/%d)\n", color, majority_votes(&vote), COLOR_VOTES);
     return color;
 }
 
+// Queue a sound effect (no-op if it failed to load); true if queued
+bool play_sfx(int sfx) {
+    return sfx >= 0 && sfx_clips[sfx] >= 0 && audio_play(sfx_clips[sfx]);
+}
+
+// Announce a decision without waiting for synthesis or playback
+void announce(int phrase) {
+    if (!speech_ready || !speech_say(say_text[phrase], SPEECH_DEFAULT_SPEED, SPEECH_DEFAULT_PITCH))
+        play_sfx(say_fallback[phrase]);
+}
+
+// Report time-to-first-motion once, right before the first motor command
+void mark_first_motion() {
+    if (moved_yet) return;
+    moved_yet = true;
+    log_info("Time to first motion: %llu ms (discovery %llu ms)\n",
+             (unsigned long long)((now_ns() - boot_ns) / 1000000),
+             (unsigned long long)(discovery_time_ns() / 1000000));
+}
+
 // Turn robot to left (CCW 90°) or right (CW 90°)
 void turn_left_90() {
+    announce(SAY_TURN_LEFT);
+    mark_first_motion();
     tank_turn(70, 90); // 90 degrees CCW
-    current_dir = (current_dir + 3) % 4;
 }
 void turn_right_90() {
+    announce(SAY_TURN_RIGHT);
+    mark_first_motion();
     tank_turn(70, -90); // 90 degrees CW
-    current_dir = (current_dir + 1) % 4;
 }
 void turn_around_180() {
+    mark_first_motion();
     tank_turn(70, 180); // 180 degrees
-    current_dir = (current_dir + 2) % 4;
 }
-// Move robot forward one tile and update position
-// Move robot forward one tile and update position
-// Move robot forward one tile and update position
-void move_forward_one_tile() {
-    move_for_time(SPEED, (TILE_LENGTH * 1000) / SPEED);
-    x_pos += dx[current_dir];
-    y_pos += dy[current_dir];
-
-    // Get the current tile's color
-    int color = get_current_tile_color();
-
-    // Mark tile as visited (traversable) unless it's an obstacle (black/red/white)
-    if (color != NON_TRAVERSABLE_COLOR_1 && color != NON_TRAVERSABLE_COLOR_2) {
-        map[y_pos][x_pos] = 1; // Mark the tile as traversable (visited)
+// Turn by quarters clockwise: 1 = right, 3 = left, 2 = around
+void turn_quarters(int quarters) {
+    if (quarters == 1) turn_right_90();
+    else if (quarters == 3) turn_left_90();
+    else if (quarters == 2) {
+        announce(SAY_BACKTRACK);
+        turn_around_180();
     }
 }
-
+// Move robot forward one tile
+// Returns false if the move hit something: the report then says so and the
+// robot drives back to where it started.
+bool move_forward_one_tile(act_report_t* rep) {
+    mark_first_motion();
+    int start_deg = 0, end_deg = 0;
+    get_tacho_position(left_motor, &start_deg);
+    move_for_degrees_profiled(TILE_LENGTH, &tile_limits);
+    stall_event_t stall;
+    if (stall_watch_event(&stall)) {
+        log_info("Collision (%s, detected in %u ms) moving one tile.\n", stall_reason_name(stall.reason),
+                 stall.detect_us / 1000);
+        announce(SAY_OBSTACLE);
+        rep->collided = true;
+        get_tacho_position(left_motor, &end_deg);
+        move_for_degrees(SPEED, start_deg - end_deg);
+        return false;
+    }
+    rep->moved++;
+    return true;
+}
 
 
 
 // Move robot backward return length (when hitting obstacle, don't update position)
 void move_backward_return() {
+    play_sfx(SFX_REVERSE);
+    mark_first_motion();
     move_for_time(-SPEED, (RETURN_LENGTH * 1000) / SPEED);
 }
 
@@ -146,23 +355,74 @@ void move_backward_return() {
 // Set up all sensors and motors, initialize map to zero
 bool initialize_robot() {
     printf("Initializing...\n");
-    ev3_sensor_init();
-    ev3_tacho_init();
+    if (discovery_init(NULL) == DISCOVERY_FAILED) {
+        printf("Device discovery failed.\n");
+        return false;
+    }
+    discovery_print(stdout);
     if (!init_motors()) {
         printf("Failed to initialize motors.\n");
         return false;
     }
+    if (!stall_watch_start(left_motor, right_motor)) {
+        printf("Stall watch unavailable, collisions go unnoticed.\n");
+    }
     color_sensor_count = init_all_color_sensors(color_sensors, MAX_SENSORS);
     if (color_sensor_count < 1) {
         printf("No color sensor found.\n");
         return false;
     }
+    smode_start_all();              // modes settle during the rest of the setup
+    if (!map_render_init(&map_view, R, N, MAP_VIEW_W, MAP_VIEW_H)) {
+        printf("Failed to allocate map renderer.\n");
+        return false;
+    }
+    if (!explore_init(&explorer, R, N, &explore_costs)) {
+        printf("Failed to allocate explorer.\n");
+        return false;
+    }
+    explore_set_goal(&explorer, end_x, end_y);
+    if (!explore_init(&ahead_explorer, R, N, &explore_costs)) {
+        printf("Failed to allocate explorer.\n");
+        return false;
+    }
+    if (!dstar_init(&route, R, N, end_x, end_y)) {
+        printf("Failed to allocate route planner.\n");
+        return false;
+    }
+    dstar_set_start(&route, x_pos, y_pos);
+    map_render_open_console(&map_view);
+    map_render_open_fb(&map_view, MAP_FB_PATH, 0, 0, 0);
     for (int y = 0; y < N; y++)
         for (int x = 0; x < R; x++)
-            map[y][x] = 0;
+            set_tile(x, y, 0);
+    if (audio_init(NULL, 0, true)) {
+        for (int i = 0; i < SFX_COUNT; i++)
+            sfx_clips[i] = audio_load_wav(sfx_files[i]);
+        speech_ready = speech_init(SPEECH_CACHE_BYTES);
+        for (int i = 0; speech_ready && i < SAY_COUNT; i++)
+            speech_prerender(say_text[i], SPEECH_DEFAULT_SPEED, SPEECH_DEFAULT_PITCH);
+    } else {
+        printf("Audio unavailable, running silent.\n");
+        for (int i = 0; i < SFX_COUNT; i++)
+            sfx_clips[i] = -1;
+    }
     srand(time(NULL));
     printf("Init done. Starting at (%d,%d) facing %s\n", x_pos, y_pos, dir_to_str(current_dir));
-    map[START_Y][START_X] = 1;  // Mark start position as traversable
+    // Start from the field an earlier run left behind; tiles found to have
+    // changed are corrected as the robot drives over them.
+    uint8_t field[N * R];
+    if (route_field_load(ROUTE_FIELD_FILE, R, N, field)) {
+        route_ready = route_cache_build(&routes, R, N, field);
+        for (int y = 0; y < N; y++)
+            for (int x = 0; x < R; x++)
+                set_tile(x, y, field[y * R + x]);
+        printf("Loaded stored field, route cache built in %llu us.\n",
+               (unsigned long long)(routes.build_ns / 1000));
+        loc_ready = localize_init(&loc, R, N, field, LOC_PARTICLES);
+        if (loc_ready) localize_reset_at(&loc, start_x, start_y, current_dir);
+    }
+    set_tile(start_x, start_y, 1);  // Mark start position as traversable
     return true;
 }
 
@@ -172,133 +432,328 @@ bool is_tile_open(int x, int y) {
     return in_bounds(x, y) && (map[y][x] == 0 || map[y][x] == 1);
 }
 
-// Pick next direction: random left/right if both are open, otherwise deterministic
-// Returns -1 if must backtrack, else 0 for left, 1 for right
-int pick_next_direction() {
-    int left_dir = (current_dir + 3) % 4;
-    int right_dir = (current_dir + 1) % 4;
-    int lx = x_pos + dx[left_dir], ly = y_pos + dy[left_dir];
-    int rx = x_pos + dx[right_dir], ry = y_pos + dy[right_dir];
-
-    bool left_in_bounds = in_bounds(lx, ly);
-    bool right_in_bounds = in_bounds(rx, ry);
-
-    bool left_open = left_in_bounds && is_tile_open(lx, ly);
-    bool right_open = right_in_bounds && is_tile_open(rx, ry);
-
-    if (!left_in_bounds)
-        printf("DEBUG: Left move blocked by edge at (%d,%d)\n", lx, ly);
-    if (!right_in_bounds)
-        printf("DEBUG: Right move blocked by edge at (%d,%d)\n", rx, ry);
-
-    if (left_open && right_open) {
-        printf("DEBUG: Both left (%d,%d) and right (%d,%d) are open. Choosing randomly.\n", lx, ly, rx, ry);
-        return rand() % 2; // random: 0=left, 1=right
-    } else if (left_open) {
-        printf("DEBUG: Only left (%d,%d) is open.\n", lx, ly);
-        return 0; // Turn left
-    } else if (right_open) {
-        printf("DEBUG: Only right (%d,%d) is open.\n", rx, ry);
-        return 1; // Turn right
-    } else {
-        printf("DEBUG: No open left/right tiles. Must backtrack.\n");
-        return -1; // Need to backtrack
-    }
+// Next step towards the goal from (x, y), from the route cache or D* Lite
+int route_next_dir(int x, int y, int dir, bool cached) {
+    return cached ? route_cache_next_dir(&routes, x, y, end_x, end_y) : dstar_next_dir(&route, x, y, dir);
 }
 
+// Tiles to drive straight on from (x, y) along the route: up to where it
+// turns, the first unvisited tile in m (which has to be read) or the goal.
+int route_run_length(int (*m)[R], int x, int y, int dir, bool cached) {
+    int tiles = 0;
+    while (true) {
+        x += dx[dir];
+        y += dy[dir];
+        tiles++;
+        if (m[y][x] == 0 || (x == end_x && y == end_y)) break;
+        if (route_next_dir(x, y, dir, cached) != dir) break;
+    }
+    return tiles;
+}
 
-void navigation_loop() {
-    bool first_move = true;
-
-    while (!(x_pos == END_X && y_pos == END_Y)) {
-        print_map();
-
-        // Step 1: Color detection and logic...
-
-        // When an obstacle is detected, the robot turns 180 and checks left/right
-        int color = get_current_tile_color();
-        if (color == NON_TRAVERSABLE_COLOR_1 || color == NON_TRAVERSABLE_COLOR_2) {  // Black or Red = obstacle
-            printf("Obstacle detected at (%d,%d).\n", x_pos, y_pos);
-            map[y_pos][x_pos] = 2; // Mark as non-traversable
-            move_backward_return();
-            turn_around_180();
-            // After 180° turn, choose to go left, right, or backtrack
-            int next_turn = pick_next_direction();
-
-            if (next_turn == -1) {
-                printf("No open left/right. Backtracking...\n");
-                move_forward_one_tile(); // Backtrack
-            } else if (next_turn == 0) {
-                printf("Turning +90° (CCW).\n");
-                turn_left_90();
-            } else if (next_turn == 1) {
-                printf("Turning -90° (CW).\n");
-                turn_right_90();
-            }
-            move_forward_one_tile(); // After turning, move forward one tile
-            continue;
+typedef struct {
+    int tiles;          // tiles in the run
+    int sampled;        // tiles entered and read so far
+    bool dark;          // stopped on an obstacle-colored reading
+    act_report_t* rep;
+} straight_run_t;
+
+// Called from the motion loop: reads the color as each tile boundary is
+// crossed. The last tile is read after landing with the usual vote. A dark
+// reading ends the run on that tile, where the vote decides whether it
+// really is an obstacle.
+bool on_run_progress(void* ctx, int traveled_deg, int speed_sp) {
+    (void)speed_sp;
+    straight_run_t* run = ctx;
+    while (run->sampled < run->tiles - 1 && traveled_deg >= run->sampled * TILE_LENGTH + RUN_SAMPLE_DEG) {
+        int color = 0;
+        get_color_value(color_sensors[0], &color);
+        run->rep->colors[run->sampled++] = (int8_t)color;
+        run->rep->read = run->sampled;
+        if (color == NON_TRAVERSABLE_COLOR_1 || color == NON_TRAVERSABLE_COLOR_2) {
+            log_info("Dark reading %d tile(s) into the run, stopping there.\n", run->sampled);
+            run->dark = true;
+            return false;
         }
+    }
+    return true;
+}
 
-        // Step 2: Mark tile as visited (white or brown)
-        if (color == TRAVERSABLE_COLOR_1 || color == TRAVERSABLE_COLOR_2) {
-            map[y_pos][x_pos] = 1; // Mark tile as visited
-        }
+// Crosses `tiles` tiles straight ahead in one continuous move. Returns false
+// if the move hit something, like move_forward_one_tile().
+bool move_forward_run(int tiles, act_report_t* rep) {
+    TRACE_SCOPE("motion", "move_forward_run");
+    if (tiles <= 1) return move_forward_one_tile(rep);
+    mark_first_motion();
+    straight_run_t run = { .tiles = tiles, .rep = rep };
+    int start_deg = 0, end_deg = 0;
+    get_tacho_position(left_motor, &start_deg);
+    uint64_t t0 = now_ns();
+    bool finished = move_for_degrees_tracked(tiles * TILE_LENGTH, &run_limits, on_run_progress, &run);
+
+    stall_event_t stall;
+    if (stall_watch_event(&stall)) {
+        log_info("Collision (%s) %d tile(s) into a straight run.\n", stall_reason_name(stall.reason),
+                 run.sampled);
+        announce(SAY_OBSTACLE);
+        rep->collided = true;
+        rep->moved += run.sampled;
+        get_tacho_position(left_motor, &end_deg);
+        move_for_degrees(SPEED, start_deg + run.sampled * TILE_LENGTH - end_deg);
+        return false;
+    }
+    if (!finished) {
+        // Cut short: come back to the center of the tile the robot is on.
+        Sleep(RUN_SETTLE_MS);
+        get_tacho_position(left_motor, &end_deg);
+        move_for_degrees(SPEED, start_deg + run.sampled * TILE_LENGTH - end_deg);
+    }
+    uint64_t elapsed = now_ns() - t0;
+    int crossed = finished ? tiles : run.sampled;
+    rep->moved += crossed;
+    runs_made++;
+    run_tiles += crossed;
+    run_ns += elapsed;
+    log_info("Straight run: %d/%d tiles in %llu ms%s.\n", crossed, tiles, (unsigned long long)(elapsed / 1000000),
+             run.dark ? ", stopped on a dark tile" : "");
+    return true;
+}
 
-        // ----- FIXED first_move block -----
-        if (first_move) {
-            int fx = x_pos + dx[current_dir], fy = y_pos + dy[current_dir];
-            if (in_bounds(fx, fy) && is_tile_open(fx, fy)) {
-                printf("Moving forward to (%d,%d)...\n", fx, fy);
-                move_forward_one_tile();
-            } else {
-                printf("At map edge on first move, not moving forward.\n");
-            }
-            first_move = false;
-            continue;
-        }
-        // ----- END FIX -----
+bool is_dark(int color) {
+    return color == NON_TRAVERSABLE_COLOR_1 || color == NON_TRAVERSABLE_COLOR_2;
+}
+
+bool is_traversable(int color) {
+    return color == TRAVERSABLE_COLOR_1 || color == TRAVERSABLE_COLOR_2;
+}
+
+// Feeds a tile reading to the localizer and moves the robot to the pose it
+// settles on when that differs from the counted one. Returns true if it did.
+bool check_pose(int color) {
+    TRACE_SCOPE("plan", "check_pose");
+    if (!loc_ready) return false;
+    localize_observe(&loc, is_dark(color));
+    int lx, ly, ldir;
+    float confidence;
+    if (!localize_estimate(&loc, &lx, &ly, &ldir, &confidence) || confidence < LOC_TRUST) return false;
+    if (lx == x_pos && ly == y_pos && ldir == current_dir) return false;
+    log_info("Position correction: (%d,%d) %s -> (%d,%d) %s (%.0f%% sure).\n", x_pos, y_pos,
+             dir_to_str(current_dir), lx, ly, dir_to_str(ldir), confidence * 100);
+    set_robot_pos(lx, ly);
+    current_dir = ldir;
+    pose_corrections++;
+    return true;
+}
+
+// ====== NAVIGATION PIPELINE ======
+// sense -> plan -> act -> sense. The act stage owns the motors, the sense
+// stage the tile vote; the map, the planners and the pose belong to the
+// plan stage, which learns what a move did from the act stage's report.
+// While the robot drives, the plan stage redraws the map and decides the
+// next move for where the current one should end, so when the reading
+// there agrees the next move goes out without planning in between.
+
+// Decide the next move from pose (x, y, dir) on map m, whose explorer is
+// ex; false if there is none. The live map and pose are only read.
+bool decide(action_t* a, int (*m)[R], explorer_t* ex, int x, int y, int dir) {
+    TRACE_SCOPE("plan", "decide");
+    memset(a, 0, sizeof(*a));
+    a->kind = ACT_RUN;
+
+    // ---- CACHED ROUTE ----
+    // On a stored field the route over known free tiles is a table lookup.
+    int cached_dir = route_ready ? route_next_dir(x, y, dir, true) : -1;
+    if (cached_dir >= 0) {
+        a->dir = cached_dir;
+        a->tiles = route_run_length(m, x, y, cached_dir, true);
+        snprintf(a->why, sizeof(a->why), "Cached route: %s for %d tile(s).", dir_to_str(a->dir), a->tiles);
+        return true;
+    }
+
+    // ---- ROUTE TO GOAL ----
+    // While the map allows a route to the goal, follow the shortest one,
+    // counting unvisited tiles as free. D* Lite repairs it as dark tiles
+    // turn up instead of searching again from scratch.
+    dstar_set_start(&route, x, y);
+    if (dstar_plan(&route)) {
+        a->dir = dstar_next_dir(&route, x, y, dir);
+        a->tiles = route_run_length(m, x, y, a->dir, false);
+        snprintf(a->why, sizeof(a->why), "Route: %d tile(s) to goal, %s for %d tile(s).",
+                 dstar_distance(&route, x, y), dir_to_str(a->dir), a->tiles);
+        return true;
+    }
+
+    // ---- FRONTIER EXPLORATION ----
+    // The goal is cut off: map what is left, heading for the unknown tile
+    // with the best expected gain per travel time, turns included.
+    int tiles = 0;
+    int next_dir = explore_next_dir(ex, x, y, dir, &tiles);
+    if (next_dir < 0) return false;
+    int tx = x, ty = y;
+    explore_target(ex, &tx, &ty);
+    a->dir = next_dir;
+    a->tiles = tiles;
+    snprintf(a->why, sizeof(a->why), "Exploring towards (%d,%d): %s for %d tile(s).", tx, ty, dir_to_str(next_dir),
+             tiles);
+    return true;
+}
 
-        // ---- NEW FORWARD-CHECK LOGIC ----
+// Updates the pose, map and localizer from what the last action did.
+void apply_report(const act_report_t* rep) {
+    TRACE_SCOPE("plan", "apply_report");
+    if (rep->turned) {
+        current_dir = (current_dir + rep->turned) % 4;
+        if (loc_ready) localize_turn(&loc, rep->turned);
+    }
+    for (int k = 0; k < rep->moved; k++) {
+        set_robot_pos(x_pos + dx[current_dir], y_pos + dy[current_dir]);
+        if (loc_ready) localize_move(&loc, 1);
+        if (k >= rep->read || rep->colors[k] == 0) continue;
+        if (loc_ready) localize_observe(&loc, is_dark(rep->colors[k]));
+        if (is_traversable(rep->colors[k])) set_tile(x_pos, y_pos, 1);
+    }
+    int nx = x_pos + dx[current_dir], ny = y_pos + dy[current_dir];
+    if (rep->collided && in_bounds(nx, ny)) {
+        log_info("Treating (%d,%d) as an obstacle.\n", nx, ny);
+        set_tile(nx, ny, 2);
+    }
+}
+
+pipe_result_t sense_stage(void* ctx, const void* in, void* out) {
+    (void)ctx;
+    observation_t* ob = out;
+    ob->rep = *(const act_report_t*)in;
+    ob->color = get_current_tile_color();
+    return PIPE_PASS;
+}
+
+pipe_result_t plan_stage(void* ctx, const void* in, void* out) {
+    (void)ctx;
+    const observation_t* ob = in;
+    action_t* a = out;
+    int color = ob->color;
+
+    bool as_planned = ahead.valid && ob->rep.moved == ahead.tiles && !ob->rep.collided && is_traversable(color);
+    for (int k = 0; as_planned && k < ob->rep.read; k++) as_planned = is_traversable(ob->rep.colors[k]);
+    ahead.valid = false;
+    last_action.kind = ACT_NONE;
+
+    apply_report(&ob->rep);
+    if (!in_bounds(x_pos, y_pos)) {
+        log_info("Moved out of bounds! Ending navigation.\n");
+        return PIPE_END;
+    }
+    if (check_pose(color)) as_planned = false;
+    as_planned = as_planned && x_pos == ahead.x && y_pos == ahead.y && current_dir == ahead.dir;
+    if (x_pos == end_x && y_pos == end_y) return PIPE_END;
+
+    // When an obstacle is detected, the robot returns to the tile it came
+    // from and the next move is planned from there
+    if (is_dark(color)) {  // Black or Red = obstacle
+        log_info("Obstacle detected at (%d,%d).\n", x_pos, y_pos);
+        announce(SAY_OBSTACLE);
+        set_tile(x_pos, y_pos, 2); // Mark as non-traversable
+        memset(a, 0, sizeof(*a));
+        a->kind = ACT_RETREAT;
+        last_action = *a;
+        return PIPE_PASS;
+    }
+
+    // Mark tile as visited (white or brown)
+    if (is_traversable(color)) {
+        set_tile(x_pos, y_pos, 1); // Mark tile as visited
+    }
+
+    if (first_move) {
+        first_move = false;
         int fx = x_pos + dx[current_dir], fy = y_pos + dy[current_dir];
         if (in_bounds(fx, fy) && is_tile_open(fx, fy)) {
-            printf("Moving forward to (%d,%d)...\n", fx, fy);
-            move_forward_one_tile();
-            continue;
+            memset(a, 0, sizeof(*a));
+            a->kind = ACT_RUN;
+            a->dir = current_dir;
+            a->tiles = 1;
+            snprintf(a->why, sizeof(a->why), "Moving forward to (%d,%d)...", fx, fy);
         } else {
-            printf("DEBUG: Forward move blocked by edge at (%d,%d)\n", fx, fy);
+            log_info("At map edge on first move, not moving forward.\n");
+            if (!decide(a, map, &explorer, x_pos, y_pos, current_dir)) return PIPE_END;
         }
+    } else if (as_planned) {
+        *a = ahead.next;
+        plans_ahead_used++;
+    } else if (!decide(a, map, &explorer, x_pos, y_pos, current_dir)) {
+        log_info("No reachable unknown tiles left.\n");
+        return PIPE_END;
+    }
+    log_info("%s\n", a->why);
+    a->quarters = (a->dir - current_dir + 4) % 4;
+    last_action = *a;
+    return PIPE_PASS;
+}
 
-        // Otherwise, check left/right for alternative routes
-        int next_turn = pick_next_direction();
-        if (next_turn == -1) {
-            printf("No open left/right. Backtracking...\n");
-            turn_around_180();
-            move_forward_one_tile();
-            continue;
-        } else if (next_turn == 0) {
-            printf("Turning +90° (CCW).\n");
-            turn_left_90();
-        } else if (next_turn == 1) {
-            printf("Turning -90° (CW).\n");
-            turn_right_90();
-        }
+// Runs while the act stage drives: redraws the map, then decides the move
+// after this one for the pose the robot should end at, with the tiles it
+// crosses taken as free. That map is a copy (and so is the explorer's), so
+// the display and the live planners never see the guess. D* Lite counts
+// unvisited tiles as free already and needs no copy; the route cache only
+// knows visited tiles, so a guess there is conservative.
+void plan_after(void* ctx) {
+    (void)ctx;
+    print_map();
+    if (last_action.kind != ACT_RUN) return;
+    ahead.dir = last_action.dir;
+    ahead.tiles = last_action.tiles;
+    ahead.x = x_pos + dx[ahead.dir] * ahead.tiles;
+    ahead.y = y_pos + dy[ahead.dir] * ahead.tiles;
+    if (!in_bounds(ahead.x, ahead.y) || (ahead.x == end_x && ahead.y == end_y)) return;
+    if (!explore_copy_map(&ahead_explorer, &explorer)) return;
+    memcpy(ahead.map, map, sizeof(map));
+    for (int k = 1; k <= ahead.tiles; k++) {
+        int tx = x_pos + dx[ahead.dir] * k, ty = y_pos + dy[ahead.dir] * k;
+        if (ahead.map[ty][tx] == 1) continue;
+        ahead.map[ty][tx] = 1;
+        explore_set_cell(&ahead_explorer, tx, ty, 1);
+    }
+    ahead.valid = decide(&ahead.next, ahead.map, &ahead_explorer, ahead.x, ahead.y, ahead.dir);
+    if (ahead.valid) plans_ahead++;
+}
 
-        // After turning, move forward one tile
-        int nx = x_pos + dx[current_dir], ny = y_pos + dy[current_dir];
-        if (in_bounds(nx, ny) && is_tile_open(nx, ny)) {
-            printf("Moving forward to (%d,%d)...\n", nx, ny);
-            move_forward_one_tile();
-        } else {
-            printf("DEBUG: Forward move blocked by edge at (%d,%d)\n", nx, ny);
-        }
+pipe_result_t act_stage(void* ctx, const void* in, void* out) {
+    (void)ctx;
+    const action_t* a = in;
+    act_report_t* rep = out;
+    memset(rep, 0, sizeof(*rep));
+    if (a->kind == ACT_RETREAT) {
+        move_backward_return();
+        turn_around_180();
+        rep->turned = 2;
+        move_forward_one_tile(rep); // Back to the previous tile
+    } else if (a->kind == ACT_RUN) {
+        turn_quarters(a->quarters);
+        rep->turned = a->quarters;
+        move_forward_run(a->tiles, rep);
+    }
+    return PIPE_PASS;
+}
 
-        // Safety: Check bounds
-        if (!in_bounds(x_pos, y_pos)) {
-            printf("Moved out of bounds! Ending navigation.\n");
-            break;
-        }
+void navigation_loop() {
+    const pipe_stage_t stages[PIPE_STAGES] = {
+        { .name = "sense", .fn = sense_stage, .out_size = sizeof(observation_t) },
+        { .name = "plan", .fn = plan_stage, .after = plan_after, .out_size = sizeof(action_t) },
+        { .name = "act", .fn = act_stage, .out_size = sizeof(act_report_t) },
+    };
+    if (!pipe_init(&nav_pipe, stages, lockstep)) {
+        log_info("Could not set up the navigation pipeline.\n");
+        return;
+    }
+    pipe_ready = true;
+    print_map();
+    act_report_t start = { 0 };     // nothing done yet: read the start tile
+    pipe_inject(&nav_pipe, 0, &start);
+    pipe_run(&nav_pipe);
+    if (x_pos == end_x && y_pos == end_y) {
+        log_info("Reached end position (%d,%d).\n", x_pos, y_pos);
+        arrival_queued = play_sfx(SFX_ARRIVED);
     }
-    printf("Reached end position (%d,%d).\n", x_pos, y_pos);
 }
 
 
@@ -306,23 +761,17 @@ void navigation_loop() {
 // After navigation, print map with legend
 void print_final_grid() {
     printf("\nFinal Map:\n");
-    for (int y = N-1; y >= 0; y--) {
-        for (int x = 0; x < R; x++) {
-            // Print robot's position
-            if (x == x_pos && y == y_pos) {
-                printf("R "); // Robot position
-            }
-            else if (map[y][x] == 2) {
-                printf("N "); // Non-traversable (obstacle)
-            }
-            else if (map[y][x] == 1) {
-                printf("T "); // Traversable (visited)
-            }
-            else {
-                printf("⋅ "); // Unvisited
-            }
-        }
-        printf("\n");
+    map_render_print(&map_view, stdout);
+}
+
+// Store the map for the next run on this field
+void save_field() {
+    uint8_t field[N * R];
+    for (int y = 0; y < N; y++)
+        for (int x = 0; x < R; x++)
+            field[y * R + x] = (uint8_t)map[y][x];
+    if (!route_field_save(ROUTE_FIELD_FILE, R, N, field)) {
+        printf("Could not store the field.\n");
     }
 }
 
@@ -339,8 +788,27 @@ void print_tile_value(int x, int y) {
 
 
 // ========== MAIN ===========
-int main() {
+int main(int argc, char** argv) {
     printf("==== EV3 Grid Navigation ====\n");
+    boot_ns = now_ns();
+    trace_enable(true);
+    trace_thread_name("main");
+    if (argc > 1 && strcmp(argv[argc - 1], "--lockstep") == 0) {
+        lockstep = true;
+        argc--;
+    }
+    if (argc == 5) {
+        start_x = atoi(argv[1]);
+        start_y = atoi(argv[2]);
+        end_x = atoi(argv[3]);
+        end_y = atoi(argv[4]);
+        if (!in_bounds(start_x, start_y) || !in_bounds(end_x, end_y)) {
+            printf("Usage: %s [start_x start_y end_x end_y] [--lockstep], tiles within %dx%d\n", argv[0], R, N);
+            return 1;
+        }
+        x_pos = start_x;
+        y_pos = start_y;
+    }
 
     if (ev3_init() < 1) {
         printf("Error: ev3_init failed.\n");
@@ -351,10 +819,60 @@ int main() {
         return 1;
     }
 
+    log_start();
+    play_sfx(SFX_START);
     navigation_loop();
+    log_stop();
+    if (log_dropped() > 0) {
+        printf("Log: %llu messages dropped.\n", (unsigned long long)log_dropped());
+    }
 
     print_final_grid();
+    if (runs_made > 0) {
+        double secs = run_ns / 1e9;
+        printf("Straight runs: %d covering %d tiles, %.2f tiles/s (%.0f deg/s).\n", runs_made, run_tiles,
+               run_tiles / secs, run_tiles * TILE_LENGTH / secs);
+    }
+    if (pipe_ready) {
+        pipe_print_stats(&nav_pipe, stdout);
+        printf("Moves decided ahead: %d, %d used.\n", plans_ahead, plans_ahead_used);
+        pipe_free(&nav_pipe);
+    }
 
+    if (arrival_queued) audio_wait_idle(3000);
+    audio_print_stats(stdout);
+    audio_shutdown();
+    if (speech_ready) {
+        speech_print_stats(stdout);
+        speech_shutdown();
+    }
+    if (stall_watch_active()) {
+        stall_watch_print_stats(stdout);
+        stall_watch_stop();
+    }
+    explore_print_stats(&explorer, stdout);
+    explore_free(&explorer);
+    explore_free(&ahead_explorer);
+    dstar_print_stats(&route, stdout);
+    dstar_free(&route);
+    save_field();
+    if (route_ready) {
+        route_cache_print_stats(&routes, stdout);
+        route_cache_free(&routes);
+    }
+    if (loc_ready) {
+        localize_print_stats(&loc, stdout);
+        printf("%d position corrections\n", pose_corrections);
+        localize_free(&loc);
+    }
+    smode_print_stats(stdout);
+    lat_print_stats(stdout);
+    trace_enable(false);
+    trace_print_stats(stdout);
+    if (trace_write_json(TRACE_FILE)) printf("Timeline written to %s\n", TRACE_FILE);
+    else printf("Could not write the timeline to %s\n", TRACE_FILE);
+    map_render_free(&map_view);
+    discovery_close();
     ev3_uninit();
     printf("Program complete.\n");
     print_tile_value(3, 3);  
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "ev3.h"
+#include "ev3_sensor.h"
+#include "ev3_tacho.h"
+#include "scheduler.h"
+#include "sensor_modes.h"
+#include "timing.h"
+#include "logger.h"
+#include "gyro_service.h"
+
+#define GYRO_MODE           "GYRO-RATE"
+#define GYRO_STILL_MS       150     // motors idle this long = robot at rest
+#define GYRO_STILL_RATE     4       // deg/s; more than this at rest is real motion
+#define GYRO_BIAS_WARMUP    64      // plain average over the first samples
+#define GYRO_BIAS_SHIFT     7       // then an EMA with alpha = 1/128
+#define UDEG                1000000 // fixed point: micro-degrees
+
+typedef struct {
+    uint8_t sn_gyro, sn_left, sn_right;
+    uint64_t start_ns;
+    uint64_t last_ns;
+    uint64_t idle_since_ns;     // 0 while a motor runs
+    bool motors_idle;
+
+    int64_t bias_sum;           // warm-up accumulator, micro-deg/s
+    uint32_t bias_count;
+
+    uint64_t samples, read_errors, still_samples;
+} gyro_state_t;
+
+static scheduler_t gyro_sched;
+static gyro_state_t state;
+static _Atomic bool active = false;
+static _Atomic int64_t heading_udeg = 0;    // integrated since start
+static _Atomic int64_t zero_udeg = 0;       // captured by gyro_service_zero()
+static _Atomic int64_t bias_udeg = 0;       // micro-deg/s
+static _Atomic bool stationary = false;
+static _Atomic bool ready = false;
+
+// ---------- Motion State ----------
+static bool motor_idle(uint8_t sn) {
+    FLAGS_T flags = TACHO_STATE__NONE_;
+    if (sn >= TACHO_DESC__LIMIT_) return true;
+    if (!get_tacho_state_flags(sn, &flags)) return false;   // unknown: assume moving
+    return !(flags & TACHO_RUNNING);
+}
+
+static void update_motion(gyro_state_t* g, uint64_t t) {
+    g->motors_idle = motor_idle(g->sn_left) && motor_idle(g->sn_right);
+    if (!g->motors_idle)           g->idle_since_ns = 0;
+    else if (!g->idle_since_ns)    g->idle_since_ns = t;
+    bool still = g->motors_idle && g->idle_since_ns &&
+                 t - g->idle_since_ns >= (uint64_t)GYRO_STILL_MS * 1000000ull;
+    atomic_store_explicit(&stationary, still, memory_order_relaxed);
+}
+
+// ---------- Sampling Task ----------
+static bool gyro_task(void* arg) {
+    gyro_state_t* g = arg;
+    uint64_t t = now_ns();
+    uint64_t dt = t - g->last_ns;
+    g->last_ns = t;
+    if (!smode_ready(g->sn_gyro)) return true;     // still settling after the switch
+
+    int raw = 0;
+    if (!get_sensor_value(0, g->sn_gyro, &raw)) {
+        g->read_errors++;
+        return true;
+    }
+    g->samples++;
+    atomic_store_explicit(&ready, true, memory_order_release);
+    int64_t rate = -(int64_t)raw * UDEG;    // CCW positive
+    update_motion(g, t);
+    int64_t bias = atomic_load_explicit(&bias_udeg, memory_order_relaxed);
+    int64_t excess = rate - bias;
+
+    // At rest every reading is bias and the heading cannot change, unless
+    // the rate says otherwise (pushed by hand, motor state lagging).
+    if (atomic_load_explicit(&stationary, memory_order_relaxed) &&
+        excess < GYRO_STILL_RATE * UDEG && excess > -GYRO_STILL_RATE * UDEG) {
+        g->still_samples++;
+        if (g->bias_count < GYRO_BIAS_WARMUP) {
+            g->bias_sum += rate;
+            g->bias_count++;
+            bias = g->bias_sum / g->bias_count;
+        } else {
+            bias += (rate - bias) >> GYRO_BIAS_SHIFT;
+        }
+        atomic_store_explicit(&bias_udeg, bias, memory_order_relaxed);
+        return true;
+    }
+
+    int64_t delta = excess * (int64_t)(dt / 1000) / 1000000;    // udeg/s * us
+    atomic_fetch_add_explicit(&heading_udeg, delta, memory_order_relaxed);
+    return true;
+}
+
+// ---------- Lifecycle ----------
+bool gyro_service_start(uint8_t sn_gyro, uint8_t sn_left, uint8_t sn_right) {
+    if (atomic_load(&active)) gyro_service_stop();
+    if (sn_gyro >= SENSOR_DESC__LIMIT_) return false;
+
+    memset(&state, 0, sizeof(state));
+    // Switch without waiting; the task drops samples until it has settled.
+    smode_request(sn_gyro, GYRO_MODE);
+    if (!smode_start(sn_gyro)) return false;
+    state.sn_gyro = sn_gyro;
+    state.sn_left = sn_left;
+    state.sn_right = sn_right;
+    state.start_ns = state.last_ns = now_ns();
+    // Assume the robot is at rest when the service starts.
+    state.motors_idle = true;
+    state.idle_since_ns = state.start_ns - (uint64_t)GYRO_STILL_MS * 1000000ull;
+    atomic_store(&heading_udeg, 0);
+    atomic_store(&zero_udeg, 0);
+    atomic_store(&bias_udeg, 0);
+    atomic_store(&ready, false);
+
+    sched_init(&gyro_sched);
+    sched_add(&gyro_sched, "gyro", GYRO_SERVICE_PERIOD_US, 0, gyro_task, &state);
+    atomic_store(&active, true);
+    if (!sched_start(&gyro_sched)) {
+        atomic_store(&active, false);
+        return false;
+    }
+    return true;
+}
+
+void gyro_service_stop(void) {
+    if (!atomic_load(&active)) return;
+    sched_stop(&gyro_sched);
+    atomic_store(&active, false);
+}
+
+bool gyro_service_active(void) {
+    return atomic_load(&active);
+}
+
+bool gyro_service_ready(void) {
+    return atomic_load_explicit(&ready, memory_order_acquire);
+}
+
+bool gyro_service_uses(uint8_t sn_gyro) {
+    return atomic_load(&active) && state.sn_gyro == sn_gyro;
+}
+
+// ---------- Heading ----------
+void gyro_service_zero(void) {
+    atomic_store(&zero_udeg, atomic_load(&heading_udeg));
+}
+
+double gyro_service_heading(void) {
+    return (double)(atomic_load(&heading_udeg) - atomic_load(&zero_udeg)) / UDEG;
+}
+
+int gyro_service_angle(void) {
+    int64_t h = atomic_load(&heading_udeg) - atomic_load(&zero_udeg);
+    return (int)((h >= 0 ? h + UDEG / 2 : h - UDEG / 2) / UDEG);
+}
+
+double gyro_service_bias(void) {
+    return (double)atomic_load(&bias_udeg) / UDEG;
+}
+
+bool gyro_service_stationary(void) {
+    return atomic_load(&stationary);
+}
+
+// ---------- Statistics ----------
+void gyro_service_print_stats(FILE* out) {
+    fprintf(out, "--- Gyro service ---\n");
+    fprintf(out, "heading %+.2f deg, bias %+.3f deg/s (%u warm-up samples)\n",
+            gyro_service_heading(), gyro_service_bias(), state.bias_count);
+    fprintf(out, "%llu samples, %llu at rest, %llu read errors\n",
+            (unsigned long long)state.samples, (unsigned long long)state.still_samples,
+            (unsigned long long)state.read_errors);
+    sched_print_stats(&gyro_sched, out);
+}
@@ -0,0 +1,39 @@
+#ifndef GYRO_SERVICE_H
+#define GYRO_SERVICE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Gyro heading service. The sensor stays in GYRO-RATE mode and a scheduler
+// thread integrates the rate stream, so zeroing is an offset capture instead
+// of a GYRO-RATE -> GYRO-ANG mode switch with settle sleeps. While both drive
+// motors report they are not running the robot cannot be turning: those
+// samples refine the bias estimate and are not integrated, which removes the
+// slow drift of the kernel's angle mode over a long run.
+//
+// Angles are degrees, counter-clockwise positive (as get_gyro_angle()).
+
+#define GYRO_SERVICE_PERIOD_US 10000    // 100 Hz
+
+// --- Lifecycle ---
+// Motors may be DESC_LIMIT when unknown; bias is then only learned at start.
+// Switching the sensor into rate mode costs up to ~100 ms before the first
+// sample; sensor_modes decides whether a switch is needed at all.
+bool gyro_service_start(uint8_t sn_gyro, uint8_t sn_left, uint8_t sn_right);
+void gyro_service_stop(void);
+bool gyro_service_active(void);
+bool gyro_service_ready(void);         // first sample integrated
+bool gyro_service_uses(uint8_t sn_gyro);
+
+// --- Heading ---
+void   gyro_service_zero(void);         // current heading becomes 0
+int    gyro_service_angle(void);        // rounded degrees
+double gyro_service_heading(void);      // degrees
+double gyro_service_bias(void);         // deg/s currently subtracted
+bool   gyro_service_stationary(void);
+
+// --- Statistics ---
+void gyro_service_print_stats(FILE* out);
+
+#endif // GYRO_SERVICE_H
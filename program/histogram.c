@@ -0,0 +1,57 @@
+#include <string.h>
+#include "histogram.h"
+
+void hist_reset(histogram_t* h) {
+    memset(h, 0, sizeof(*h));
+}
+
+void hist_merge(histogram_t* dst, const histogram_t* src) {
+    if (src->total == 0) return;
+    for (int i = 0; i < HIST_BUCKETS; i++) dst->counts[i] += src->counts[i];
+    if (dst->total == 0 || src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+    dst->total += src->total;
+    dst->sum += src->sum;
+}
+
+uint64_t hist_bucket_value(int bucket) {
+    if (bucket < HIST_SUB_COUNT) return (uint64_t)bucket;
+    int exp = (bucket - HIST_SUB_COUNT) / HIST_SUB_COUNT + HIST_SUB_BITS;
+    int sub = (bucket - HIST_SUB_COUNT) % HIST_SUB_COUNT;
+    uint64_t lower = ((uint64_t)(HIST_SUB_COUNT + sub)) << (exp - HIST_SUB_BITS);
+    uint64_t width = 1ull << (exp - HIST_SUB_BITS);
+    return lower + width / 2;
+}
+
+uint64_t hist_percentile(const histogram_t* h, double pct) {
+    if (h->total == 0) return 0;
+    if (pct >= 100.0) return h->max;
+    uint64_t rank = (uint64_t)((pct / 100.0) * (double)h->total);
+    if (rank >= h->total) rank = h->total - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > rank) {
+            uint64_t v = hist_bucket_value(i);
+            if (v > h->max) v = h->max;
+            if (v < h->min) v = h->min;
+            return v;
+        }
+    }
+    return h->max;
+}
+
+uint64_t hist_mean(const histogram_t* h) {
+    return h->total ? h->sum / h->total : 0;
+}
+
+void hist_print(const histogram_t* h, FILE* out, const char* label, uint64_t scale, const char* unit) {
+    if (scale == 0) scale = 1;
+    fprintf(out, "%-20s n=%-8llu mean=%llu%s p50=%llu%s p90=%llu%s p99=%llu%s max=%llu%s\n",
+            label, (unsigned long long)h->total,
+            (unsigned long long)(hist_mean(h) / scale), unit,
+            (unsigned long long)(hist_percentile(h, 50.0) / scale), unit,
+            (unsigned long long)(hist_percentile(h, 90.0) / scale), unit,
+            (unsigned long long)(hist_percentile(h, 99.0) / scale), unit,
+            (unsigned long long)(h->max / scale), unit);
+}
@@ -0,0 +1,49 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Log-linear histogram (HDR style): 16 linear sub-buckets per power of two,
+// so every recorded value is kept within ~6% relative error. Fixed size,
+// no allocation; recording is a handful of integer ops.
+
+#define HIST_SUB_BITS  4
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXP   40                      // values up to ~2^40 (~18 min in ns)
+#define HIST_BUCKETS   (HIST_SUB_COUNT + (HIST_MAX_EXP - HIST_SUB_BITS) * HIST_SUB_COUNT)
+
+typedef struct {
+    uint32_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} histogram_t;
+
+static inline int hist_bucket(uint64_t v) {
+    if (v < HIST_SUB_COUNT) return (int)v;
+    int exp = 63 - __builtin_clzll(v);
+    if (exp >= HIST_MAX_EXP) return HIST_BUCKETS - 1;
+    int sub = (int)((v >> (exp - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+    return HIST_SUB_COUNT + (exp - HIST_SUB_BITS) * HIST_SUB_COUNT + sub;
+}
+
+static inline void hist_record(histogram_t* h, uint64_t v) {
+    h->counts[hist_bucket(v)]++;
+    if (h->total == 0 || v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+    h->total++;
+    h->sum += v;
+}
+
+void hist_reset(histogram_t* h);
+void hist_merge(histogram_t* dst, const histogram_t* src);
+uint64_t hist_bucket_value(int bucket);              // representative value of a bucket
+uint64_t hist_percentile(const histogram_t* h, double pct);
+uint64_t hist_mean(const histogram_t* h);
+// One line: count, mean, p50/p90/p99, max. Values are divided by 'scale'
+// (e.g. 1000 to print ns as us) and suffixed with 'unit'.
+void hist_print(const histogram_t* h, FILE* out, const char* label, uint64_t scale, const char* unit);
+
+#endif // HISTOGRAM_H
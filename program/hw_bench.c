@@ -0,0 +1,390 @@
+// hw_bench.c
+// Non-interactive hardware benchmarks: sensor read rates per mode, motor
+// command latency, move and turn accuracy against time, and scan
+// throughput. Results go to stdout as a table and, on request, to CSV
+// and/or JSON files so runs can be compared across firmware and code
+// changes. The mux group runs the color mode multiplexer and reports the
+// rate it achieves per mode. Devices that are not found are skipped, and
+// their results are left out.
+//
+// Usage: hw_bench [--quick] [--csv FILE] [--json FILE] [group ...]
+// Groups: sensors, mux, motors, moves, turns, scan (default: all).
+// The robot needs about half a meter of clear floor in front of it and
+// room to turn in place.
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include "ev3.h"
+#include "ev3_sensor.h"
+#include "ev3_tacho.h"
+#include "sensor_methods.h"
+#include "sensor_modes.h"
+#include "color_mux.h"
+#include "discovery.h"
+#include "histogram.h"
+#include "timing.h"
+
+#define Sleep(ms) usleep((ms) * 1000)
+#define MAX_SENSORS     4
+#define MAX_RESULTS     256
+#define SETTLE_MS       300     // after each move, before reading positions
+
+typedef struct {
+    const char* group;
+    char metric[48];
+    double value;
+    const char* unit;
+} result_t;
+
+static result_t results[MAX_RESULTS];
+static int result_count = 0;
+static bool quick = false;
+
+static int samples(int full) {
+    return quick ? (full / 5 > 0 ? full / 5 : 1) : full;
+}
+
+// ---------- Results ----------
+static __attribute__((format(printf, 4, 5)))
+void add_result(const char* group, const char* unit, double value, const char* fmt, ...) {
+    if (result_count >= MAX_RESULTS) return;
+    result_t* r = &results[result_count++];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(r->metric, sizeof(r->metric), fmt, ap);
+    va_end(ap);
+    r->group = group;
+    r->value = value;
+    r->unit = unit;
+    printf("  %-40s %12.2f %s\n", r->metric, value, unit);
+}
+
+// p50, p99 and max of a latency histogram, in microseconds
+static void add_latency(const char* group, const histogram_t* h, const char* what) {
+    add_result(group, "us", hist_percentile(h, 50.0) / 1000.0, "%s p50", what);
+    add_result(group, "us", hist_percentile(h, 99.0) / 1000.0, "%s p99", what);
+    add_result(group, "us", h->max / 1000.0, "%s max", what);
+}
+
+static bool write_csv(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "group,metric,value,unit\n");
+    for (int i = 0; i < result_count; i++) {
+        fprintf(f, "%s,%s,%.3f,%s\n", results[i].group, results[i].metric, results[i].value, results[i].unit);
+    }
+    return fclose(f) == 0;
+}
+
+static bool write_json(const char* path, const struct utsname* host, uint64_t started_s) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\n  \"host\": {\"kernel\": \"%s\", \"machine\": \"%s\", \"node\": \"%s\"},\n", host->release,
+            host->machine, host->nodename);
+    fprintf(f, "  \"started\": %llu,\n  \"quick\": %s,\n  \"results\": [\n", (unsigned long long)started_s,
+            quick ? "true" : "false");
+    for (int i = 0; i < result_count; i++) {
+        fprintf(f, "    {\"group\": \"%s\", \"metric\": \"%s\", \"value\": %.3f, \"unit\": \"%s\"}%s\n",
+                results[i].group, results[i].metric, results[i].value, results[i].unit,
+                i + 1 < result_count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+// ---------- Sensors ----------
+// Times the first read after a mode request (the switch, and the wait for
+// a value from the new mode) and then a run of back-to-back reads,
+// counting how often the value actually changed.
+static void bench_sensor_mode(const char* label, uint8_t sn, const char* mode, bool (*read_fn)(uint8_t, int*)) {
+    int n = samples(500);
+    smode_request(sn, mode);
+    int v = 0, last = 0, changes = 0, failures = 0;
+    uint64_t t0 = now_ns();
+    read_fn(sn, &last);
+    add_result("sensors", "ms", (now_ns() - t0) / 1e6, "%s %s first read", label, mode);
+
+    histogram_t lat;
+    hist_reset(&lat);
+    uint64_t start = now_ns();
+    for (int i = 0; i < n; i++) {
+        uint64_t t = now_ns();
+        if (!read_fn(sn, &v)) failures++;
+        hist_record(&lat, now_ns() - t);
+        if (v != last) changes++;
+        last = v;
+    }
+    double secs = (now_ns() - start) / 1e9;
+    char what[48];
+    snprintf(what, sizeof(what), "%s %s read", label, mode);
+    add_result("sensors", "reads/s", n / secs, "%s %s rate", label, mode);
+    add_latency("sensors", &lat, what);
+    add_result("sensors", "changes/s", changes / secs, "%s %s value changes", label, mode);
+    add_result("sensors", "count", failures, "%s %s failed reads", label, mode);
+}
+
+static bool read_color_raw(uint8_t sn, int* v) {
+    return smode_ensure(sn) && get_sensor_value(0, sn, v);
+}
+
+static void bench_sensors(void) {
+    printf("Sensors:\n");
+    uint8_t color[MAX_SENSORS];
+    int count = init_all_color_sensors(color, MAX_SENSORS);
+    for (int i = 0; i < count; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), "color%d", i);
+        bench_sensor_mode(label, color[i], "COL-COLOR", get_color_value);
+        bench_sensor_mode(label, color[i], "COL-REFLECT", get_reflect_value);
+        bench_sensor_mode(label, color[i], "COL-AMBIENT", read_color_raw);
+        smode_request(color[i], "COL-COLOR");
+    }
+    uint8_t sn;
+    if (init_ultrasonic(&sn)) bench_sensor_mode("ultrasonic", sn, "US-DIST-CM", get_distance_mm);
+    if (init_gyro(&sn, false)) bench_sensor_mode("gyro", sn, "GYRO-ANG", get_gyro_angle);
+    if (count == 0) printf("  no color sensor\n");
+}
+
+// ---------- Motors ----------
+// Cost of a speed write and of a position read (each one sysfs access),
+// and the time from a run command until the wheel has turned 2 degrees.
+static void bench_motors(void) {
+    printf("Motors:\n");
+    int n = samples(200);
+    histogram_t write_lat, read_lat, response;
+    hist_reset(&write_lat);
+    hist_reset(&read_lat);
+    hist_reset(&response);
+    for (int i = 0; i < n; i++) {
+        uint64_t t = now_ns();
+        set_tacho_speed_sp(left_motor, 200);
+        hist_record(&write_lat, now_ns() - t);
+        int pos;
+        t = now_ns();
+        get_tacho_position(left_motor, &pos);
+        hist_record(&read_lat, now_ns() - t);
+    }
+    add_latency("motors", &write_lat, "speed_sp write");
+    add_latency("motors", &read_lat, "position read");
+
+    int trials = samples(10), timeouts = 0;
+    for (int i = 0; i < trials; i++) {
+        int start = 0, pos = 0;
+        get_tacho_position(left_motor, &start);
+        set_tacho_speed_sp(left_motor, (i & 1) ? -300 : 300);
+        uint64_t t0 = now_ns();
+        set_tacho_command_inx(left_motor, TACHO_RUN_FOREVER);
+        bool moved = false;
+        while (now_ns() - t0 < 500000000ull) {
+            if (get_tacho_position(left_motor, &pos) && abs(pos - start) >= 2) {
+                moved = true;
+                break;
+            }
+        }
+        uint64_t t1 = now_ns();
+        stop_motors();
+        if (moved) hist_record(&response, t1 - t0);
+        else timeouts++;
+        Sleep(SETTLE_MS);
+    }
+    add_latency("motors", &response, "run to 2 deg");
+    add_result("motors", "count", timeouts, "run to 2 deg timeouts");
+}
+
+// ---------- Moves and turns ----------
+// Each configuration drives out and back; error is the tacho count against
+// the target after the robot settles.
+static void bench_moves(void) {
+    printf("Moves:\n");
+    const motion_limits_t profiled[] = { { 400, 1000, 0 }, { 600, 1000, 8000 } };
+    const int distances[] = { 90, 253, 720 };
+    int repeats = samples(3);
+    for (int d = 0; d < 3; d++) {
+        for (int c = -1; c < 2; c++) {          // -1 = move_for_degrees at 300 deg/s
+            histogram_t err, time_ns;
+            hist_reset(&err);
+            hist_reset(&time_ns);
+            for (int r = 0; r < repeats * 2; r++) {
+                int dir = (r & 1) ? -1 : 1, before = 0, after = 0;
+                get_tacho_position(left_motor, &before);
+                uint64_t t0 = now_ns();
+                if (c < 0) move_for_degrees(300, dir * distances[d]);
+                else move_for_degrees_profiled(dir * distances[d], &profiled[c]);
+                hist_record(&time_ns, now_ns() - t0);
+                Sleep(SETTLE_MS);
+                get_tacho_position(left_motor, &after);
+                hist_record(&err, (uint64_t)abs(after - before - dir * distances[d]));
+            }
+            char name[40];
+            if (c < 0) snprintf(name, sizeof(name), "%d deg fixed 300", distances[d]);
+            else snprintf(name, sizeof(name), "%d deg profiled %d", distances[d], profiled[c].v_max);
+            add_result("moves", "ms", hist_mean(&time_ns) / 1e6, "%s time", name);
+            add_result("moves", "deg", (double)hist_mean(&err), "%s error mean", name);
+            add_result("moves", "deg", (double)err.max, "%s error max", name);
+        }
+    }
+}
+
+static void bench_turns(void) {
+    printf("Turns:\n");
+    uint8_t sn_gyro;
+    if (!init_gyro(&sn_gyro, true)) {
+        printf("  no gyro sensor\n");
+        return;
+    }
+    const motion_limits_t profiled = { 300, 800, 0 };
+    const int angles[] = { 90, 180 };
+    int repeats = samples(3);
+    for (int a = 0; a < 2; a++) {
+        for (int c = 0; c < 2; c++) {           // 0 = tank_turn at 70, 1 = profiled
+            histogram_t err, time_ns;
+            hist_reset(&err);
+            hist_reset(&time_ns);
+            for (int r = 0; r < repeats * 2; r++) {
+                int dir = (r & 1) ? -1 : 1, before = 0, after = 0;
+                get_gyro_angle(sn_gyro, &before);
+                uint64_t t0 = now_ns();
+                if (c == 0) tank_turn(70, dir * angles[a]);
+                else tank_turn_profiled(dir * angles[a], &profiled);
+                hist_record(&time_ns, now_ns() - t0);
+                Sleep(SETTLE_MS);
+                get_gyro_angle(sn_gyro, &after);
+                hist_record(&err, (uint64_t)abs(after - before - dir * angles[a]));
+            }
+            const char* name = c == 0 ? "fixed 70" : "profiled 300";
+            add_result("turns", "ms", hist_mean(&time_ns) / 1e6, "%d deg %s time", angles[a], name);
+            add_result("turns", "deg", (double)hist_mean(&err), "%d deg %s error mean", angles[a], name);
+            add_result("turns", "deg", (double)err.max, "%d deg %s error max", angles[a], name);
+        }
+    }
+}
+
+// ---------- Scan ----------
+// One full turn in place while reading the ultrasonic as fast as it
+// answers: samples per second and per 10 degrees of heading.
+static void bench_scan(void) {
+    printf("Scan:\n");
+    uint8_t sn_us, sn_gyro;
+    if (!init_ultrasonic(&sn_us) || !init_gyro(&sn_gyro, true)) {
+        printf("  needs the ultrasonic and gyro sensors\n");
+        return;
+    }
+    int start = 0, angle = 0, dist = 0, reads = 0, valid = 0;
+    get_gyro_angle(sn_gyro, &start);
+    get_distance_mm(sn_us, &dist);      // mode switch outside the timing
+    set_tacho_speed_sp(left_motor,  200);
+    set_tacho_speed_sp(right_motor, -200);
+    uint64_t t0 = now_ns();
+    set_tacho_command_inx(left_motor,  TACHO_RUN_FOREVER);
+    set_tacho_command_inx(right_motor, TACHO_RUN_FOREVER);
+    while (now_ns() - t0 < 20000000000ull) {
+        reads++;
+        if (get_distance_mm(sn_us, &dist)) valid++;
+        if (get_gyro_angle(sn_gyro, &angle) && abs(angle - start) >= 360) break;
+    }
+    double secs = (now_ns() - t0) / 1e9;
+    stop_motors();
+    int swept = abs(angle - start);
+    add_result("scan", "s", secs, "360 deg scan time");
+    add_result("scan", "samples/s", valid / secs, "ultrasonic samples");
+    add_result("scan", "samples", swept ? valid * 10.0 / swept : 0.0, "samples per 10 deg");
+    add_result("scan", "count", reads - valid, "failed reads");
+}
+
+// ---------- Color Mux ----------
+// Color class and reflected intensity from every color sensor at once,
+// wanted vs achieved sample rate and the longest a reading goes stale.
+static void bench_mux(void) {
+    printf("Color mux:\n");
+    static const color_mux_rate_t rates[] = {
+        { "COL-COLOR", 10 },
+        { "COL-REFLECT", 40 },
+    };
+    uint8_t color[MAX_SENSORS];
+    int count = init_all_color_sensors(color, MAX_SENSORS);
+    if (count == 0 || !color_mux_start(color, count, rates, 2)) {
+        printf("  no color sensor\n");
+        return;
+    }
+    Sleep(quick ? 3000 : 15000);
+    color_mux_stop();
+    for (int i = 0; i < count && i < COLOR_MUX_MAX_SENSORS; i++) {
+        for (int m = 0; m < 2; m++) {
+            const char* mode = rates[m].mode;
+            add_result("mux", "Hz", rates[m].hz, "color%d %s wanted", i, mode);
+            add_result("mux", "Hz", color_mux_rate(color[i], mode), "color%d %s achieved", i, mode);
+            add_result("mux", "ms", color_mux_gap(color[i], mode, 99.0) / 1e6, "color%d %s gap p99", i, mode);
+        }
+    }
+    color_mux_print_stats(stdout);
+    for (int i = 0; i < count; i++) smode_request(color[i], "COL-COLOR");
+}
+
+// ---------- Main ----------
+typedef struct {
+    const char* name;
+    void (*run)(void);
+    bool needs_motors;
+} group_t;
+
+static const group_t groups[] = {
+    { "sensors", bench_sensors, false },
+    { "mux", bench_mux, false },
+    { "motors", bench_motors, true },
+    { "moves", bench_moves, true },
+    { "turns", bench_turns, true },
+    { "scan", bench_scan, true },
+};
+static const int group_count = sizeof(groups) / sizeof(groups[0]);
+
+int main(int argc, char** argv) {
+    const char* csv_path = NULL;
+    const char* json_path = NULL;
+    const char* selected[8];
+    int selected_count = 0;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--quick") == 0) quick = true;
+        else if (strcmp(argv[a], "--csv") == 0 && a + 1 < argc) csv_path = argv[++a];
+        else if (strcmp(argv[a], "--json") == 0 && a + 1 < argc) json_path = argv[++a];
+        else if (selected_count < 8) selected[selected_count++] = argv[a];
+    }
+
+    if (ev3_init() < 1) {
+        printf("Error: ev3_init failed. Is the ev3dev daemon running?\n");
+        return 1;
+    }
+    if (discovery_init(NULL) == DISCOVERY_FAILED) {
+        printf("Error: device discovery failed.\n");
+        return 1;
+    }
+    struct utsname host;
+    uname(&host);
+    uint64_t started = (uint64_t)time(NULL);
+    printf("Hardware bench on %s %s%s\n", host.nodename, host.release, quick ? " (quick)" : "");
+    bool have_motors = init_motors();
+
+    for (int g = 0; g < group_count; g++) {
+        bool run = selected_count == 0;
+        for (int s = 0; s < selected_count; s++) {
+            if (strcmp(selected[s], groups[g].name) == 0) run = true;
+        }
+        if (!run) continue;
+        if (groups[g].needs_motors && !have_motors) {
+            printf("%s: skipped, motors not found\n", groups[g].name);
+            continue;
+        }
+        groups[g].run();
+    }
+    if (have_motors) stop_motors();
+
+    if (csv_path && !write_csv(csv_path)) printf("Could not write %s\n", csv_path);
+    if (json_path && !write_json(json_path, &host, started)) printf("Could not write %s\n", json_path);
+    discovery_close();
+    ev3_uninit();
+    return 0;
+}
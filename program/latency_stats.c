@@ -0,0 +1,68 @@
+#include "latency_stats.h"
+
+#ifdef LATENCY_STATS
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* probe_names[LAT_PROBE_COUNT] = {
+#define LAT_NAME(name) #name,
+    LAT_PROBES(LAT_NAME)
+#undef LAT_NAME
+};
+
+_Thread_local lat_thread_t* lat_self;
+
+// Slots are claimed once and never given back: a thread's counters outlive
+// it so its calls still show up in the dump.
+static lat_thread_t* threads[LAT_MAX_THREADS];
+static atomic_int thread_count;
+static _Thread_local bool refused;
+
+// ---------- Registration ----------
+lat_thread_t* lat_register(void) {
+    if (refused) return NULL;
+    int slot = atomic_fetch_add(&thread_count, 1);
+    lat_thread_t* t = slot < LAT_MAX_THREADS ? calloc(1, sizeof(*t)) : NULL;
+    if (!t) {
+        refused = true;
+        return NULL;
+    }
+    threads[slot] = t;
+    lat_self = t;
+    return t;
+}
+
+// ---------- Statistics ----------
+static int registered(void) {
+    int n = atomic_load(&thread_count);
+    return n < LAT_MAX_THREADS ? n : LAT_MAX_THREADS;
+}
+
+void lat_reset(void) {
+    for (int i = 0; i < registered(); i++) {
+        if (threads[i]) memset(threads[i], 0, sizeof(*threads[i]));
+    }
+}
+
+void lat_print_stats(FILE* out) {
+    fprintf(out, "--- Hardware call latency ---\n");
+    int n = registered();
+    for (int p = 0; p < LAT_PROBE_COUNT; p++) {
+        histogram_t merged;
+        hist_reset(&merged);
+        for (int i = 0; i < n; i++) {
+            if (threads[i]) hist_merge(&merged, &threads[i]->ns[p]);
+        }
+        if (merged.total == 0) continue;
+        fprintf(out, "%-26s n=%-8llu p50=%lluus p99=%lluus max=%lluus\n", probe_names[p],
+                (unsigned long long)merged.total, (unsigned long long)(hist_percentile(&merged, 50.0) / 1000),
+                (unsigned long long)(hist_percentile(&merged, 99.0) / 1000), (unsigned long long)(merged.max / 1000));
+    }
+    if (atomic_load(&thread_count) > LAT_MAX_THREADS) {
+        fprintf(out, "(%d threads not recorded)\n", atomic_load(&thread_count) - LAT_MAX_THREADS);
+    }
+}
+
+#endif // LATENCY_STATS
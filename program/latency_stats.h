@@ -0,0 +1,81 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Per-call latency of the hardware wrappers in sensor_methods.c. Each
+// wrapper opens with LAT_SCOPE(name); when it returns, the time spent is
+// recorded in a histogram (histogram.h) owned by the calling thread, so
+// recording takes no lock and no atomic. lat_print_stats() merges every
+// thread's histograms and prints count, p50/p99 and max per wrapper.
+//
+// Build with -DLATENCY_STATS to enable. Without it LAT_SCOPE expands to
+// nothing and lat_print_stats() prints nothing.
+//
+// The dump reads other threads' counters while they may be recording, so
+// numbers printed mid-run can be a call or two behind.
+
+// Every instrumented wrapper, in print order
+#define LAT_PROBES(X) \
+    X(init_gyro) X(init_gyro_service) X(reset_gyro) X(get_gyro_angle) \
+    X(is_button_pressed) \
+    X(init_all_color_sensors) X(get_color_value) X(get_reflect_value) \
+    X(init_ultrasonic) X(get_distance_mm) \
+    X(init_motors) X(set_speed) X(move_for_time) X(move_for_degrees) \
+    X(move_for_degrees_profiled) X(move_for_degrees_tracked) X(tank_turn_profiled) \
+    X(start_tank_turn) X(tank_turn) X(pivot_turn) X(arc_turn) \
+    X(motors_running) X(stop_motors) X(print_motor_stats)
+
+#define LAT_MAX_THREADS 16
+
+typedef enum {
+#define LAT_ENUM(name) LAT_##name,
+    LAT_PROBES(LAT_ENUM)
+#undef LAT_ENUM
+    LAT_PROBE_COUNT
+} lat_probe_t;
+
+#ifdef LATENCY_STATS
+
+#include <stdbool.h>
+#include "histogram.h"
+#include "timing.h"
+
+typedef struct {
+    histogram_t ns[LAT_PROBE_COUNT];
+} lat_thread_t;
+
+typedef struct {
+    lat_probe_t probe;
+    uint64_t t0;
+} lat_scope_t;
+
+extern _Thread_local lat_thread_t* lat_self;
+// Allocates and publishes this thread's counters; NULL once LAT_MAX_THREADS
+// threads have registered (their calls then go unrecorded).
+lat_thread_t* lat_register(void);
+
+static inline void lat_scope_end(lat_scope_t* s) {
+    uint64_t ns = now_ns() - s->t0;
+    lat_thread_t* self = lat_self;
+    if (!self && !(self = lat_register())) return;
+    hist_record(&self->ns[s->probe], ns);
+}
+
+#define LAT_SCOPE(name) \
+    lat_scope_t lat_scope_ __attribute__((cleanup(lat_scope_end))) = { LAT_##name, now_ns() }
+
+void lat_reset(void);
+void lat_print_stats(FILE* out);
+
+#else
+
+#define LAT_SCOPE(name) do { } while (0)
+
+static inline void lat_reset(void) {}
+static inline void lat_print_stats(FILE* out) { (void)out; }
+
+#endif // LATENCY_STATS
+
+#endif // LATENCY_STATS_H
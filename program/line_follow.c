@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "ev3.h"
+#include "ev3_tacho.h"
+#include "sensor_methods.h"
+#include "sensor_modes.h"
+#include "stall_watch.h"
+#include "logger.h"
+#include "timing.h"
+#include "line_follow.h"
+
+// ---------- Setup ----------
+void line_default_config(line_config_t* cfg) {
+    cfg->kp = 96;               // 0.375 deg/s per error unit
+    cfg->ki = 1;
+    cfg->kd = 640;
+    cfg->base_speed = 250;
+    cfg->max_speed = 800;
+    cfg->period_us = LINE_PERIOD_US;
+}
+
+bool line_init(line_follower_t* lf, const uint8_t* sn, int count, const line_config_t* cfg) {
+    memset(lf, 0, sizeof(*lf));
+    if (count < 1) return false;
+    lf->sensors = count > 2 ? 2 : count;
+    for (int i = 0; i < lf->sensors; i++) {
+        lf->sn[i] = sn[i];
+        smode_request(sn[i], "COL-REFLECT");
+        lf->black[i] = 0;
+        lf->white[i] = 100;
+    }
+    if (cfg) lf->cfg = *cfg;
+    else line_default_config(&lf->cfg);
+    return true;
+}
+
+static void set_speeds(int left, int right) {
+    set_tacho_speed_sp(left_motor, left);
+    set_tacho_speed_sp(right_motor, right);
+}
+
+// Starts both motors; while they run forever set_speeds() alone steers.
+static void drive(int left, int right) {
+    set_speeds(left, right);
+    set_tacho_command_inx(left_motor, TACHO_RUN_FOREVER);
+    set_tacho_command_inx(right_motor, TACHO_RUN_FOREVER);
+}
+
+bool line_calibrate(line_follower_t* lf) {
+    int lo[2] = { 100, 100 }, hi[2] = { 0, 0 };
+    // Left, back through the start heading to the right, and back again
+    const int legs[3][2] = { { 1, 1 }, { -1, 2 }, { 1, 1 } };     // { +1 = left, sweep lengths }
+    for (int leg = 0; leg < 3; leg++) {
+        int sign = legs[leg][0], span = legs[leg][1];
+        drive(-sign * LINE_CAL_SPEED, sign * LINE_CAL_SPEED);
+        uint64_t end = now_ns() + (uint64_t)span * LINE_CAL_SWEEP_MS * 1000000ull;
+        while (now_ns() < end) {
+            for (int i = 0; i < lf->sensors; i++) {
+                int v;
+                if (!get_reflect_value(lf->sn[i], &v)) continue;
+                if (v < lo[i]) lo[i] = v;
+                if (v > hi[i]) hi[i] = v;
+            }
+            usleep(lf->cfg.period_us);
+        }
+    }
+    stop_motors();
+    bool ok = true;
+    for (int i = 0; i < lf->sensors; i++) {
+        log_info("Line sensor %d: black %d, white %d\n", i, lo[i], hi[i]);
+        if (hi[i] - lo[i] < LINE_MIN_CONTRAST) {
+            log_warn("line: sensor %d saw too little contrast (%d)\n", i, hi[i] - lo[i]);
+            ok = false;
+            continue;
+        }
+        lf->black[i] = lo[i];
+        lf->white[i] = hi[i];
+    }
+    lf->calibrated = ok;
+    return ok;
+}
+
+// ---------- Control Loop ----------
+static int normalize(const line_follower_t* lf, int i, int raw) {
+    int v = (raw - lf->black[i]) * LINE_SCALE / (lf->white[i] - lf->black[i]);
+    return v < 0 ? 0 : v > LINE_SCALE ? LINE_SCALE : v;
+}
+
+static int clamp(int v, int limit) {
+    return v < -limit ? -limit : v > limit ? limit : v;
+}
+
+static bool line_tick(void* arg) {
+    line_follower_t* lf = arg;
+    uint64_t t0 = now_ns();
+    if (lf->stop && lf->stop(lf->stop_ctx)) {
+        lf->result = LINE_STOPPED;
+        return false;
+    }
+    if (stall_watch_tripped()) {
+        lf->result = LINE_STALLED;
+        return false;
+    }
+
+    int level[2] = { LINE_SCALE / 2, LINE_SCALE / 2 };
+    bool white = true, failed = false;
+    for (int i = 0; i < lf->sensors; i++) {
+        int raw;
+        if (!get_reflect_value(lf->sn[i], &raw)) {
+            lf->read_failures++;
+            failed = true;                  // counts as a tick off the line
+            break;
+        }
+        level[i] = normalize(lf, i, raw);
+        white = white && level[i] >= LINE_LOST_LEVEL;
+    }
+    lf->lost_ticks = white || failed ? lf->lost_ticks + 1 : 0;
+    if (lf->lost_ticks * lf->cfg.period_us >= LINE_LOST_MS * 1000u) {
+        lf->result = LINE_LOST;
+        return false;
+    }
+    if (failed) {
+        // Keep the last setpoints, but let the duration limit run out.
+        if (lf->ticks_left && --lf->ticks_left == 0) {
+            lf->result = LINE_DONE;
+            return false;
+        }
+        return true;
+    }
+
+    int error = lf->sensors == 2 ? level[0] - level[1] : level[0] - LINE_SCALE / 2;
+    lf->integral = clamp(lf->integral + error, LINE_I_LIMIT);
+    int turn = (lf->cfg.kp * error + lf->cfg.ki * lf->integral + lf->cfg.kd * (error - lf->last_error)) /
+               LINE_GAIN_ONE;
+    lf->last_error = error;
+    int left = clamp(lf->cfg.base_speed + turn, lf->cfg.max_speed);
+    int right = clamp(lf->cfg.base_speed - turn, lf->cfg.max_speed);
+    stall_watch_update(abs(left), abs(right));
+    set_speeds(left, right);
+
+    lf->ticks++;
+    lf->err_sq_sum += (uint64_t)(error * error);
+    hist_record(&lf->error, (uint64_t)abs(error));
+    hist_record(&lf->loop_ns, now_ns() - t0);
+    if (lf->ticks_left && --lf->ticks_left == 0) {
+        lf->result = LINE_DONE;
+        return false;
+    }
+    return true;
+}
+
+line_result_t line_follow(line_follower_t* lf, uint32_t duration_ms, line_stop_fn stop, void* ctx) {
+    lf->integral = 0;
+    lf->last_error = 0;
+    lf->lost_ticks = 0;
+    lf->ticks_left = duration_ms ? (uint32_t)((uint64_t)duration_ms * 1000 / lf->cfg.period_us) : 0;
+    if (duration_ms && lf->ticks_left == 0) lf->ticks_left = 1;
+    lf->stop = stop;
+    lf->stop_ctx = ctx;
+    lf->result = LINE_DONE;
+
+    sched_init(&lf->sched);
+    sched_add(&lf->sched, "line-follow", lf->cfg.period_us, 0, line_tick, lf);
+    stall_watch_arm(lf->cfg.base_speed, lf->cfg.base_speed);
+    drive(lf->cfg.base_speed, lf->cfg.base_speed);
+    uint64_t t0 = now_ns();
+    sched_run(&lf->sched);
+    lf->run_ns += now_ns() - t0;
+    stall_watch_disarm();
+    stop_motors();
+    return (line_result_t)lf->result;
+}
+
+int line_find_max_speed(line_follower_t* lf, int from, int to, int step, uint32_t segment_ms) {
+    int base = lf->cfg.base_speed, best = 0;
+    for (int speed = from; step > 0 && speed <= to; speed += step) {
+        lf->cfg.base_speed = speed;
+        uint64_t ticks = lf->ticks, sq = lf->err_sq_sum;
+        line_result_t r = line_follow(lf, segment_ms, NULL, NULL);
+        uint64_t n = lf->ticks - ticks;
+        int rms = n ? (int)sqrt((double)(lf->err_sq_sum - sq) / n) : LINE_SCALE;
+        log_info("Line speed %d deg/s: %s, RMS error %d\n", speed, line_result_name(r), rms);
+        if (r != LINE_DONE || rms > LINE_STABLE_RMS) break;
+        best = speed;
+    }
+    lf->cfg.base_speed = base;
+    lf->max_stable_speed = best;
+    return best;
+}
+
+const char* line_result_name(uint8_t result) {
+    switch (result) {
+        case LINE_DONE:    return "done";
+        case LINE_STOPPED: return "stopped";
+        case LINE_LOST:    return "line lost";
+        case LINE_STALLED: return "stalled";
+    }
+    return "?";
+}
+
+// ---------- Statistics ----------
+void line_print_stats(const line_follower_t* lf, FILE* out) {
+    fprintf(out, "--- Line following ---\n");
+    double secs = lf->run_ns / 1e9;
+    fprintf(out, "%d sensor(s), %llu ticks in %.1f s (%.0f Hz, target %u Hz), %llu failed reads\n",
+            lf->sensors, (unsigned long long)lf->ticks, secs, secs > 0 ? lf->ticks / secs : 0.0,
+            1000000u / lf->cfg.period_us, (unsigned long long)lf->read_failures);
+    fprintf(out, "lateral error RMS %.0f / %d\n", lf->ticks ? sqrt((double)lf->err_sq_sum / lf->ticks) : 0.0,
+            LINE_SCALE);
+    hist_print(&lf->error, out, "  |error|", 1, "");
+    hist_print(&lf->loop_ns, out, "  tick", 1000, "us");
+    if (lf->max_stable_speed) fprintf(out, "max stable speed %d deg/s\n", lf->max_stable_speed);
+    sched_print_stats(&lf->sched, out);
+}
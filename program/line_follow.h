@@ -0,0 +1,97 @@
+#ifndef LINE_FOLLOW_H
+#define LINE_FOLLOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "histogram.h"
+#include "scheduler.h"
+
+// Line following on reflected light. One or two color sensors run in
+// COL-REFLECT mode; a scheduler task reads them at a fixed rate, runs an
+// integer PID on the lateral error and streams speed_sp to both drive
+// motors (run-forever, as in motion_run()).
+//
+// Readings are normalized with per-sensor black/white levels from
+// line_calibrate() to 0 (black) .. LINE_SCALE (white). With one sensor the
+// robot follows the left edge of the line, holding the sensor at the
+// midpoint; with two sensors straddling the line the error is left minus
+// right. A positive error steers right.
+
+#define LINE_SCALE          1000
+#define LINE_GAIN_ONE       256         // gains are in 1/256
+#define LINE_PERIOD_US      4000        // 250 Hz
+#define LINE_I_LIMIT        20000       // integral clamp, in error * ticks
+#define LINE_LOST_LEVEL     900         // every sensor this white ...
+#define LINE_LOST_MS        300         // ... for this long = line lost
+#define LINE_MIN_CONTRAST   15          // reflectance points black -> white
+#define LINE_STABLE_RMS     250         // max RMS error of a stable run
+
+#define LINE_CAL_SPEED      120         // deg/s, wheels turning opposite ways
+#define LINE_CAL_SWEEP_MS   700         // each way from the start heading
+
+typedef struct {
+    int kp, ki, kd;                     // in 1/LINE_GAIN_ONE
+    int base_speed;                     // deg/s
+    int max_speed;                      // per wheel, deg/s
+    uint32_t period_us;
+} line_config_t;
+
+typedef enum {
+    LINE_DONE,                          // ran for the requested time
+    LINE_STOPPED,                       // stop callback returned true
+    LINE_LOST,                          // off the line (or no readings) for LINE_LOST_MS
+    LINE_STALLED,                       // stall watch tripped
+} line_result_t;
+
+// Polled every tick; return true to end the run.
+typedef bool (*line_stop_fn)(void* ctx);
+
+typedef struct {
+    uint8_t sn[2];
+    int sensors;
+    int black[2], white[2];             // calibrated reflectance, 0..100
+    bool calibrated;
+    line_config_t cfg;
+
+    // Run state
+    int integral;
+    int last_error;
+    uint32_t ticks_left;
+    uint32_t lost_ticks;
+    line_stop_fn stop;
+    void* stop_ctx;
+    uint8_t result;                     // line_result_t
+    scheduler_t sched;
+
+    // Statistics, over all runs since line_init()
+    uint64_t ticks;
+    uint64_t read_failures;
+    uint64_t run_ns;
+    uint64_t err_sq_sum;
+    histogram_t error;                  // |lateral error|, 0..LINE_SCALE
+    histogram_t loop_ns;                // read + PID + motor writes
+    int max_stable_speed;               // from line_find_max_speed(), 0 = not measured
+} line_follower_t;
+
+// --- Setup ---
+// Puts the sensors in COL-REFLECT mode; cfg NULL = defaults.
+bool line_init(line_follower_t* lf, const uint8_t* sn, int count, const line_config_t* cfg);
+void line_default_config(line_config_t* cfg);
+// Turns in place over the line, recording each sensor's darkest and
+// brightest reading. Fails if a sensor saw too little contrast.
+bool line_calibrate(line_follower_t* lf);
+
+// --- Running ---
+// Follows the line for up to duration_ms (0 = until stopped or lost).
+line_result_t line_follow(line_follower_t* lf, uint32_t duration_ms, line_stop_fn stop, void* ctx);
+// Raises the base speed from 'from' to 'to' in 'step' increments, one
+// segment_ms run each, and returns the fastest speed that kept the line with
+// an RMS error below LINE_STABLE_RMS (0 if none did).
+int line_find_max_speed(line_follower_t* lf, int from, int to, int step, uint32_t segment_ms);
+const char* line_result_name(uint8_t result);
+
+// --- Statistics ---
+void line_print_stats(const line_follower_t* lf, FILE* out);
+
+#endif // LINE_FOLLOW_H
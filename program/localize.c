@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+#include "explore.h"
+#include "localize.h"
+
+static const int8_t DX[4] = { 0, 1, 0, -1 };   // N, E, S, W
+static const int8_t DY[4] = { 1, 0, -1, 0 };
+
+// ---------- Lifecycle ----------
+bool localize_init(localizer_t* l, int w, int h, const uint8_t* field, int count) {
+    memset(l, 0, sizeof(*l));
+    if (w <= 0 || h <= 0 || count <= 0 || count > LOC_MAX_PARTICLES) return false;
+    size_t n = (size_t)count, cells = (size_t)w * h;
+    l->w = w;
+    l->h = h;
+    l->count = count;
+    l->field  = malloc(cells);
+    l->x      = malloc(n * sizeof(int16_t));
+    l->y      = malloc(n * sizeof(int16_t));
+    l->dir    = malloc(n);
+    l->weight = malloc(n * sizeof(float));
+    l->rng    = malloc(n * sizeof(uint32_t));
+    l->x2     = malloc(n * sizeof(int16_t));
+    l->y2     = malloc(n * sizeof(int16_t));
+    l->dir2   = malloc(n);
+    l->mass   = malloc(cells * 4 * sizeof(float));
+    if (!l->field || !l->x || !l->y || !l->dir || !l->weight || !l->rng || !l->x2 || !l->y2 || !l->dir2 ||
+        !l->mass) {
+        localize_free(l);
+        return false;
+    }
+    memcpy(l->field, field, cells);
+    uint32_t seed = 2463534242u;
+    for (int i = 0; i < count; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        l->rng[i] = seed | 1;                   // xorshift must not start at 0
+    }
+    localize_reset_uniform(l);
+    return true;
+}
+
+void localize_free(localizer_t* l) {
+    free(l->field);
+    free(l->x);
+    free(l->y);
+    free(l->dir);
+    free(l->weight);
+    free(l->rng);
+    free(l->x2);
+    free(l->y2);
+    free(l->dir2);
+    free(l->mass);
+    memset(l, 0, sizeof(*l));
+}
+
+void localize_reset_at(localizer_t* l, int x, int y, int dir) {
+    float w = 1.0f / l->count;
+    for (int i = 0; i < l->count; i++) {
+        l->x[i] = (int16_t)x;
+        l->y[i] = (int16_t)y;
+        l->dir[i] = (uint8_t)(dir & 3);
+        l->weight[i] = w;
+    }
+}
+
+// Spread evenly over every (tile, heading) that is not known to be blocked.
+void localize_reset_uniform(localizer_t* l) {
+    int cells = l->w * l->h, open = 0;
+    for (int c = 0; c < cells; c++) open += (l->field[c] != CELL_BLOCKED);
+    bool all = (open == 0);
+    if (all) open = cells;
+    float w = 1.0f / l->count;
+    int c = -1, k = -1;                         // c is the k-th open tile
+    for (int i = 0; i < l->count; i++) {
+        int pick = (int)((int64_t)i * open * 4 / l->count);
+        while (k < pick / 4) {
+            c++;
+            if (all || l->field[c] != CELL_BLOCKED) k++;
+        }
+        l->x[i] = (int16_t)(c % l->w);
+        l->y[i] = (int16_t)(c / l->w);
+        l->dir[i] = (uint8_t)(pick & 3);
+        l->weight[i] = w;
+    }
+    l->resets++;
+}
+
+// ---------- Motion ----------
+static inline uint32_t xorshift(uint32_t r) {
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    return r;
+}
+
+void localize_move(localizer_t* l, int tiles) {
+    uint64_t t0 = now_ns();
+    int16_t* restrict px = l->x;
+    int16_t* restrict py = l->y;
+    const uint8_t* restrict pd = l->dir;
+    float* restrict pw = l->weight;
+    uint32_t* restrict rng = l->rng;
+    for (int i = 0; i < l->count; i++) {
+        uint32_t r = xorshift(rng[i]);
+        rng[i] = r;
+        uint32_t p = r % 100;
+        int step = tiles - (p < LOC_MISCOUNT_PCT) + (p >= 100 - LOC_MISCOUNT_PCT);
+        int x = px[i] + DX[pd[i]] * step;
+        int y = py[i] + DY[pd[i]] * step;
+        bool inside = x >= 0 && x < l->w && y >= 0 && y < l->h;
+        // Off the field is impossible: drop the weight, keep the index valid.
+        pw[i] = inside ? pw[i] : 0.0f;
+        px[i] = (int16_t)(x < 0 ? 0 : x >= l->w ? l->w - 1 : x);
+        py[i] = (int16_t)(y < 0 ? 0 : y >= l->h ? l->h - 1 : y);
+    }
+    l->updates++;
+    l->update_ns += now_ns() - t0;
+}
+
+void localize_turn(localizer_t* l, int quarters) {
+    uint64_t t0 = now_ns();
+    uint8_t* restrict pd = l->dir;
+    uint32_t* restrict rng = l->rng;
+    for (int i = 0; i < l->count; i++) {
+        uint32_t r = xorshift(rng[i]);
+        rng[i] = r;
+        uint32_t p = r % 100;
+        int q = quarters - (p < LOC_TURN_ERROR_PCT) + (p >= 100 - LOC_TURN_ERROR_PCT);
+        pd[i] = (uint8_t)((pd[i] + q) & 3);
+    }
+    l->updates++;
+    l->update_ns += now_ns() - t0;
+}
+
+// ---------- Observation ----------
+// Systematic resampling: one random offset, N evenly spaced picks.
+static void resample(localizer_t* l) {
+    int n = l->count;
+    float step = 1.0f / n;
+    l->rng[0] = xorshift(l->rng[0]);
+    float u = (l->rng[0] % 65536) / 65536.0f * step;
+    float cum = l->weight[0];
+    int j = 0;
+    for (int i = 0; i < n; i++) {
+        while (u > cum && j < n - 1) cum += l->weight[++j];
+        l->x2[i] = l->x[j];
+        l->y2[i] = l->y[j];
+        l->dir2[i] = l->dir[j];
+        u += step;
+    }
+    memcpy(l->x, l->x2, (size_t)n * sizeof(int16_t));
+    memcpy(l->y, l->y2, (size_t)n * sizeof(int16_t));
+    memcpy(l->dir, l->dir2, (size_t)n);
+    for (int i = 0; i < n; i++) l->weight[i] = step;
+    l->resamples++;
+}
+
+static float reweight(localizer_t* l, const float lik[3]) {
+    const int16_t* restrict px = l->x;
+    const int16_t* restrict py = l->y;
+    const uint8_t* restrict field = l->field;
+    float* restrict pw = l->weight;
+    float sum = 0;
+    for (int i = 0; i < l->count; i++) {
+        pw[i] *= lik[field[py[i] * l->w + px[i]]];
+        sum += pw[i];
+    }
+    return sum;
+}
+
+void localize_observe(localizer_t* l, bool dark) {
+    uint64_t t0 = now_ns();
+    float lik[3];
+    lik[CELL_UNKNOWN] = dark ? LOC_DARK_IF_UNKNOWN : 1.0f - LOC_DARK_IF_UNKNOWN;
+    lik[CELL_FREE]    = dark ? LOC_DARK_IF_FREE    : 1.0f - LOC_DARK_IF_FREE;
+    lik[CELL_BLOCKED] = dark ? LOC_DARK_IF_BLOCKED : 1.0f - LOC_DARK_IF_BLOCKED;
+
+    float sum = reweight(l, lik);
+    if (sum < 1e-20f) {
+        // No particle explains the reading: start over from anywhere.
+        localize_reset_uniform(l);
+        sum = reweight(l, lik);
+    }
+    float inv = 1.0f / sum, sq = 0;
+    for (int i = 0; i < l->count; i++) {
+        l->weight[i] *= inv;
+        sq += l->weight[i] * l->weight[i];
+    }
+    // Resample once the effective particle count drops below half.
+    if (sq * l->count > 2.0f) resample(l);
+    l->updates++;
+    l->update_ns += now_ns() - t0;
+}
+
+// ---------- Estimate ----------
+bool localize_estimate(localizer_t* l, int* x, int* y, int* dir, float* confidence) {
+    int states = l->w * l->h * 4;
+    memset(l->mass, 0, (size_t)states * sizeof(float));
+    float total = 0;
+    for (int i = 0; i < l->count; i++) {
+        l->mass[(l->y[i] * l->w + l->x[i]) * 4 + l->dir[i]] += l->weight[i];
+        total += l->weight[i];
+    }
+    if (total <= 0) return false;
+    int best = 0;
+    for (int s = 1; s < states; s++) {
+        if (l->mass[s] > l->mass[best]) best = s;
+    }
+    *x = (best / 4) % l->w;
+    *y = (best / 4) / l->w;
+    *dir = best & 3;
+    *confidence = l->mass[best] / total;
+    return true;
+}
+
+// ---------- Statistics ----------
+void localize_print_stats(const localizer_t* l, FILE* out) {
+    fprintf(out, "--- Localization ---\n");
+    fprintf(out, "%d particles, %llu updates (%.1f us each), %llu resamples, %llu resets\n", l->count,
+            (unsigned long long)l->updates, l->updates ? l->update_ns / 1000.0 / l->updates : 0.0,
+            (unsigned long long)l->resamples, (unsigned long long)l->resets);
+}
@@ -0,0 +1,67 @@
+#ifndef LOCALIZE_H
+#define LOCALIZE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Particle filter over (tile, heading) against a stored field. Each move
+// shifts every particle by the commanded number of tiles, sometimes one
+// more or one less, and each turn sometimes by a quarter too many or too
+// few; each color reading reweights the particles by how well it matches
+// the stored tile. The estimate is the (tile, heading) holding the most
+// weight, so a mis-counted tile shows up as the belief moving away from
+// the navigator's own x_pos/y_pos.
+//
+// Particles are kept as separate arrays (x[], y[], dir[], weight[], one
+// random state per particle) so the per-particle loops have no dependency
+// between iterations. They stay scalar on the brick's ARM9, which has no
+// SIMD unit, and vectorize on a host build.
+//
+// Coordinates and headings follow grid_navigation.c; field cells are the
+// CELL_* values from explore.h.
+
+#define LOC_MAX_PARTICLES   16384
+#define LOC_MISCOUNT_PCT    5       // moves that end one tile short or long
+#define LOC_TURN_ERROR_PCT  2       // turns off by a quarter
+#define LOC_DARK_IF_BLOCKED 0.90f   // P(dark reading | blocked tile)
+#define LOC_DARK_IF_FREE    0.05f   // P(dark reading | free tile)
+#define LOC_DARK_IF_UNKNOWN 0.30f
+
+typedef struct {
+    int w, h;
+    int count;
+    uint8_t* field;             // copy of the stored field
+    int16_t* x;
+    int16_t* y;
+    uint8_t* dir;
+    float* weight;
+    uint32_t* rng;              // per-particle xorshift state
+    int16_t* x2;                // resampling scratch
+    int16_t* y2;
+    uint8_t* dir2;
+    float* mass;                // (tile, heading) histogram for the estimate
+
+    uint64_t updates, resamples, resets;
+    uint64_t update_ns;         // total time in move/turn/observe
+} localizer_t;
+
+// --- Lifecycle ---
+bool localize_init(localizer_t* l, int w, int h, const uint8_t* field, int count);
+void localize_free(localizer_t* l);
+void localize_reset_at(localizer_t* l, int x, int y, int dir);   // known pose
+void localize_reset_uniform(localizer_t* l);                     // lost
+
+// --- Updates ---
+void localize_move(localizer_t* l, int tiles);
+void localize_turn(localizer_t* l, int quarters);   // +1 = right (CW), -1 = left
+void localize_observe(localizer_t* l, bool dark);
+
+// --- Estimate ---
+// Most likely pose and the share of weight on it.
+bool localize_estimate(localizer_t* l, int* x, int* y, int* dir, float* confidence);
+
+// --- Statistics ---
+void localize_print_stats(const localizer_t* l, FILE* out);
+
+#endif // LOCALIZE_H
@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "spsc_ring.h"
+#include "logger.h"
+
+#define LOG_PAYLOAD       160   // bytes of captured arguments per message
+#define LOG_RING_SLOTS    256   // power of two
+#define LOG_MAX_PRODUCERS 8     // threads that may log concurrently
+#define LOG_IDLE_US       2000  // writer back-off when every ring is empty
+#define LOG_LINE_MAX      512
+
+typedef struct {
+    const char* fmt;
+    uint8_t level;
+    uint8_t nargs;              // arguments that fit into the payload
+    uint8_t truncated;
+    unsigned char payload[LOG_PAYLOAD];
+} log_record_t;
+
+typedef struct {
+    spsc_ring_t ring;
+    log_record_t slots[LOG_RING_SLOTS];
+    _Atomic uint64_t dropped;
+    _Atomic bool ready;         // ring initialised; set once by its producer
+} log_channel_t;
+
+static log_channel_t channels[LOG_MAX_PRODUCERS];
+static _Atomic int channel_count = 0;
+static _Atomic uint64_t unclaimed_dropped = 0;
+static _Atomic uint64_t written_count = 0;
+static _Atomic int runtime_level = LOG_LEVEL_DEBUG;
+static _Atomic bool running = false;
+static _Atomic bool stopping = false;
+static pthread_t writer_thread;
+
+static _Thread_local log_channel_t* my_channel = NULL;
+static _Thread_local bool my_channel_claimed = false;
+
+// ---------- Format Spec Parsing ----------
+// Shared by the producer (to know which va_arg type to pull) and the writer
+// (to know how to hand the captured value back to snprintf).
+
+typedef enum { ARG_NONE, ARG_INT, ARG_UINT, ARG_DOUBLE, ARG_STR, ARG_PTR, ARG_BAD } arg_kind_t;
+typedef enum { LEN_DEFAULT, LEN_L, LEN_LL, LEN_Z, LEN_T, LEN_J, LEN_BIG_L } arg_len_t;
+
+typedef struct {
+    arg_kind_t kind;
+    arg_len_t len;
+    const char* start;          // points at '%'
+    const char* end;            // one past the conversion character
+} fmt_spec_t;
+
+static const char* parse_spec(const char* p, fmt_spec_t* spec) {
+    spec->start = p++;
+    spec->len = LEN_DEFAULT;
+    if (*p == '%') {
+        spec->kind = ARG_NONE;
+        spec->end = p + 1;
+        return spec->end;
+    }
+    while (*p && strchr("-+ #0'", *p)) p++;
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p == 'h') { p++; if (*p == 'h') p++; }
+    else if (*p == 'l') { p++; spec->len = LEN_L; if (*p == 'l') { p++; spec->len = LEN_LL; } }
+    else if (*p == 'z') { p++; spec->len = LEN_Z; }
+    else if (*p == 't') { p++; spec->len = LEN_T; }
+    else if (*p == 'j') { p++; spec->len = LEN_J; }
+    else if (*p == 'L') { p++; spec->len = LEN_BIG_L; }
+
+    switch (*p) {
+        case 'd': case 'i':                       spec->kind = ARG_INT;    break;
+        case 'u': case 'x': case 'X': case 'o':   spec->kind = ARG_UINT;   break;
+        case 'c':                                 spec->kind = ARG_INT;    break;
+        case 'f': case 'F': case 'e': case 'E':
+        case 'g': case 'G': case 'a': case 'A':   spec->kind = ARG_DOUBLE; break;
+        case 's':                                 spec->kind = ARG_STR;    break;
+        case 'p':                                 spec->kind = ARG_PTR;    break;
+        default:                                  spec->kind = ARG_BAD;    break;
+    }
+    spec->end = (*p) ? p + 1 : p;
+    return spec->end;
+}
+
+// ---------- Argument Capture ----------
+static bool capture_args(log_record_t* rec, const char* fmt, va_list ap) {
+    size_t used = 0;
+    fmt_spec_t spec;
+    rec->nargs = 0;
+    rec->truncated = 0;
+
+    for (const char* p = fmt; *p; ) {
+        if (*p != '%') { p++; continue; }
+        p = parse_spec(p, &spec);
+        if (spec.kind == ARG_NONE) continue;
+        if (spec.kind == ARG_BAD) break;
+
+        if (spec.kind == ARG_STR) {
+            const char* s = va_arg(ap, const char*);
+            if (!s) s = "(null)";
+            size_t room = LOG_PAYLOAD - used;
+            if (room < 1) { rec->truncated = 1; break; }
+            size_t n = strnlen(s, room - 1);
+            memcpy(rec->payload + used, s, n);
+            rec->payload[used + n] = '\0';
+            used += n + 1;
+            rec->nargs++;
+            continue;
+        }
+
+        union { int64_t i; uint64_t u; double d; } v;
+        switch (spec.kind) {
+            case ARG_INT:
+                if (spec.len == LEN_LL || spec.len == LEN_J) v.i = va_arg(ap, long long);
+                else if (spec.len == LEN_L)                  v.i = va_arg(ap, long);
+                else if (spec.len == LEN_Z)                  v.i = (int64_t)va_arg(ap, size_t);
+                else if (spec.len == LEN_T)                  v.i = va_arg(ap, ptrdiff_t);
+                else                                         v.i = va_arg(ap, int);
+                break;
+            case ARG_UINT:
+                if (spec.len == LEN_LL || spec.len == LEN_J) v.u = va_arg(ap, unsigned long long);
+                else if (spec.len == LEN_L)                  v.u = va_arg(ap, unsigned long);
+                else if (spec.len == LEN_Z)                  v.u = va_arg(ap, size_t);
+                else if (spec.len == LEN_T)                  v.u = (uint64_t)va_arg(ap, ptrdiff_t);
+                else                                         v.u = va_arg(ap, unsigned int);
+                break;
+            case ARG_DOUBLE:
+                if (spec.len == LEN_BIG_L) v.d = (double)va_arg(ap, long double);
+                else                       v.d = va_arg(ap, double);
+                break;
+            default: // ARG_PTR
+                v.u = (uint64_t)(uintptr_t)va_arg(ap, void*);
+                break;
+        }
+        if (LOG_PAYLOAD - used < sizeof(v)) { rec->truncated = 1; break; }
+        memcpy(rec->payload + used, &v, sizeof(v));
+        used += sizeof(v);
+        rec->nargs++;
+    }
+    return rec->truncated == 0;
+}
+
+// ---------- Deferred Formatting (writer thread) ----------
+static size_t format_record(const log_record_t* rec, char* out, size_t cap) {
+    size_t pos = 0, used = 0;
+    int arg = 0;
+    char spec_buf[32];
+    fmt_spec_t spec;
+
+#define LOG_APPEND(...) do { \
+        if (pos < cap) { int n_ = snprintf(out + pos, cap - pos, __VA_ARGS__); \
+                         if (n_ > 0) pos += (size_t)n_; } \
+    } while (0)
+
+    for (const char* p = rec->fmt; *p; ) {
+        if (*p != '%') {
+            if (pos + 1 < cap) out[pos++] = *p;
+            p++;
+            continue;
+        }
+        p = parse_spec(p, &spec);
+        if (spec.kind == ARG_NONE) { if (pos + 1 < cap) out[pos++] = '%'; continue; }
+        if (spec.kind == ARG_BAD || arg >= rec->nargs) break;
+
+        size_t spec_len = (size_t)(spec.end - spec.start);
+        if (spec_len >= sizeof(spec_buf)) break;
+        memcpy(spec_buf, spec.start, spec_len);
+        spec_buf[spec_len] = '\0';
+
+        if (spec.kind == ARG_STR) {
+            const char* s = (const char*)rec->payload + used;
+            LOG_APPEND(spec_buf, s);
+            used += strlen(s) + 1;
+            arg++;
+            continue;
+        }
+
+        union { int64_t i; uint64_t u; double d; } v;
+        memcpy(&v, rec->payload + used, sizeof(v));
+        used += sizeof(v);
+        arg++;
+
+        switch (spec.kind) {
+            case ARG_INT:
+                if (spec.len == LEN_LL || spec.len == LEN_J) LOG_APPEND(spec_buf, (long long)v.i);
+                else if (spec.len == LEN_L)                  LOG_APPEND(spec_buf, (long)v.i);
+                else if (spec.len == LEN_Z)                  LOG_APPEND(spec_buf, (size_t)v.i);
+                else if (spec.len == LEN_T)                  LOG_APPEND(spec_buf, (ptrdiff_t)v.i);
+                else                                         LOG_APPEND(spec_buf, (int)v.i);
+                break;
+            case ARG_UINT:
+                if (spec.len == LEN_LL || spec.len == LEN_J) LOG_APPEND(spec_buf, (unsigned long long)v.u);
+                else if (spec.len == LEN_L)                  LOG_APPEND(spec_buf, (unsigned long)v.u);
+                else if (spec.len == LEN_Z)                  LOG_APPEND(spec_buf, (size_t)v.u);
+                else if (spec.len == LEN_T)                  LOG_APPEND(spec_buf, (ptrdiff_t)v.u);
+                else                                         LOG_APPEND(spec_buf, (unsigned int)v.u);
+                break;
+            case ARG_DOUBLE:
+                if (spec.len == LEN_BIG_L) LOG_APPEND(spec_buf, (long double)v.d);
+                else                       LOG_APPEND(spec_buf, v.d);
+                break;
+            default:
+                LOG_APPEND(spec_buf, (void*)(uintptr_t)v.u);
+                break;
+        }
+    }
+    if (rec->truncated) LOG_APPEND("...<truncated>\n");
+#undef LOG_APPEND
+
+    if (pos >= cap) pos = cap - 1;
+    out[pos] = '\0';
+    return pos;
+}
+
+static int drain_all(void) {
+    char line[LOG_LINE_MAX];
+    int drained = 0;
+    int count = atomic_load(&channel_count);
+    if (count > LOG_MAX_PRODUCERS) count = LOG_MAX_PRODUCERS;
+
+    for (int c = 0; c < count; c++) {
+        // A slot is counted when claimed but only usable once published.
+        if (!atomic_load_explicit(&channels[c].ready, memory_order_acquire)) continue;
+        log_record_t* rec;
+        while ((rec = spsc_peek(&channels[c].ring)) != NULL) {
+            size_t n = format_record(rec, line, sizeof(line));
+            spsc_release(&channels[c].ring);
+            fwrite(line, 1, n, stdout);
+            drained++;
+        }
+    }
+    if (drained > 0) {
+        fflush(stdout);
+        atomic_fetch_add(&written_count, (uint64_t)drained);
+    }
+    return drained;
+}
+
+static void* writer_main(void* arg) {
+    (void)arg;
+    while (true) {
+        int drained = drain_all();
+        if (drained == 0) {
+            if (atomic_load(&stopping)) break;
+            usleep(LOG_IDLE_US);
+        }
+    }
+    drain_all();
+    return NULL;
+}
+
+// ---------- Producer Side ----------
+static log_channel_t* claim_channel(void) {
+    if (my_channel_claimed) return my_channel;
+    my_channel_claimed = true;
+    int idx = atomic_fetch_add(&channel_count, 1);
+    if (idx >= LOG_MAX_PRODUCERS) return NULL;
+    spsc_init(&channels[idx].ring, channels[idx].slots, sizeof(log_record_t), LOG_RING_SLOTS);
+    // The count already includes this slot; the writer skips it until the
+    // initialised ring is published here.
+    atomic_store_explicit(&channels[idx].ready, true, memory_order_release);
+    my_channel = &channels[idx];
+    return my_channel;
+}
+
+void log_write(int level, const char* fmt, ...) {
+    if (level < atomic_load_explicit(&runtime_level, memory_order_relaxed)) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    if (!atomic_load_explicit(&running, memory_order_acquire)) {
+        vprintf(fmt, ap);
+        fflush(stdout);
+        va_end(ap);
+        return;
+    }
+
+    log_channel_t* ch = claim_channel();
+    if (!ch) {
+        atomic_fetch_add_explicit(&unclaimed_dropped, 1, memory_order_relaxed);
+        va_end(ap);
+        return;
+    }
+    log_record_t* rec = spsc_reserve(&ch->ring);
+    if (!rec) {
+        atomic_fetch_add_explicit(&ch->dropped, 1, memory_order_relaxed);
+        va_end(ap);
+        return;
+    }
+    rec->fmt = fmt;
+    rec->level = (uint8_t)level;
+    capture_args(rec, fmt, ap);
+    va_end(ap);
+    spsc_commit(&ch->ring);
+}
+
+// ---------- Lifecycle & Statistics ----------
+bool log_start(void) {
+    if (atomic_load(&running)) return true;
+    atomic_store(&stopping, false);
+    if (pthread_create(&writer_thread, NULL, writer_main, NULL) != 0) {
+        return false;
+    }
+    atomic_store_explicit(&running, true, memory_order_release);
+    return true;
+}
+
+void log_stop(void) {
+    if (!atomic_load(&running)) return;
+    atomic_store(&stopping, true);
+    pthread_join(writer_thread, NULL);
+    atomic_store(&running, false);
+    fflush(stdout);
+}
+
+void log_set_level(int level) {
+    atomic_store(&runtime_level, level);
+}
+
+uint64_t log_dropped(void) {
+    uint64_t total = atomic_load(&unclaimed_dropped);
+    int count = atomic_load(&channel_count);
+    if (count > LOG_MAX_PRODUCERS) count = LOG_MAX_PRODUCERS;
+    for (int c = 0; c < count; c++) {
+        total += atomic_load(&channels[c].dropped);
+    }
+    return total;
+}
+
+uint64_t log_written(void) {
+    return atomic_load(&written_count);
+}
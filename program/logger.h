@@ -0,0 +1,48 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Asynchronous logger for control loops. log_*() only captures the format
+// pointer and the raw arguments into a per-thread lock-free SPSC ring; a
+// background thread does the printf formatting and the console write.
+// If the ring is full the message is dropped and counted, never waited on.
+//
+// The format string must outlive the program (use string literals).
+// %s arguments are copied at call time, so temporary buffers are fine.
+// '*' width/precision is not supported.
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF   4
+
+// Compile-time filter: calls below this level compile to nothing.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_AT(level, ...) \
+    do { if ((level) >= LOG_COMPILE_LEVEL) log_write((level), __VA_ARGS__); } while (0)
+
+#define log_debug(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define log_info(...)  LOG_AT(LOG_LEVEL_INFO,  __VA_ARGS__)
+#define log_warn(...)  LOG_AT(LOG_LEVEL_WARN,  __VA_ARGS__)
+#define log_error(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+// --- Logger Lifecycle ---
+// Before log_start() (or after log_stop()) messages are written synchronously.
+bool log_start(void);
+void log_stop(void);          // drains all rings, then joins the writer thread
+void log_set_level(int level); // runtime filter on top of LOG_COMPILE_LEVEL
+
+// --- Producer Side ---
+void log_write(int level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// --- Statistics ---
+uint64_t log_dropped(void);   // messages lost because a ring was full
+uint64_t log_written(void);   // messages formatted by the writer thread
+
+#endif // LOGGER_H
@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/fb.h>
+#include "map_render.h"
+
+#define CONSOLE_BUF 4096
+
+// ---------- Lifecycle ----------
+bool map_render_init(map_renderer_t* r, int width, int height, int view_w, int view_h) {
+    memset(r, 0, sizeof(*r));
+    if (width <= 0 || height <= 0) return false;
+    size_t n = (size_t)width * (size_t)height;
+    r->width  = width;
+    r->height = height;
+    r->cells      = malloc(n);
+    r->drawn      = calloc(n, 1);
+    r->dirty_flag = calloc(n, 1);
+    r->dirty      = malloc(n * sizeof(uint32_t));
+    if (!r->cells || !r->drawn || !r->dirty_flag || !r->dirty) {
+        map_render_free(r);
+        return false;
+    }
+    memset(r->cells, GLYPH_UNKNOWN, n);
+    r->view_w = (view_w > 0 && view_w < width)  ? view_w : width;
+    r->view_h = (view_h > 0 && view_h < height) ? view_h : height;
+    r->view_changed = true;
+    r->fb_fd = -1;
+    return true;
+}
+
+void map_render_free(map_renderer_t* r) {
+    if (r->console) {
+        printf("\033[r\033[999;1H\n");  // restore full-screen scrolling
+        fflush(stdout);
+    }
+    if (r->fb_mem) munmap(r->fb_mem, r->fb_size);
+    if (r->fb_fd >= 0) close(r->fb_fd);
+    free(r->cells);
+    free(r->drawn);
+    free(r->dirty_flag);
+    free(r->dirty);
+    memset(r, 0, sizeof(*r));
+    r->fb_fd = -1;
+}
+
+// ---------- Outputs ----------
+bool map_render_open_console(map_renderer_t* r) {
+    if (!isatty(STDOUT_FILENO)) return false;
+    int rows = 24;
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0) rows = ws.ws_row;
+
+    r->console = true;
+    r->console_row = 1;
+    int log_top = r->console_row + r->view_h + 2;
+    if (log_top < rows) {
+        // Clear, pin the map to the top and let log lines scroll underneath.
+        printf("\033[2J\033[%d;%dr\033[%d;1H", log_top, rows, log_top);
+    } else {
+        printf("\033[2J");
+    }
+    fflush(stdout);
+    r->view_changed = true;
+    return true;
+}
+
+bool map_render_open_fb(map_renderer_t* r, const char* path, int width, int height, int bpp) {
+    // Only a stand-in (geometry given) may be created; a missing /dev/fb0
+    // must not turn into a regular file.
+    bool stand_in = width > 0 && height > 0 && bpp > 0;
+    int fd = open(path, stand_in ? O_RDWR | O_CREAT : O_RDWR, 0644);
+    if (fd < 0) return false;
+
+    struct fb_var_screeninfo vinfo;
+    struct fb_fix_screeninfo finfo;
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &vinfo) == 0 && ioctl(fd, FBIOGET_FSCREENINFO, &finfo) == 0) {
+        r->fb_width  = (int)vinfo.xres;
+        r->fb_height = (int)vinfo.yres;
+        r->fb_bpp    = (int)vinfo.bits_per_pixel;
+        r->fb_stride = (int)finfo.line_length;
+        r->fb_ink    = (finfo.visual == FB_VISUAL_MONO10) ? 0 : 1;
+    } else {
+        // Plain file standing in for the panel.
+        if (!stand_in) { close(fd); return false; }
+        r->fb_width  = width;
+        r->fb_height = height;
+        r->fb_bpp    = bpp;
+        r->fb_stride = (width * bpp + 7) / 8;
+        r->fb_ink    = 1;
+        struct stat st;
+        off_t need = (off_t)r->fb_stride * height;
+        if (fstat(fd, &st) != 0 || (st.st_size < need && ftruncate(fd, need) != 0)) {
+            close(fd);
+            return false;
+        }
+    }
+
+    r->fb_size = (size_t)r->fb_stride * (size_t)r->fb_height;
+    r->fb_mem = mmap(NULL, r->fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (r->fb_mem == MAP_FAILED) {
+        r->fb_mem = NULL;
+        close(fd);
+        return false;
+    }
+    r->fb_fd = fd;
+
+    int px_w = r->fb_width / r->view_w;
+    int px_h = r->fb_height / r->view_h;
+    r->cell_px = (px_w < px_h) ? px_w : px_h;
+    if (r->cell_px < 2) r->cell_px = 2;
+    r->view_changed = true;
+    return true;
+}
+
+// ---------- Updates ----------
+void map_render_set_cell(map_renderer_t* r, int x, int y, char glyph) {
+    if (x < 0 || x >= r->width || y < 0 || y >= r->height) return;
+    uint32_t i = (uint32_t)y * (uint32_t)r->width + (uint32_t)x;
+    if (r->cells[i] == glyph) return;
+    r->cells[i] = glyph;
+    if (!r->dirty_flag[i]) {
+        r->dirty_flag[i] = 1;
+        r->dirty[r->dirty_count++] = i;
+    }
+}
+
+static int scroll_axis(int pos, int start, int view, int size) {
+    int margin = view / 4;
+    if (margin > 2) margin = 2;
+    if (pos < start + margin)            start = pos - margin;
+    if (pos > start + view - 1 - margin) start = pos - view + 1 + margin;
+    if (start > size - view) start = size - view;
+    if (start < 0) start = 0;
+    return start;
+}
+
+void map_render_follow(map_renderer_t* r, int x, int y) {
+    int vx = scroll_axis(x, r->view_x, r->view_w, r->width);
+    int vy = scroll_axis(y, r->view_y, r->view_h, r->height);
+    if (vx != r->view_x || vy != r->view_y) {
+        r->view_x = vx;
+        r->view_y = vy;
+        r->view_changed = true;
+    }
+}
+
+static bool in_view(const map_renderer_t* r, int x, int y) {
+    return x >= r->view_x && x < r->view_x + r->view_w &&
+           y >= r->view_y && y < r->view_y + r->view_h;
+}
+
+// ---------- Console Drawing ----------
+typedef struct {
+    char buf[CONSOLE_BUF];
+    int len;
+} out_buf_t;
+
+static void out_flush(out_buf_t* o) {
+    if (o->len > 0) fwrite(o->buf, 1, (size_t)o->len, stdout);
+    o->len = 0;
+}
+
+static void out_cell(out_buf_t* o, const map_renderer_t* r, int x, int y, char glyph) {
+    if (o->len > CONSOLE_BUF - 32) out_flush(o);
+    int row = r->console_row + 1 + (r->view_y + r->view_h - 1 - y);
+    int col = 1 + 2 * (x - r->view_x);
+    const char* s = (glyph == GLYPH_UNKNOWN) ? "⋅" : (char[]){ glyph, '\0' };
+    o->len += snprintf(o->buf + o->len, CONSOLE_BUF - o->len, "\033[%d;%dH%s", row, col, s);
+}
+
+// ---------- Framebuffer Drawing ----------
+static void fb_pixel(map_renderer_t* r, int px, int py, bool ink) {
+    if (px < 0 || py < 0 || px >= r->fb_width || py >= r->fb_height) return;
+    uint8_t* row = r->fb_mem + (size_t)py * r->fb_stride;
+    switch (r->fb_bpp) {
+        case 1: {
+            uint8_t bit = (uint8_t)(0x80 >> (px & 7));
+            bool set = ink ? (r->fb_ink == 1) : (r->fb_ink == 0);
+            if (set) row[px >> 3] |= bit;
+            else     row[px >> 3] &= (uint8_t)~bit;
+            break;
+        }
+        case 8:  row[px] = ink ? 0x00 : 0xFF; break;
+        case 16: ((uint16_t*)row)[px] = ink ? 0x0000 : 0xFFFF; break;
+        case 24: memset(row + px * 3, ink ? 0x00 : 0xFF, 3); break;
+        default: ((uint32_t*)row)[px] = ink ? 0x00000000 : 0x00FFFFFF; break;
+    }
+}
+
+// Blits one cell rectangle; only the pixels of that cell are touched.
+static void fb_cell(map_renderer_t* r, int x, int y, char glyph) {
+    int s = r->cell_px;
+    int x0 = (x - r->view_x) * s;
+    int y0 = (r->view_y + r->view_h - 1 - y) * s;
+    int mid = s / 2;
+    for (int py = 0; py < s; py++) {
+        for (int px = 0; px < s; px++) {
+            bool edge = (px == 0 || py == 0 || px == s - 1 || py == s - 1);
+            bool ink;
+            switch (glyph) {
+                case GLYPH_BLOCKED: ink = true; break;
+                case GLYPH_ROBOT:   ink = edge || (px == mid && py == mid); break;
+                case GLYPH_FREE:    ink = false; break;
+                default:            ink = (px == mid && py == mid); break;   // unknown
+            }
+            fb_pixel(r, x0 + px, y0 + py, ink);
+        }
+    }
+}
+
+// ---------- Flush ----------
+static void draw_cell(map_renderer_t* r, out_buf_t* o, int x, int y) {
+    uint32_t i = (uint32_t)y * (uint32_t)r->width + (uint32_t)x;
+    char glyph = r->cells[i];
+    if (r->console) out_cell(o, r, x, y, glyph);
+    if (r->fb_mem)  fb_cell(r, x, y, glyph);
+    r->drawn[i] = glyph;
+}
+
+int map_render_flush(map_renderer_t* r) {
+    static out_buf_t out;
+    int drawn = 0;
+    out.len = 0;
+    if (r->console) out.len = snprintf(out.buf, CONSOLE_BUF, "\0337");  // save cursor
+
+    if (r->view_changed) {
+        // Viewport moved: redraw the visible window, never the whole grid.
+        if (r->console) {
+            out.len += snprintf(out.buf + out.len, CONSOLE_BUF - out.len,
+                                "\033[%d;1H\033[2KMap %dx%d, view (%d,%d) %dx%d",
+                                r->console_row, r->width, r->height,
+                                r->view_x, r->view_y, r->view_w, r->view_h);
+        }
+        for (int y = r->view_y; y < r->view_y + r->view_h; y++) {
+            for (int x = r->view_x; x < r->view_x + r->view_w; x++) {
+                draw_cell(r, &out, x, y);
+                drawn++;
+            }
+        }
+        r->view_changed = false;
+    } else {
+        for (int k = 0; k < r->dirty_count; k++) {
+            uint32_t i = r->dirty[k];
+            int x = (int)(i % (uint32_t)r->width);
+            int y = (int)(i / (uint32_t)r->width);
+            if (r->cells[i] != r->drawn[i] && in_view(r, x, y)) {
+                draw_cell(r, &out, x, y);
+                drawn++;
+            }
+        }
+    }
+
+    for (int k = 0; k < r->dirty_count; k++) r->dirty_flag[r->dirty[k]] = 0;
+    r->dirty_count = 0;
+
+    if (r->console) {
+        out.len += snprintf(out.buf + out.len, CONSOLE_BUF - out.len, "\0338");  // restore cursor
+        out_flush(&out);
+        fflush(stdout);
+    }
+    return drawn;
+}
+
+void map_render_print(const map_renderer_t* r, FILE* out) {
+    char* row = malloc((size_t)r->width * 4 + 2);
+    if (!row) return;
+    for (int y = r->height - 1; y >= 0; y--) {
+        size_t len = 0;
+        for (int x = 0; x < r->width; x++) {
+            char glyph = r->cells[(size_t)y * r->width + x];
+            if (glyph == GLYPH_UNKNOWN) {
+                memcpy(row + len, "⋅ ", 4);
+                len += 4;
+            } else {
+                row[len++] = glyph;
+                row[len++] = ' ';
+            }
+        }
+        row[len++] = '\n';
+        fwrite(row, 1, len, out);
+    }
+    free(row);
+}
@@ -0,0 +1,67 @@
+#ifndef MAP_RENDER_H
+#define MAP_RENDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Incremental map renderer for the console and the EV3 LCD framebuffer.
+// The caller updates single cells with map_render_set_cell(); flush only
+// emits the cells that differ from the last drawn frame, so its cost is
+// proportional to the number of changes, not to the grid size.
+//
+// Grid coordinates follow grid_navigation.c: x grows east, y grows north,
+// the top screen row shows the highest y inside the viewport.
+
+// Cell glyphs
+#define GLYPH_UNKNOWN  '.'
+#define GLYPH_FREE     'T'
+#define GLYPH_BLOCKED  'N'
+#define GLYPH_ROBOT    'R'
+
+typedef struct {
+    int width, height;              // grid size in cells
+    char* cells;                    // desired frame
+    char* drawn;                    // last frame actually drawn (0 = never)
+    uint8_t* dirty_flag;
+    uint32_t* dirty;                // indices of cells changed since last flush
+    int dirty_count;
+
+    // Scrolling viewport (cells)
+    int view_x, view_y, view_w, view_h;
+    bool view_changed;
+
+    // Console (ANSI) output
+    bool console;
+    int console_row;                // 1-based terminal row of the map header
+
+    // Framebuffer output
+    int fb_fd;
+    uint8_t* fb_mem;
+    size_t fb_size;
+    int fb_width, fb_height, fb_bpp, fb_stride;
+    int fb_ink;                     // bit value that draws black on 1bpp panels
+    int cell_px;
+} map_renderer_t;
+
+// --- Lifecycle ---
+bool map_render_init(map_renderer_t* r, int width, int height, int view_w, int view_h);
+void map_render_free(map_renderer_t* r);
+
+// --- Outputs ---
+// Reserves the top of the terminal for the map and scrolls log output below it.
+bool map_render_open_console(map_renderer_t* r);
+// Opens /dev/fb0 (geometry from the driver) or a plain file used as a stand-in,
+// in which case width/height/bpp describe the emulated panel. The file is
+// only created when they are given.
+bool map_render_open_fb(map_renderer_t* r, const char* path, int width, int height, int bpp);
+
+// --- Updates ---
+void map_render_set_cell(map_renderer_t* r, int x, int y, char glyph);
+void map_render_follow(map_renderer_t* r, int x, int y);   // scroll to keep (x,y) visible
+int  map_render_flush(map_renderer_t* r);                   // returns cells drawn
+
+// Plain full-grid dump (final report, non-terminal output).
+void map_render_print(const map_renderer_t* r, FILE* out);
+
+#endif // MAP_RENDER_H
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "ev3.h"
+#include "ev3_tacho.h"
+#include "stall_watch.h"
+#include "timing.h"
+#include "logger.h"
+#include "motion_profile.h"
+
+#define MOTION_FINISH_MS    60      // hand over to run-to-abs-pos this long before the end
+#define MOTION_LAND_SPEED   60      // deg/s floor for the final approach
+#define MOTION_TIMEOUT_MS   500     // past the planned end before giving up
+#define MOTION_DEFAULT_MAX  1050    // EV3 large motor max_speed, if it cannot be read
+
+// ---------- Planning ----------
+// Speed-up phase of an S-curve to velocity v: jerk segment, optional
+// constant-acceleration segment, jerk segment. Returns its distance.
+static double scurve_accel(double v, double a, double j, double* t_j, double* t_ca, double* a_p) {
+    if (v * j < a * a) {        // a_max is never reached
+        *t_j = sqrt(v / j);
+        *a_p = j * *t_j;
+        *t_ca = 0;
+    } else {
+        *t_j = a / j;
+        *a_p = a;
+        *t_ca = v / a - *t_j;
+    }
+    return v * (2 * *t_j + *t_ca) / 2;
+}
+
+void motion_plan_type(motion_profile_t* p, int distance_deg, const motion_limits_t* lim, profile_type_t type) {
+    double d = abs(distance_deg);
+    double v = lim->v_max > 0 ? lim->v_max : 1;
+    double a = lim->a_max;
+    double j = lim->j_max;
+    *p = (motion_profile_t){ .type = (uint8_t)type, .distance = (int)d };
+    if (type != PROFILE_STEP && a <= 0) type = p->type = PROFILE_STEP;
+    if (type == PROFILE_SCURVE && j <= 0) type = p->type = PROFILE_TRAPEZOID;
+
+    if (type == PROFILE_STEP) {
+        p->v_peak = (int)v;
+        p->total = d / v;
+        p->t_cruise = p->total;
+        return;
+    }
+
+    if (type == PROFILE_TRAPEZOID) {
+        if (v * v / a > d) v = sqrt(d * a);     // triangle: never reaches v_max
+        p->t_accel = v / a;
+        p->t_cruise = (d - v * v / a) / v;
+        p->a_peak = (int)a;
+    } else {
+        double t_j, t_ca, a_p;
+        if (2 * scurve_accel(v, a, j, &t_j, &t_ca, &a_p) > d) {
+            // Too short for v_max: find the peak that just fits.
+            double lo = 0, hi = v;
+            for (int i = 0; i < 40; i++) {
+                double mid = (lo + hi) / 2;
+                if (2 * scurve_accel(mid, a, j, &t_j, &t_ca, &a_p) > d) hi = mid;
+                else lo = mid;
+            }
+            v = lo;
+        }
+        double d_a = scurve_accel(v, a, j, &t_j, &t_ca, &a_p);
+        p->t_jerk = t_j;
+        p->t_accel = 2 * t_j + t_ca;
+        p->t_cruise = v > 0 ? (d - 2 * d_a) / v : 0;
+        p->a_peak = (int)a_p;
+        p->j_max = (int)j;
+    }
+    if (p->t_cruise < 0) p->t_cruise = 0;
+    p->v_peak = (int)v;
+    p->total = 2 * p->t_accel + p->t_cruise;
+}
+
+void motion_plan(motion_profile_t* p, int distance_deg, const motion_limits_t* lim) {
+    if (lim->a_max <= 0) {
+        motion_plan_type(p, distance_deg, lim, PROFILE_STEP);
+        return;
+    }
+    if (lim->j_max > 0) {
+        motion_plan_type(p, distance_deg, lim, PROFILE_SCURVE);
+        if (p->a_peak >= lim->a_max) return;
+    }
+    motion_plan_type(p, distance_deg, lim, PROFILE_TRAPEZOID);
+}
+
+// Speed-up phase velocity at tau seconds into it.
+static double accel_velocity(const motion_profile_t* p, double tau) {
+    if (p->type == PROFILE_TRAPEZOID) return p->a_peak * tau;
+    double t_j = p->t_jerk;
+    double j = t_j > 0 ? p->a_peak / t_j : 0;
+    if (tau < t_j) return j * tau * tau / 2;
+    if (tau < p->t_accel - t_j) return j * t_j * t_j / 2 + p->a_peak * (tau - t_j);
+    double rest = p->t_accel - tau;
+    return p->v_peak - j * rest * rest / 2;
+}
+
+double motion_velocity_at(const motion_profile_t* p, double t) {
+    if (t < 0 || t >= p->total) return 0;
+    if (p->type == PROFILE_STEP) return p->v_peak;
+    if (t < p->t_accel) return accel_velocity(p, t);
+    if (t < p->t_accel + p->t_cruise) return p->v_peak;
+    return accel_velocity(p, p->total - t);
+}
+
+const char* motion_profile_name(uint8_t type) {
+    switch (type) {
+        case PROFILE_STEP:      return "step";
+        case PROFILE_TRAPEZOID: return "trapezoid";
+        case PROFILE_SCURVE:    return "s-curve";
+    }
+    return "?";
+}
+
+// ---------- Execution ----------
+static void set_ramps(uint8_t sn, int ramp_ms) {
+    set_tacho_ramp_up_sp(sn, ramp_ms);
+    set_tacho_ramp_down_sp(sn, ramp_ms);
+}
+
+static bool motor_running(uint8_t sn) {
+    FLAGS_T flags = TACHO_STATE__NONE_;
+    get_tacho_state_flags(sn, &flags);
+    return (flags & TACHO_RUNNING) != 0;
+}
+
+static void stop_both(uint8_t l, uint8_t r) {
+    set_tacho_command_inx(l, TACHO_STOP);
+    set_tacho_command_inx(r, TACHO_STOP);
+}
+
+bool motion_run(const motion_profile_t* p, uint8_t sn_left, uint8_t sn_right,
+                int left_sign, int right_sign, motion_progress_fn progress, void* ctx) {
+    uint8_t sn[2] = { sn_left, sn_right };
+    int sign[2] = { left_sign < 0 ? -1 : 1, right_sign < 0 ? -1 : 1 };
+    int start[2] = { 0, 0 };
+    for (int m = 0; m < 2; m++) get_tacho_position(sn[m], &start[m]);
+    if (p->distance == 0) return true;
+
+    bool streaming = (p->type == PROFILE_SCURVE);
+    int ramp_ms = 0;
+    if (p->type == PROFILE_TRAPEZOID) {
+        // The driver's ramp time is for 0 -> max_speed.
+        int max_speed = 0;
+        if (!get_tacho_max_speed(sn_left, &max_speed) || max_speed <= 0) max_speed = MOTION_DEFAULT_MAX;
+        ramp_ms = (int)(1000.0 * max_speed / p->a_peak);
+    }
+    for (int m = 0; m < 2; m++) set_ramps(sn[m], ramp_ms);
+
+    stall_watch_arm(p->v_peak, p->v_peak);
+    if (streaming) {
+        for (int m = 0; m < 2; m++) set_tacho_speed_sp(sn[m], 0);
+        for (int m = 0; m < 2; m++) set_tacho_command_inx(sn[m], TACHO_RUN_FOREVER);
+    } else {
+        for (int m = 0; m < 2; m++) {
+            set_tacho_speed_sp(sn[m], p->v_peak);
+            set_tacho_position_sp(sn[m], sign[m] * p->distance);
+        }
+        for (int m = 0; m < 2; m++) set_tacho_command_inx(sn[m], TACHO_RUN_TO_REL_POS);
+    }
+
+    uint64_t t0 = now_ns();
+    uint64_t next = t0;
+    uint64_t end_ns = t0 + (uint64_t)(p->total * 1e9);
+    uint64_t finish_ns = end_ns - (uint64_t)MOTION_FINISH_MS * 1000000ull;
+    uint64_t timeout_ns = end_ns + (uint64_t)MOTION_TIMEOUT_MS * 1000000ull;
+    bool landing = !streaming;
+    bool ok = true;
+
+    while (true) {
+        next += (uint64_t)MOTION_STREAM_PERIOD_MS * 1000000ull;
+        struct timespec ts = ns_to_timespec(next);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        uint64_t t = now_ns();
+
+        if (stall_watch_tripped()) {
+            ok = false;
+            break;
+        }
+        int pos = 0;
+        get_tacho_position(sn_left, &pos);
+        int traveled = (pos - start[0]) * sign[0];
+
+        // Aim half a period ahead: the setpoint holds until the next update.
+        double v = motion_velocity_at(p, (t - t0) / 1e9 + MOTION_STREAM_PERIOD_MS / 2000.0);
+        if (progress && !progress(ctx, traveled, (int)v)) {
+            stop_both(sn_left, sn_right);
+            ok = false;
+            break;
+        }
+
+        if (!landing) {
+            if (t >= finish_ns || traveled >= p->distance) {
+                // Let the driver land on the exact target.
+                int land = v > MOTION_LAND_SPEED ? (int)v : MOTION_LAND_SPEED;
+                for (int m = 0; m < 2; m++) {
+                    set_tacho_speed_sp(sn[m], land);
+                    set_tacho_position_sp(sn[m], start[m] + sign[m] * p->distance);
+                }
+                for (int m = 0; m < 2; m++) set_tacho_command_inx(sn[m], TACHO_RUN_TO_ABS_POS);
+                landing = true;
+            } else {
+                // Already in run-forever: a new speed_sp takes effect at once.
+                stall_watch_update((int)v, (int)v);
+                for (int m = 0; m < 2; m++) set_tacho_speed_sp(sn[m], sign[m] * (int)v);
+            }
+            continue;
+        }
+
+        if (t - t0 >= 3 * MOTION_STREAM_PERIOD_MS * 1000000ull &&
+            !motor_running(sn_left) && !motor_running(sn_right)) break;
+        if (t >= timeout_ns) {
+            log_warn("motion: %s move did not finish in time\n", motion_profile_name(p->type));
+            stop_both(sn_left, sn_right);
+            break;
+        }
+    }
+    stall_watch_disarm();
+    if (ramp_ms) for (int m = 0; m < 2; m++) set_ramps(sn[m], 0);
+    return ok;
+}
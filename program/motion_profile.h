@@ -0,0 +1,59 @@
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Velocity profiles for straight moves and turns, in wheel degrees.
+// A trapezoid is executed by the tacho driver itself (ramp_up_sp /
+// ramp_down_sp with run-to-rel-pos); a jerk-limited S-curve is streamed as
+// speed setpoints from a 10 ms loop and finished with a short run-to-abs-pos
+// so the landing position is the driver's, not the stream's.
+//
+// motion_plan() picks the shape per move: an S-curve only when a jerk limit
+// is given and the move is long enough to reach full acceleration, since
+// shorter moves gain nothing over the driver's own ramps.
+
+#define MOTION_STREAM_PERIOD_MS 10
+
+typedef enum {
+    PROFILE_STEP,               // constant speed, instant start (the old behaviour)
+    PROFILE_TRAPEZOID,          // acceleration-limited
+    PROFILE_SCURVE,             // acceleration- and jerk-limited
+} profile_type_t;
+
+typedef struct {
+    int v_max;                  // deg/s
+    int a_max;                  // deg/s^2, 0 = PROFILE_STEP
+    int j_max;                  // deg/s^3, 0 = never PROFILE_SCURVE
+} motion_limits_t;
+
+typedef struct {
+    uint8_t type;               // profile_type_t
+    int distance;               // deg, always >= 0
+    int v_peak;                 // deg/s actually reached
+    int a_peak;                 // deg/s^2 actually reached
+    int j_max;
+    double t_jerk;              // s, each jerk segment (S-curve)
+    double t_accel;             // s, whole speed-up phase
+    double t_cruise;            // s
+    double total;               // s
+} motion_profile_t;
+
+// Called every stream period with the distance covered so far; return false
+// to stop the motors and abort.
+typedef bool (*motion_progress_fn)(void* ctx, int traveled_deg, int speed_sp);
+
+// --- Planning ---
+void motion_plan(motion_profile_t* p, int distance_deg, const motion_limits_t* lim);
+void motion_plan_type(motion_profile_t* p, int distance_deg, const motion_limits_t* lim, profile_type_t type);
+double motion_velocity_at(const motion_profile_t* p, double t);    // deg/s at t seconds
+const char* motion_profile_name(uint8_t type);
+
+// --- Execution ---
+// Drives both motors through the profile; signs (+1/-1) give the direction
+// of each wheel. Returns false if aborted or the stall watch tripped.
+bool motion_run(const motion_profile_t* p, uint8_t sn_left, uint8_t sn_right,
+                int left_sign, int right_sign, motion_progress_fn progress, void* ctx);
+
+#endif // MOTION_PROFILE_H
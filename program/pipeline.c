@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+#include "logger.h"
+#include "trace.h"
+#include "pipeline.h"
+
+typedef struct {
+    uint64_t t_ns;                  // when it was queued
+} pipe_hdr_t;
+
+// Message buffers, aligned for any message struct
+typedef union {
+    unsigned char bytes[PIPE_MAX_MSG];
+    uint64_t align;
+} pipe_buf_t;
+
+// ---------- Queues ----------
+static size_t msg_size(const pipeline_t* p, int q) {
+    return p->stages[(q + PIPE_STAGES - 1) % PIPE_STAGES].out_size;
+}
+
+// Non-blocking; the caller has made sure there is a free slot.
+static bool queue_put(pipeline_t* p, int q, const void* msg) {
+    pipe_queue_t* pq = &p->queues[q];
+    hist_record(&pq->depth, spsc_size(&pq->ring));
+    unsigned char* slot = spsc_reserve(&pq->ring);
+    if (!slot) return false;
+    pipe_hdr_t hdr = { now_ns() };
+    memcpy(slot, &hdr, sizeof(hdr));
+    memcpy(slot + sizeof(hdr), msg, msg_size(p, q));
+    spsc_commit(&pq->ring);
+    pq->pushes++;
+    return true;
+}
+
+static bool queue_take(pipeline_t* p, int q, void* msg, uint64_t* t_ns) {
+    pipe_queue_t* pq = &p->queues[q];
+    unsigned char* slot = spsc_peek(&pq->ring);
+    if (!slot) return false;
+    pipe_hdr_t hdr;
+    memcpy(&hdr, slot, sizeof(hdr));
+    memcpy(msg, slot + sizeof(hdr), msg_size(p, q));
+    spsc_release(&pq->ring);
+    *t_ns = hdr.t_ns;
+    return true;
+}
+
+static void wake_all(pipeline_t* p) {
+    for (int q = 0; q < PIPE_STAGES; q++) {
+        sem_post(&p->queues[q].items);
+        sem_post(&p->queues[q].spaces);
+    }
+}
+
+static bool push(pipeline_t* p, int q, const void* msg) {
+    if (p->lockstep) {
+        if (queue_put(p, q, msg)) return true;
+        log_warn("pipeline: queue %d full, message dropped\n", q);
+        return false;
+    }
+    sem_wait(&p->queues[q].spaces);
+    if (atomic_load(&p->stop)) return false;
+    queue_put(p, q, msg);
+    sem_post(&p->queues[q].items);
+    return true;
+}
+
+static bool pop(pipeline_t* p, int q, void* msg, uint64_t* t_ns) {
+    if (p->lockstep) return queue_take(p, q, msg, t_ns);
+    uint64_t t0 = now_ns();
+    sem_wait(&p->queues[q].items);
+    if (trace_on) trace_span("wait", "input wait", t0, now_ns());
+    if (atomic_load(&p->stop)) return false;
+    queue_take(p, q, msg, t_ns);
+    sem_post(&p->queues[q].spaces);
+    return true;
+}
+
+// ---------- Lifecycle ----------
+bool pipe_init(pipeline_t* p, const pipe_stage_t stages[PIPE_STAGES], bool lockstep) {
+    memset(p, 0, sizeof(*p));
+    p->lockstep = lockstep;
+    atomic_init(&p->stop, false);
+    for (int i = 0; i < PIPE_STAGES; i++) {
+        if (stages[i].out_size > PIPE_MAX_MSG || !stages[i].fn) return false;
+        p->stages[i] = stages[i];
+    }
+    for (int q = 0; q < PIPE_STAGES; q++) {
+        pipe_queue_t* pq = &p->queues[q];
+        pq->slot_size = sizeof(pipe_hdr_t) + (msg_size(p, q) + 7) / 8 * 8;
+        pq->storage = malloc(pq->slot_size * PIPE_QUEUE_SLOTS);
+        if (!pq->storage) {
+            pipe_free(p);
+            return false;
+        }
+        spsc_init(&pq->ring, pq->storage, pq->slot_size, PIPE_QUEUE_SLOTS);
+        sem_init(&pq->items, 0, 0);
+        sem_init(&pq->spaces, 0, PIPE_QUEUE_SLOTS);
+    }
+    return true;
+}
+
+void pipe_free(pipeline_t* p) {
+    for (int q = 0; q < PIPE_STAGES; q++) {
+        if (!p->queues[q].storage) continue;
+        free(p->queues[q].storage);
+        sem_destroy(&p->queues[q].items);
+        sem_destroy(&p->queues[q].spaces);
+    }
+    memset(p, 0, sizeof(*p));
+}
+
+// ---------- Running ----------
+bool pipe_inject(pipeline_t* p, int q, const void* msg) {
+    if (p->lockstep) return push(p, q, msg);
+    if (sem_trywait(&p->queues[q].spaces) != 0) return false;
+    queue_put(p, q, msg);
+    sem_post(&p->queues[q].items);
+    return true;
+}
+
+// One message through stage i; false once the pipeline is to stop.
+static bool run_stage(pipeline_t* p, int i, const void* in, uint64_t t_queued) {
+    pipe_stage_t* s = &p->stages[i];
+    pipe_buf_t out;
+    uint64_t t0 = now_ns();
+    hist_record(&s->wait, t0 - t_queued);
+    pipe_result_t r = s->fn(s->ctx, in, out.bytes);
+    uint64_t t1 = now_ns();
+    hist_record(&s->service, t1 - t0);
+    if (trace_on) trace_span("stage", s->name, t0, t1);
+    s->processed++;
+    if (r == PIPE_END) {
+        atomic_store(&p->stop, true);
+        if (!p->lockstep) wake_all(p);
+        return false;
+    }
+    if (r == PIPE_PASS && !push(p, (i + 1) % PIPE_STAGES, out.bytes)) return false;
+    if (s->after) {
+        s->after(s->ctx);
+        uint64_t t2 = now_ns();
+        hist_record(&s->after_ns, t2 - t1);
+        if (trace_on) trace_span("stage", "after", t1, t2);
+    }
+    return true;
+}
+
+typedef struct {
+    pipeline_t* p;
+    int stage;
+} stage_arg_t;
+
+static void* stage_main(void* arg) {
+    stage_arg_t* a = arg;
+    if (a->stage > 0) trace_thread_name(a->p->stages[a->stage].name);
+    pipe_buf_t in;
+    uint64_t t_queued;
+    while (!atomic_load(&a->p->stop) && pop(a->p, a->stage, in.bytes, &t_queued)) {
+        if (!run_stage(a->p, a->stage, in.bytes, t_queued)) break;
+    }
+    return NULL;
+}
+
+static void run_lockstep(pipeline_t* p) {
+    pipe_buf_t in;
+    uint64_t t_queued;
+    bool progressed = true;
+    while (progressed && !atomic_load(&p->stop)) {
+        progressed = false;
+        for (int i = 0; i < PIPE_STAGES && !atomic_load(&p->stop); i++) {
+            while (!atomic_load(&p->stop) && pop(p, i, in.bytes, &t_queued)) {
+                progressed = true;
+                if (!run_stage(p, i, in.bytes, t_queued)) break;
+            }
+        }
+    }
+}
+
+void pipe_run(pipeline_t* p) {
+    uint64_t t0 = now_ns();
+    atomic_store(&p->stop, false);
+    if (p->lockstep) {
+        run_lockstep(p);
+    } else {
+        stage_arg_t args[PIPE_STAGES];
+        bool started[PIPE_STAGES] = { false };
+        for (int i = 0; i < PIPE_STAGES; i++) args[i] = (stage_arg_t){ p, i };
+        for (int i = 1; i < PIPE_STAGES; i++) {
+            started[i] = pthread_create(&p->threads[i], NULL, stage_main, &args[i]) == 0;
+            if (!started[i]) {
+                log_warn("pipeline: cannot start the %s thread\n", p->stages[i].name);
+                atomic_store(&p->stop, true);
+                wake_all(p);
+            }
+        }
+        stage_main(&args[0]);
+        for (int i = 1; i < PIPE_STAGES; i++) {
+            if (started[i]) pthread_join(p->threads[i], NULL);
+        }
+    }
+    p->run_ns += now_ns() - t0;
+}
+
+// ---------- Statistics ----------
+void pipe_print_stats(const pipeline_t* p, FILE* out) {
+    fprintf(out, "--- Pipeline (%s) ---\n", p->lockstep ? "lockstep" : "threaded");
+    fprintf(out, "ran for %.1f s\n", p->run_ns / 1e9);
+    for (int i = 0; i < PIPE_STAGES; i++) {
+        const pipe_stage_t* s = &p->stages[i];
+        const pipe_queue_t* q = &p->queues[i];
+        fprintf(out, "%s: %llu messages, queue depth max %llu\n", s->name, (unsigned long long)s->processed,
+                (unsigned long long)(q->pushes ? q->depth.max + 1 : 0));
+        hist_print(&s->wait, out, "  queued", 1000, "us");
+        hist_print(&s->service, out, "  work", 1000, "us");
+        if (s->after) hist_print(&s->after_ns, out, "  after", 1000, "us");
+    }
+}
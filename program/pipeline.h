@@ -0,0 +1,86 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "spsc_ring.h"
+#include "histogram.h"
+
+// Three-stage pipeline in a loop: stage i reads queue i and writes queue
+// (i + 1) % 3, so the last stage feeds the first again. Queues are bounded
+// SPSC rings (spsc_ring.h); a stage blocks on a semaphore when its input is
+// empty or its output is full.
+//
+// After a stage has passed a message on, its optional 'after' hook runs
+// while the next stage works on it. That is where slow work that does not
+// hold up the message goes (redrawing the map, planning ahead).
+//
+// Threaded, each stage has its own thread (the first runs on the caller's).
+// In lockstep mode the stages run on the caller's thread in a fixed order,
+// each draining its input before the next one runs, so runs are
+// reproducible: no timing decides what a stage sees.
+
+#define PIPE_STAGES      3
+#define PIPE_QUEUE_SLOTS 4          // per queue, power of two
+#define PIPE_MAX_MSG     512
+
+typedef enum {
+    PIPE_PASS,                      // 'out' is filled, pass it on
+    PIPE_HOLD,                      // nothing to pass on
+    PIPE_END,                       // stop the pipeline
+} pipe_result_t;
+
+typedef pipe_result_t (*pipe_stage_fn)(void* ctx, const void* in, void* out);
+typedef void (*pipe_after_fn)(void* ctx);
+
+typedef struct {
+    const char* name;
+    pipe_stage_fn fn;
+    pipe_after_fn after;            // may be NULL
+    void* ctx;
+    size_t out_size;                // message size it writes
+
+    uint64_t processed;
+    histogram_t wait;               // ns a message sat in the input queue
+    histogram_t service;            // ns in fn
+    histogram_t after_ns;           // ns in after
+} pipe_stage_t;
+
+typedef struct {
+    spsc_ring_t ring;
+    unsigned char* storage;
+    size_t slot_size;               // timestamp + message
+    sem_t items, spaces;
+    histogram_t depth;              // queued messages seen by each push
+    uint64_t pushes;
+} pipe_queue_t;
+
+typedef struct {
+    pipe_stage_t stages[PIPE_STAGES];
+    pipe_queue_t queues[PIPE_STAGES];    // queue i feeds stage i
+    bool lockstep;
+    _Atomic bool stop;
+    pthread_t threads[PIPE_STAGES];
+    uint64_t run_ns;
+} pipeline_t;
+
+// --- Lifecycle ---
+// stages[i].out_size is the message size of queue (i + 1) % 3.
+bool pipe_init(pipeline_t* p, const pipe_stage_t stages[PIPE_STAGES], bool lockstep);
+void pipe_free(pipeline_t* p);
+
+// --- Running ---
+// Puts a first message into queue q before running.
+bool pipe_inject(pipeline_t* p, int q, const void* msg);
+// Runs until a stage returns PIPE_END (or, in lockstep, no messages are left).
+void pipe_run(pipeline_t* p);
+
+// --- Statistics ---
+void pipe_print_stats(const pipeline_t* p, FILE* out);
+
+#endif // PIPELINE_H
@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+#include "logger.h"
+#include "explore.h"
+#include "route_cache.h"
+
+#define FIELD_VERSION 1
+
+static const int DX[4] = { 0, 1, 0, -1 };  // N, E, S, W
+static const int DY[4] = { 1, 0, -1, 0 };
+
+// ---------- Table Access ----------
+static int get_hop(const route_cache_t* rc, int t, int s) {
+    return (rc->hop[t * rc->hop_stride + s / 4] >> ((s % 4) * 2)) & 3;
+}
+
+static void set_hop(route_cache_t* rc, int t, int s, int dir) {
+    uint8_t* b = &rc->hop[t * rc->hop_stride + s / 4];
+    int shift = (s % 4) * 2;
+    *b = (uint8_t)((*b & ~(3 << shift)) | (dir << shift));
+}
+
+static bool get_reach(const route_cache_t* rc, int t, int s) {
+    return (rc->reach[t * rc->reach_stride + s / 8] >> (s % 8)) & 1;
+}
+
+static void set_reach(route_cache_t* rc, int t, int s) {
+    rc->reach[t * rc->reach_stride + s / 8] |= (uint8_t)(1 << (s % 8));
+}
+
+static void clear_reach(route_cache_t* rc, int t, int s) {
+    rc->reach[t * rc->reach_stride + s / 8] &= (uint8_t)~(1 << (s % 8));
+}
+
+static int neighbor(const route_cache_t* rc, int c, int dir) {
+    int x = c % rc->w + DX[dir], y = c / rc->w + DY[dir];
+    if (x < 0 || x >= rc->w || y < 0 || y >= rc->h) return -1;
+    return y * rc->w + x;
+}
+
+// ---------- Building ----------
+// BFS outwards from target t; each tile reached points back the way it
+// was reached, which is its first step towards t.
+static void build_row(route_cache_t* rc, int t) {
+    memset(&rc->reach[t * rc->reach_stride], 0, rc->reach_stride);
+    rc->stale[t] = 0;
+    rc->rows_built++;
+    int target = rc->cell_of[t];
+    if (rc->state[target] != CELL_FREE) return;
+    int head = 0, tail = 0;
+    rc->queue[tail++] = target;
+    set_reach(rc, t, t);
+    while (head < tail) {
+        int u = rc->queue[head++];
+        for (int dir = 0; dir < 4; dir++) {
+            int v = neighbor(rc, u, dir);
+            if (v < 0 || rc->state[v] != CELL_FREE) continue;
+            int s = rc->id[v];
+            if (get_reach(rc, t, s)) continue;
+            set_reach(rc, t, s);
+            set_hop(rc, t, s, (dir + 2) & 3);
+            rc->queue[tail++] = v;
+        }
+    }
+}
+
+static void release(route_cache_t* rc) {
+    free(rc->id);
+    free(rc->cell_of);
+    free(rc->hop);
+    free(rc->reach);
+    free(rc->stale);
+    free(rc->queue);
+    rc->id = rc->cell_of = rc->queue = NULL;
+    rc->hop = rc->reach = rc->stale = NULL;
+    rc->n = 0;
+}
+
+// (Re)allocates the tables from the current states and builds every row.
+static bool build_all(route_cache_t* rc) {
+    uint64_t t0 = now_ns();
+    release(rc);
+    int cells = rc->w * rc->h;
+    rc->id = malloc((size_t)cells * sizeof(int32_t));
+    rc->cell_of = malloc((size_t)cells * sizeof(int32_t));
+    rc->queue = malloc((size_t)cells * sizeof(int32_t));
+    if (!rc->id || !rc->cell_of || !rc->queue) return false;
+    for (int c = 0; c < cells; c++) {
+        rc->id[c] = -1;
+        if (rc->state[c] == CELL_BLOCKED) continue;
+        rc->id[c] = rc->n;
+        rc->cell_of[rc->n++] = c;
+    }
+    rc->hop_stride = ((size_t)rc->n + 3) / 4;
+    rc->reach_stride = ((size_t)rc->n + 7) / 8;
+    rc->hop = calloc((size_t)rc->n, rc->hop_stride);
+    rc->reach = calloc((size_t)rc->n, rc->reach_stride);
+    rc->stale = calloc((size_t)rc->n, 1);
+    if (rc->n > 0 && (!rc->hop || !rc->reach || !rc->stale)) return false;
+    for (int t = 0; t < rc->n; t++) build_row(rc, t);
+    rc->builds++;
+    rc->build_ns = now_ns() - t0;
+    return true;
+}
+
+bool route_cache_build(route_cache_t* rc, int w, int h, const uint8_t* cells) {
+    memset(rc, 0, sizeof(*rc));
+    if (w <= 0 || h <= 0) return false;
+    rc->w = w;
+    rc->h = h;
+    rc->state = malloc((size_t)w * h);
+    if (!rc->state) return false;
+    memcpy(rc->state, cells, (size_t)w * h);
+    if (!build_all(rc)) {
+        route_cache_free(rc);
+        return false;
+    }
+    return true;
+}
+
+void route_cache_free(route_cache_t* rc) {
+    release(rc);
+    free(rc->state);
+    memset(rc, 0, sizeof(*rc));
+}
+
+// ---------- Invalidation ----------
+static void invalidate(route_cache_t* rc, int t) {
+    if (rc->stale[t]) return;
+    rc->stale[t] = 1;
+    rc->rows_invalidated++;
+}
+
+// Route length from source s along row t's hops
+static int walk_length(const route_cache_t* rc, int t, int s) {
+    int target = rc->cell_of[t], c = rc->cell_of[s], len = 0;
+    while (c != target) {
+        c = neighbor(rc, c, get_hop(rc, t, rc->id[c]));
+        len++;
+    }
+    return len;
+}
+
+// Tile c left the free set: only rows with a route through it change.
+static void on_removed(route_cache_t* rc, int c) {
+    int sc = rc->id[c];
+    for (int t = 0; t < rc->n; t++) {
+        if (rc->stale[t] || !get_reach(rc, t, sc)) continue;
+        if (t == sc) {
+            invalidate(rc, t);
+            continue;
+        }
+        for (int dir = 0; dir < 4; dir++) {
+            int v = neighbor(rc, c, dir);
+            if (v < 0 || rc->state[v] != CELL_FREE) continue;
+            int sv = rc->id[v];
+            if (get_reach(rc, t, sv) && get_hop(rc, t, sv) == ((dir + 2) & 3)) {
+                invalidate(rc, t);
+                break;
+            }
+        }
+    }
+}
+
+// Tile c joined the free set: a row changes if c joins two regions or gives
+// a shortcut (free neighbours at distances differing by 2 or more).
+// Otherwise c just gets its own entry, via its closest neighbour.
+static void on_added(route_cache_t* rc, int c) {
+    int sc = rc->id[c];
+    for (int t = 0; t < rc->n; t++) {
+        if (rc->stale[t]) continue;
+        if (t == sc) {
+            invalidate(rc, t);
+            continue;
+        }
+        int best = -1, best_dir = 0, worst = -1;
+        bool unreached = false;
+        for (int dir = 0; dir < 4; dir++) {
+            int v = neighbor(rc, c, dir);
+            if (v < 0 || rc->state[v] != CELL_FREE) continue;
+            if (!get_reach(rc, t, rc->id[v])) {
+                unreached = true;
+                continue;
+            }
+            int len = walk_length(rc, t, rc->id[v]);
+            if (best < 0 || len < best) {
+                best = len;
+                best_dir = dir;
+            }
+            if (len > worst) worst = len;
+        }
+        if (best < 0) {                         // c stays unreachable from t
+            clear_reach(rc, t, sc);
+            continue;
+        }
+        if (unreached || worst - best >= 2) {
+            invalidate(rc, t);
+            continue;
+        }
+        set_reach(rc, t, sc);
+        set_hop(rc, t, sc, best_dir);
+    }
+}
+
+void route_cache_set_cell(route_cache_t* rc, int x, int y, uint8_t state) {
+    if (!rc->state || x < 0 || x >= rc->w || y < 0 || y >= rc->h) return;
+    int c = y * rc->w + x;
+    uint8_t old = rc->state[c];
+    if (old == state) return;
+    rc->state[c] = state;
+    if (rc->id[c] < 0) {
+        if (!build_all(rc)) log_warn("route cache: out of memory rebuilding\n");
+        return;
+    }
+    if (old == CELL_FREE) on_removed(rc, c);
+    else if (state == CELL_FREE) on_added(rc, c);
+}
+
+// ---------- Queries ----------
+// Table indices for a query, rebuilding the target row if it is stale.
+static bool lookup(route_cache_t* rc, int sx, int sy, int tx, int ty, int* s, int* t) {
+    if (!rc->id || sx < 0 || sx >= rc->w || sy < 0 || sy >= rc->h || tx < 0 || tx >= rc->w || ty < 0 ||
+        ty >= rc->h) return false;
+    int sc = sy * rc->w + sx, tc = ty * rc->w + tx;
+    if (rc->state[sc] != CELL_FREE || rc->state[tc] != CELL_FREE) return false;
+    *s = rc->id[sc];
+    *t = rc->id[tc];
+    rc->queries++;
+    if (rc->stale[*t]) build_row(rc, *t);
+    return get_reach(rc, *t, *s);
+}
+
+int route_cache_next_dir(route_cache_t* rc, int sx, int sy, int tx, int ty) {
+    int s, t;
+    if (!lookup(rc, sx, sy, tx, ty, &s, &t) || s == t) return -1;
+    return get_hop(rc, t, s);
+}
+
+int route_cache_route(route_cache_t* rc, int sx, int sy, int tx, int ty, uint8_t* dirs, int max) {
+    int s, t;
+    if (!lookup(rc, sx, sy, tx, ty, &s, &t)) return -1;
+    int target = rc->cell_of[t], c = rc->cell_of[s], len = 0;
+    while (c != target) {
+        int dir = get_hop(rc, t, rc->id[c]);
+        if (len < max) dirs[len] = (uint8_t)dir;
+        c = neighbor(rc, c, dir);
+        len++;
+    }
+    return len;
+}
+
+// ---------- Stored Field ----------
+// Text file: version line, size line, then one row of CELL_* digits per y,
+// highest y first as on the map display.
+bool route_field_load(const char* path, int w, int h, uint8_t* cells) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[512];
+    int version = 0, fw = 0, fh = 0;
+    bool ok = fgets(line, sizeof(line), f) && sscanf(line, "v %d", &version) == 1 && version == FIELD_VERSION &&
+              fgets(line, sizeof(line), f) && sscanf(line, "%d %d", &fw, &fh) == 2 && fw == w && fh == h;
+    for (int y = h - 1; ok && y >= 0; y--) {
+        ok = fgets(line, sizeof(line), f) && (int)strcspn(line, "\n") == w;
+        for (int x = 0; ok && x < w; x++) {
+            ok = line[x] >= '0' + CELL_UNKNOWN && line[x] <= '0' + CELL_BLOCKED;
+            if (ok) cells[y * w + x] = (uint8_t)(line[x] - '0');
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+bool route_field_save(const char* path, int w, int h, const uint8_t* cells) {
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "w");
+    if (!f) {
+        log_warn("route cache: cannot write %s\n", tmp);
+        return false;
+    }
+    fprintf(f, "v %d\n%d %d\n", FIELD_VERSION, w, h);
+    for (int y = h - 1; y >= 0; y--) {
+        for (int x = 0; x < w; x++) fputc('0' + cells[y * w + x], f);
+        fputc('\n', f);
+    }
+    return fclose(f) == 0 && rename(tmp, path) == 0;
+}
+
+// ---------- Statistics ----------
+size_t route_cache_bytes(const route_cache_t* rc) {
+    size_t cells = (size_t)rc->w * rc->h;
+    return cells * (1 + 3 * sizeof(int32_t)) + (size_t)rc->n * (rc->hop_stride + rc->reach_stride + 1);
+}
+
+void route_cache_print_stats(const route_cache_t* rc, FILE* out) {
+    fprintf(out, "--- Route cache ---\n");
+    fprintf(out, "%d tiles, %zu bytes, built in %llu us (%llu full builds)\n", rc->n, route_cache_bytes(rc),
+            (unsigned long long)(rc->build_ns / 1000), (unsigned long long)rc->builds);
+    fprintf(out, "%llu queries, %llu rows invalidated, %llu rows built\n", (unsigned long long)rc->queries,
+            (unsigned long long)rc->rows_invalidated, (unsigned long long)rc->rows_built);
+}
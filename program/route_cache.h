@@ -0,0 +1,66 @@
+#ifndef ROUTE_CACHE_H
+#define ROUTE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// All-pairs route cache for a known field. For every target tile it keeps a
+// next-hop table over all source tiles, 2 bits per entry plus a reachability
+// bit, built by one BFS per target. A route query just follows next hops, so
+// it costs O(path length).
+//
+// When a tile changes state only the targets whose routes are affected are
+// marked stale: a tile that stops being free invalidates the targets whose
+// routes passed through it, and a tile that becomes free invalidates the
+// targets it gives a shortcut to. Stale targets are rebuilt on their next
+// query. Only a tile that was blocked when the cache was built has no table
+// column; freeing one of those rebuilds everything.
+//
+// Cell states are the CELL_* values from explore.h; only free cells are
+// routed over. Coordinates and headings follow grid_navigation.c.
+
+#define ROUTE_FIELD_FILE "/home/robot/.ev3_field"
+
+typedef struct {
+    int w, h;
+    uint8_t* state;             // CELL_* per cell
+    int32_t* id;                // cell -> table index, -1 = none
+    int32_t* cell_of;           // table index -> cell
+    int n;                      // table indices in use
+    size_t hop_stride;          // bytes per target row of hops
+    size_t reach_stride;        // bytes per target row of reach bits
+    uint8_t* hop;               // [target][source] 2-bit heading
+    uint8_t* reach;             // [target][source] 1 bit
+    uint8_t* stale;             // per target
+    int32_t* queue;             // BFS scratch
+
+    uint64_t builds, rows_built, rows_invalidated, queries;
+    uint64_t build_ns;          // last full build
+} route_cache_t;
+
+// --- Lifecycle ---
+// cells is row-major (y * w + x) CELL_* values.
+bool route_cache_build(route_cache_t* rc, int w, int h, const uint8_t* cells);
+void route_cache_free(route_cache_t* rc);
+
+// --- Updates ---
+void route_cache_set_cell(route_cache_t* rc, int x, int y, uint8_t state);
+
+// --- Queries ---
+// Heading of the first step from (sx, sy) to (tx, ty); -1 if there is no
+// route over known free tiles or the start is the target.
+int route_cache_next_dir(route_cache_t* rc, int sx, int sy, int tx, int ty);
+// Fills up to max headings of the route; returns its full length, -1 if none.
+int route_cache_route(route_cache_t* rc, int sx, int sy, int tx, int ty, uint8_t* dirs, int max);
+
+// --- Stored field ---
+bool route_field_load(const char* path, int w, int h, uint8_t* cells);
+bool route_field_save(const char* path, int w, int h, const uint8_t* cells);
+
+// --- Statistics ---
+size_t route_cache_bytes(const route_cache_t* rc);
+void route_cache_print_stats(const route_cache_t* rc, FILE* out);
+
+#endif // ROUTE_CACHE_H
@@ -0,0 +1,136 @@
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "timing.h"
+#include "logger.h"
+#include "scheduler.h"
+
+// ---------- Setup ----------
+void sched_init(scheduler_t* s) {
+    memset(s, 0, sizeof(*s));
+    atomic_init(&s->stop, false);
+}
+
+int sched_add(scheduler_t* s, const char* name, uint32_t period_us, uint32_t phase_us,
+              sched_fn_t fn, void* arg) {
+    if (s->task_count >= SCHED_MAX_TASKS || period_us == 0 || !fn) return -1;
+    sched_task_t* t = &s->tasks[s->task_count];
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->fn = fn;
+    t->arg = arg;
+    t->period_ns = (uint64_t)period_us * 1000ull;
+    t->next_deadline = (uint64_t)phase_us * 1000ull;  // relative until sched_run()
+    t->active = true;
+    return s->task_count++;
+}
+
+void sched_set_realtime(scheduler_t* s, int priority, bool lock_memory) {
+    s->rt_priority = priority;
+    s->lock_memory = lock_memory;
+}
+
+static void apply_realtime(const scheduler_t* s) {
+    if (s->lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        log_warn("sched: mlockall failed (%s), continuing unlocked\n", strerror(errno));
+    }
+    if (s->rt_priority > 0) {
+        struct sched_param sp = { .sched_priority = s->rt_priority };
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+        if (err != 0) {
+            log_warn("sched: SCHED_FIFO %d refused (%s), using default policy\n",
+                     s->rt_priority, strerror(err));
+        }
+    }
+}
+
+// ---------- Running ----------
+static sched_task_t* next_due(scheduler_t* s) {
+    sched_task_t* best = NULL;
+    for (int i = 0; i < s->task_count; i++) {
+        sched_task_t* t = &s->tasks[i];
+        if (t->active && (!best || t->next_deadline < best->next_deadline)) best = t;
+    }
+    return best;
+}
+
+static void sleep_until(uint64_t deadline_ns) {
+    struct timespec ts = ns_to_timespec(deadline_ns);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+void sched_run(scheduler_t* s) {
+    apply_realtime(s);
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < s->task_count; i++) {
+        s->tasks[i].next_deadline += start;
+    }
+
+    while (!atomic_load_explicit(&s->stop, memory_order_acquire)) {
+        sched_task_t* t = next_due(s);
+        if (!t) break;
+
+        sleep_until(t->next_deadline);
+        if (atomic_load_explicit(&s->stop, memory_order_acquire)) break;
+
+        uint64_t deadline = t->next_deadline;
+        uint64_t begin = now_ns();
+        hist_record(&t->jitter, begin - deadline);
+
+        bool keep = t->fn(t->arg);
+        uint64_t end = now_ns();
+        t->runs++;
+
+        uint64_t next = deadline + t->period_ns;
+        if (end > next) {
+            // Finished past the next deadline: count it and skip the periods
+            // we can no longer make instead of bursting to catch up.
+            uint64_t late = end - next;
+            uint64_t skipped = late / t->period_ns + 1;
+            t->overruns++;
+            t->missed_periods += skipped;
+            hist_record(&t->overrun, late);
+            next += skipped * t->period_ns;
+        }
+        t->next_deadline = next;
+        if (!keep) t->active = false;
+    }
+}
+
+static void* sched_thread_main(void* arg) {
+    sched_run((scheduler_t*)arg);
+    return NULL;
+}
+
+bool sched_start(scheduler_t* s) {
+    atomic_store(&s->stop, false);
+    if (pthread_create(&s->thread, NULL, sched_thread_main, s) != 0) return false;
+    s->threaded = true;
+    return true;
+}
+
+void sched_stop(scheduler_t* s) {
+    atomic_store_explicit(&s->stop, true, memory_order_release);
+    if (s->threaded) {
+        pthread_join(s->thread, NULL);
+        s->threaded = false;
+    }
+}
+
+// ---------- Statistics ----------
+void sched_print_stats(const scheduler_t* s, FILE* out) {
+    fprintf(out, "--- Scheduler stats ---\n");
+    for (int i = 0; i < s->task_count; i++) {
+        const sched_task_t* t = &s->tasks[i];
+        fprintf(out, "%s: period %llu us, %llu runs, %llu overruns, %llu missed periods\n",
+                t->name, (unsigned long long)(t->period_ns / 1000),
+                (unsigned long long)t->runs, (unsigned long long)t->overruns,
+                (unsigned long long)t->missed_periods);
+        hist_print(&t->jitter, out, "  start jitter", 1000, "us");
+        if (t->overruns > 0) hist_print(&t->overrun, out, "  overrun", 1000, "us");
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "histogram.h"
+
+// Fixed-rate scheduler for periodic control tasks. Deadlines are absolute
+// (CLOCK_MONOTONIC + clock_nanosleep(TIMER_ABSTIME)), so a task's period
+// does not drift by its own execution time the way a Sleep(ms) loop does.
+// Per task it records start jitter (actual start - deadline) and overruns
+// (how far past the next deadline the task finished).
+
+#define SCHED_MAX_TASKS 8
+
+// Return false to unregister the task.
+typedef bool (*sched_fn_t)(void* arg);
+
+typedef struct {
+    const char* name;
+    sched_fn_t fn;
+    void* arg;
+    uint64_t period_ns;
+    uint64_t next_deadline;
+    bool active;
+
+    uint64_t runs;
+    uint64_t overruns;          // runs that finished after the next deadline
+    uint64_t missed_periods;    // deadlines skipped to catch up
+    histogram_t jitter;         // ns late at start
+    histogram_t overrun;        // ns past next deadline at finish
+} sched_task_t;
+
+typedef struct {
+    sched_task_t tasks[SCHED_MAX_TASKS];
+    int task_count;
+    int rt_priority;            // 0 = keep default policy, else SCHED_FIFO priority
+    bool lock_memory;
+    _Atomic bool stop;
+    bool threaded;
+    pthread_t thread;
+} scheduler_t;
+
+// --- Setup ---
+void sched_init(scheduler_t* s);
+// Returns the task index, or -1 if the table is full. The first run is one
+// 'phase_us' after the scheduler starts, then every 'period_us'.
+int  sched_add(scheduler_t* s, const char* name, uint32_t period_us, uint32_t phase_us,
+               sched_fn_t fn, void* arg);
+// Optional SCHED_FIFO priority (1-99) and mlockall(); applied when running.
+void sched_set_realtime(scheduler_t* s, int priority, bool lock_memory);
+
+// --- Running ---
+void sched_run(scheduler_t* s);       // blocks until sched_stop() or no active tasks
+bool sched_start(scheduler_t* s);     // sched_run() on a background thread
+void sched_stop(scheduler_t* s);      // request stop; joins the thread if started
+
+// --- Statistics ---
+void sched_print_stats(const scheduler_t* s, FILE* out);
+
+#endif // SCHEDULER_H
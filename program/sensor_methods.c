@@ -7,7 +7,13 @@
 #include "ev3_port.h"
 #include "ev3_sensor.h"
 #include "ev3_tacho.h"
+#include "sensor_modes.h"
+#include "gyro_service.h"
+#include "stall_watch.h"
+#include "motion_profile.h"
 #include "sensor_methods.h"
+#include "latency_stats.h"
+#include "trace.h"
 
 #define Sleep(ms) usleep((ms) * 1000)
 #define WHEEL_DIAMETER_MM 49.5
@@ -24,13 +30,17 @@ uint8_t left_motor  = DESC_LIMIT;
 uint8_t right_motor = DESC_LIMIT;
 
 // ---------- Utility Methods ----------
+// Waits end early (and the motors are already stopped) if the stall watch
+// trips; callers check stall_watch_tripped() afterwards.
 static void wait_by_degrees(int speed, int degrees) {
     int wait = (speed != 0) ? ((abs(degrees) * 1000) / abs(speed)) + 200 : 1000;
-    Sleep(wait);
+    stall_watch_wait(wait);
+    stall_watch_disarm();
 }
 
 static void wait_by_duration(int duration_ms) {
-    Sleep(duration_ms + 200);
+    stall_watch_wait(duration_ms + 200);
+    stall_watch_disarm();
 }
 
 // ---------- Gyro Sensor Methods ----------
@@ -38,14 +48,25 @@ void set_gyro_auto_reset(bool enable) {
     gyro_auto_reset = enable;
 }
 
+// With the gyro service running this is a software zero and returns at once;
+// otherwise the sensor is reset by a mode switch, which waits for the
+// first angle from the new mode (up to SMODE_SETTLE_MAX_MS per switch).
 bool reset_gyro(uint8_t sn_gyro) {
-    set_sensor_mode(sn_gyro, "GYRO-RATE");
-    Sleep(100);
-    set_sensor_mode(sn_gyro, "GYRO-ANG");
-    Sleep(100);
+    LAT_SCOPE(reset_gyro);
+    TRACE_SCOPE("sensor", "reset_gyro");
+    if (gyro_service_uses(sn_gyro)) {
+        gyro_service_zero();
+        return true;
+    }
+    // Entering GYRO-ANG resets the angle; go through GYRO-RATE if needed
+    smode_request(sn_gyro, "GYRO-RATE");
+    smode_ensure(sn_gyro);
+    smode_request(sn_gyro, "GYRO-ANG");
+    return smode_ensure(sn_gyro);
 }
 
 bool init_gyro(uint8_t* sn_gyro, bool reset) {
+    LAT_SCOPE(init_gyro);
     if (ev3_search_sensor(LEGO_EV3_GYRO, sn_gyro, 0)) {
         if (reset || gyro_auto_reset) reset_gyro(*sn_gyro);
         return true;
@@ -53,7 +74,27 @@ bool init_gyro(uint8_t* sn_gyro, bool reset) {
     return false;
 }
 
+// Like init_gyro() but integrates the rate in software (see gyro_service.h),
+// so there is no reset stall. Call after init_motors() so the service can
+// tell when the robot is at rest. Falls back to the angle-mode reset.
+bool init_gyro_service(uint8_t* sn_gyro) {
+    LAT_SCOPE(init_gyro_service);
+    if (!ev3_search_sensor(LEGO_EV3_GYRO, sn_gyro, 0)) return false;
+    if (gyro_service_start(*sn_gyro, left_motor, right_motor)) {
+        for (int i = 0; i < 100 && !gyro_service_ready(); i++) Sleep(5);
+        return true;
+    }
+    reset_gyro(*sn_gyro);
+    return true;
+}
+
 bool get_gyro_angle(uint8_t sn_gyro, int* angle) {
+    LAT_SCOPE(get_gyro_angle);
+    TRACE_SCOPE("sensor", "get_gyro_angle");
+    if (gyro_service_uses(sn_gyro)) {
+        *angle = gyro_service_angle();
+        return true;
+    }
     int raw = 0;
     if (get_sensor_value(0, sn_gyro, &raw)) {
         *angle = -raw;
@@ -74,6 +115,7 @@ const char* get_button_name(uint8_t keys) {
 }
 
 bool is_button_pressed(uint8_t button_mask) {
+    LAT_SCOPE(is_button_pressed);
     uint8_t keys = 0;
     ev3_read_keys(&keys);
     return (keys & button_mask) != 0;
@@ -81,17 +123,21 @@ bool is_button_pressed(uint8_t button_mask) {
 
 // ---------- Color Sensor Methods (Revised) ----------
 int init_all_color_sensors(uint8_t* sn_array, int max_sensors) {
+    LAT_SCOPE(init_all_color_sensors);
     int count = 0;
-    uint8_t sn;
-    int i = 0;
-    while (ev3_search_sensor(LEGO_EV3_COLOR, &sn, i++) && count < max_sensors) {
-        set_sensor_mode(sn, "COL-COLOR");
-        sn_array[count++] = sn;
+    uint8_t sn = 0;
+    // Continue after the last match instead of restarting the search
+    while (count < max_sensors && ev3_search_sensor(LEGO_EV3_COLOR, &sn, sn)) {
+        smode_request(sn, "COL-COLOR");
+        sn_array[count++] = sn++;
     }
     return count;
 }
 
 bool get_color_value(uint8_t sn_color, int* value) {
+    LAT_SCOPE(get_color_value);
+    TRACE_SCOPE("sensor", "get_color_value");
+    smode_ensure(sn_color);
     if (get_sensor_value(0, sn_color, value)) {
         if (*value >= 0 && *value < COLOR_COUNT) {
             return true;
@@ -101,21 +147,34 @@ bool get_color_value(uint8_t sn_color, int* value) {
     return false;
 }
 
+// Reflected light intensity, 0..100 (the sensor must be in COL-REFLECT)
+bool get_reflect_value(uint8_t sn_color, int* value) {
+    LAT_SCOPE(get_reflect_value);
+    TRACE_SCOPE("sensor", "get_reflect_value");
+    smode_ensure(sn_color);
+    return get_sensor_value(0, sn_color, value);
+}
+
 // ---------- Ultrasonic Sensor Methods ----------
 bool init_ultrasonic(uint8_t* sn_us) {
+    LAT_SCOPE(init_ultrasonic);
     if (ev3_search_sensor(LEGO_EV3_US, sn_us, 0)) {
-        set_sensor_mode(*sn_us, "US-DIST-CM");
+        smode_request(*sn_us, "US-DIST-CM");
         return true;
     }
     return false;
 }
 
 bool get_distance_mm(uint8_t sn_us, int* distance_mm) {
+    LAT_SCOPE(get_distance_mm);
+    TRACE_SCOPE("sensor", "get_distance_mm");
+    smode_ensure(sn_us);
     return get_sensor_value(0, sn_us, distance_mm);
 }
 
 // ---------- Motor Methods (Revised init_motors) ----------
 bool init_motors(void) {
+    LAT_SCOPE(init_motors);
     if (ev3_search_tacho(LEGO_EV3_L_MOTOR, &left_motor, 0)) {
         if (ev3_search_tacho(LEGO_EV3_L_MOTOR, &right_motor, 1)) {
             return true;
@@ -126,12 +185,16 @@ bool init_motors(void) {
 }
 
 void set_speed(int speed) {
+    LAT_SCOPE(set_speed);
     set_tacho_speed_sp(left_motor,  speed);
     set_tacho_speed_sp(right_motor, speed);
 }
 
 void move_for_time(int speed, int duration_ms) {
+    LAT_SCOPE(move_for_time);
+    TRACE_SCOPE("motion", "move_for_time");
     set_speed(speed);
+    stall_watch_arm(speed, speed);
     set_tacho_time_sp(left_motor,  duration_ms);
     set_tacho_time_sp(right_motor, duration_ms);
     set_tacho_command_inx(left_motor,  TACHO_RUN_TIMED);
@@ -140,7 +203,10 @@ void move_for_time(int speed, int duration_ms) {
 }
 
 void move_for_degrees(int speed, int degrees) {
+    LAT_SCOPE(move_for_degrees);
+    TRACE_SCOPE("motion", "move_for_degrees");
     set_speed(speed);
+    stall_watch_arm(speed, speed);
     set_tacho_position_sp(left_motor,  degrees);
     set_tacho_position_sp(right_motor, degrees);
     set_tacho_command_inx(left_motor,  TACHO_RUN_TO_REL_POS);
@@ -152,7 +218,37 @@ static int robot_to_wheel_deg(int robot_deg, float multiplier) {
     return (int)(robot_deg * multiplier * WHEEL_BASE_MM / WHEEL_DIAMETER_MM);
 }
 
-void tank_turn(int speed, int degrees) {
+// Profiled versions: the velocity profile is planned per move from the
+// distance and the limits (see motion_profile.h). Return false if the move
+// was cut short by the stall watch.
+bool move_for_degrees_profiled(int degrees, const motion_limits_t* limits) {
+    LAT_SCOPE(move_for_degrees_profiled);
+    return move_for_degrees_tracked(degrees, limits, NULL, NULL);
+}
+
+// As above, with a callback every stream period that can watch the distance
+// covered and cut the move short.
+bool move_for_degrees_tracked(int degrees, const motion_limits_t* limits, motion_progress_fn progress, void* ctx) {
+    LAT_SCOPE(move_for_degrees_tracked);
+    TRACE_SCOPE("motion", "move_for_degrees_tracked");
+    motion_profile_t profile;
+    motion_plan(&profile, degrees, limits);
+    int sign = degrees < 0 ? -1 : 1;
+    return motion_run(&profile, left_motor, right_motor, sign, sign, progress, ctx);
+}
+
+bool tank_turn_profiled(int degrees, const motion_limits_t* limits) {
+    LAT_SCOPE(tank_turn_profiled);
+    TRACE_SCOPE("motion", "tank_turn_profiled");
+    int wheel_deg = robot_to_wheel_deg(degrees, 1.0);
+    motion_profile_t profile;
+    motion_plan(&profile, wheel_deg, limits);
+    int sign = wheel_deg < 0 ? -1 : 1;
+    return motion_run(&profile, left_motor, right_motor, sign, -sign, NULL, NULL);
+}
+
+void start_tank_turn(int speed, int degrees) {
+    LAT_SCOPE(start_tank_turn);
     int wheel_deg = robot_to_wheel_deg(degrees, 1.0);
     int s = abs(speed);
     set_tacho_speed_sp(left_motor,  s);
@@ -161,10 +257,20 @@ void tank_turn(int speed, int degrees) {
     set_tacho_position_sp(right_motor, -wheel_deg);
     set_tacho_command_inx(left_motor,  TACHO_RUN_TO_REL_POS);
     set_tacho_command_inx(right_motor, TACHO_RUN_TO_REL_POS);
-    wait_by_degrees(s, abs(wheel_deg));
+}
+
+void tank_turn(int speed, int degrees) {
+    LAT_SCOPE(tank_turn);
+    TRACE_SCOPE("motion", "tank_turn");
+    int s = abs(speed);
+    stall_watch_arm(s, s);
+    start_tank_turn(speed, degrees);
+    wait_by_degrees(s, abs(robot_to_wheel_deg(degrees, 1.0)));
 }
 
 void pivot_turn(int speed, int degrees, int direction) {
+    LAT_SCOPE(pivot_turn);
+    TRACE_SCOPE("motion", "pivot_turn");
     int wheel_deg = robot_to_wheel_deg(degrees, 2.0);
     int s = abs(speed);
     uint8_t motor_to_move = (direction == 1) ? right_motor : left_motor;
@@ -173,28 +279,43 @@ void pivot_turn(int speed, int degrees, int direction) {
     set_tacho_speed_sp(motor_to_move, s);
     set_tacho_position_sp(motor_to_move, wheel_deg);
     set_tacho_command_inx(motor_to_stop, TACHO_STOP);
+    stall_watch_arm(motor_to_move == left_motor ? s : 0, motor_to_move == right_motor ? s : 0);
     set_tacho_command_inx(motor_to_move, TACHO_RUN_TO_REL_POS);
     wait_by_degrees(s, wheel_deg);
 }
 
 void arc_turn(int outer_speed, float ratio, int duration_ms) {
+    LAT_SCOPE(arc_turn);
+    TRACE_SCOPE("motion", "arc_turn");
     if (ratio < 0.0f || ratio > 1.0f) return;
     int inner_speed = (int)(outer_speed * ratio);
     set_tacho_speed_sp(left_motor,  outer_speed);
     set_tacho_speed_sp(right_motor, inner_speed);
     set_tacho_time_sp(left_motor,  duration_ms);
     set_tacho_time_sp(right_motor, duration_ms);
+    stall_watch_arm(outer_speed, inner_speed);
     set_tacho_command_inx(left_motor,  TACHO_RUN_TIMED);
     set_tacho_command_inx(right_motor, TACHO_RUN_TIMED);
     wait_by_duration(duration_ms);
 }
 
+// A motor whose state cannot be read counts as stopped.
+bool motors_running(void) {
+    LAT_SCOPE(motors_running);
+    FLAGS_T left = 0, right = 0;
+    get_tacho_state_flags(left_motor, &left);
+    get_tacho_state_flags(right_motor, &right);
+    return ((left | right) & TACHO_RUNNING) != 0;
+}
+
 void stop_motors(void) {
+    LAT_SCOPE(stop_motors);
     set_tacho_command_inx(left_motor,  TACHO_STOP);
     set_tacho_command_inx(right_motor, TACHO_STOP);
 }
 
 void print_motor_stats(void) {
+    LAT_SCOPE(print_motor_stats);
     int posL = 0, posR = 0, spdL = 0, spdR = 0;
     get_tacho_position(left_motor,  &posL);
     get_tacho_position(right_motor, &posR);
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "ev3.h"
+#include "motion_profile.h"
 
 // --- Shared Constants ---
 extern const char* color_names[];
@@ -12,6 +13,7 @@ extern const int COLOR_COUNT;
 // --- Gyro Sensor Methods ---
 void set_gyro_auto_reset(bool enable);
 bool init_gyro(uint8_t* sn_gyro, bool reset);
+bool init_gyro_service(uint8_t* sn_gyro);
 bool get_gyro_angle(uint8_t sn_gyro, int* angle);
 bool reset_gyro(uint8_t sn_gyro);
 
@@ -23,6 +25,7 @@ bool is_button_pressed(uint8_t button_mask);
 // --- Color Sensor Methods ---
 int init_all_color_sensors(uint8_t* sn_array, int max_sensors);
 bool get_color_value(uint8_t sn_color, int* value);
+bool get_reflect_value(uint8_t sn_color, int* value);
 
 // --- Ultrasonic Sensor Methods ---
 bool init_ultrasonic(uint8_t* sn_us);
@@ -34,9 +37,15 @@ void set_speed(int speed);
 void move_for_time(int speed, int duration_ms);
 void move_for_degrees(int speed, int degrees);
 void tank_turn(int speed, int degrees);
+// Non-blocking: start the turn, then poll motors_running() (see tasks.h).
+void start_tank_turn(int speed, int degrees);
+bool move_for_degrees_profiled(int degrees, const motion_limits_t* limits);
+bool move_for_degrees_tracked(int degrees, const motion_limits_t* limits, motion_progress_fn progress, void* ctx);
+bool tank_turn_profiled(int degrees, const motion_limits_t* limits);
 void pivot_turn(int speed, int degrees, int direction);
 void arc_turn(int outer_speed, float ratio, int duration_ms);
 void stop_motors(void);
+bool motors_running(void);
 void print_motor_stats(void);
 
 // ---- TILE
@@ -0,0 +1,180 @@
+#include <string.h>
+#include <unistd.h>
+#include "ev3.h"
+#include "ev3_sensor.h"
+#include "histogram.h"
+#include "timing.h"
+#include "sensor_modes.h"
+
+typedef struct {
+    const char* wanted;
+    const char* current;            // NULL = not known yet
+    const char* previous;           // mode before the last switch
+    char read_mode[32];             // current mode as read from the sensor
+    bool pending;                   // switch to 'wanted' not issued yet
+    bool settling;                  // switched, no value from the new mode yet
+    int stale_lo, stale_hi;         // values seen since the switch, old mode's included
+    uint64_t switched_ns;
+
+    uint32_t switches;
+    uint32_t skipped;               // requests for the mode it was already in
+    uint32_t timeouts;              // settled by SMODE_SETTLE_MAX_MS
+    uint32_t failures;
+    histogram_t first_value;        // ns from switch to first new value
+} smode_sensor_t;
+
+static smode_sensor_t sensors[SENSOR_DESC__LIMIT_];
+static smode_known_fn store_known = NULL;
+static smode_note_fn store_note = NULL;
+
+// ---------- Setup ----------
+void smode_set_store(smode_known_fn known, smode_note_fn note) {
+    store_known = known;
+    store_note = note;
+}
+
+// The sensor's own mode attribute is the authority: it is read once per
+// run (a few microseconds) and tracked from then on. The store is only
+// asked when that read fails.
+static const char* current_mode(uint8_t sn) {
+    smode_sensor_t* s = &sensors[sn];
+    if (s->current) return s->current;
+    if (get_sensor_mode(sn, s->read_mode, sizeof(s->read_mode))) s->current = s->read_mode;
+    else if (store_known) s->current = store_known(sn);
+    return s->current;
+}
+
+void smode_request(uint8_t sn, const char* mode) {
+    if (sn >= SENSOR_DESC__LIMIT_ || !mode) return;
+    smode_sensor_t* s = &sensors[sn];
+    s->wanted = mode;
+    const char* current = current_mode(sn);
+    s->pending = !current || strcmp(current, mode) != 0;
+    if (!s->pending) s->skipped++;
+}
+
+// ---------- Switching ----------
+typedef struct {
+    const char* mode;
+    int lo, hi;
+} mode_range_t;
+
+// Values each mode can report, for telling new-mode values from old ones.
+static const mode_range_t mode_ranges[] = {
+    { "COL-COLOR", 0, 7 },
+    { "COL-REFLECT", 0, 100 },
+    { "COL-AMBIENT", 0, 100 },
+    { "GYRO-RATE", -440, 440 },
+    { "US-DIST-CM", 0, 2550 },
+};
+
+static const mode_range_t* find_range(const char* mode) {
+    for (size_t i = 0; mode && i < sizeof(mode_ranges) / sizeof(mode_ranges[0]); i++) {
+        if (strcmp(mode_ranges[i].mode, mode) == 0) return &mode_ranges[i];
+    }
+    return NULL;
+}
+
+// True if v can only have come from the new mode.
+static bool only_new_mode(const smode_sensor_t* s, int v) {
+    const mode_range_t* to = find_range(s->wanted);
+    const mode_range_t* from = find_range(s->previous);
+    return to && from && v >= to->lo && v <= to->hi && (v < from->lo || v > from->hi);
+}
+
+static bool start_switch(uint8_t sn) {
+    smode_sensor_t* s = &sensors[sn];
+    s->pending = false;
+    s->previous = s->current;
+    int v = 0;
+    get_sensor_value(0, sn, &v);
+    s->stale_lo = s->stale_hi = v;
+    if (!set_sensor_mode(sn, (char*)s->wanted)) {
+        s->failures++;
+        s->current = NULL;          // unknown now: read it back next time
+        return false;
+    }
+    s->current = s->wanted;
+    if (store_note) store_note(sn, s->wanted);
+    s->switches++;
+    s->settling = true;
+    s->switched_ns = now_ns();
+    return true;
+}
+
+// One check of a settling sensor; true once it has settled. A value out of
+// the old mode's range settles it at once. Otherwise the old mode's value
+// may still be wobbling (reflectance while the robot drives), so a value
+// only counts after SMODE_SETTLE_MIN_MS and if it is outside everything
+// read since the switch; values inside widen that range instead.
+static bool poll_settled(uint8_t sn) {
+    smode_sensor_t* s = &sensors[sn];
+    if (!s->settling) return true;
+    int v;
+    uint64_t elapsed = now_ns() - s->switched_ns;
+    bool read = get_sensor_value(0, sn, &v);
+    bool changed = read && (only_new_mode(s, v) || (elapsed >= SMODE_SETTLE_MIN_MS * 1000000ull &&
+                                                    (v < s->stale_lo || v > s->stale_hi)));
+    if (read && !changed) {
+        if (v < s->stale_lo) s->stale_lo = v;
+        if (v > s->stale_hi) s->stale_hi = v;
+    }
+    bool timed_out = elapsed >= SMODE_SETTLE_MAX_MS * 1000000ull;
+    if (!changed && !timed_out) return false;
+    if (!changed) s->timeouts++;
+    hist_record(&s->first_value, elapsed);
+    s->settling = false;
+    return true;
+}
+
+bool smode_start(uint8_t sn) {
+    if (sn >= SENSOR_DESC__LIMIT_) return false;
+    return !sensors[sn].pending || start_switch(sn);
+}
+
+bool smode_ensure(uint8_t sn) {
+    if (!smode_start(sn)) return false;
+    while (!poll_settled(sn)) usleep(SMODE_POLL_US);
+    return true;
+}
+
+int smode_start_all(void) {
+    int switched = 0;
+    for (int sn = 0; sn < SENSOR_DESC__LIMIT_; sn++) {
+        if (sensors[sn].pending && start_switch((uint8_t)sn)) switched++;
+    }
+    return switched;
+}
+
+int smode_apply(void) {
+    int switched = smode_start_all(), settling = 0;
+    do {
+        settling = 0;
+        for (int sn = 0; sn < SENSOR_DESC__LIMIT_; sn++) {
+            if (!poll_settled((uint8_t)sn)) settling++;
+        }
+        if (settling) usleep(SMODE_POLL_US);
+    } while (settling);
+    return switched;
+}
+
+bool smode_ready(uint8_t sn) {
+    if (sn >= SENSOR_DESC__LIMIT_) return false;
+    return !sensors[sn].pending && poll_settled(sn);
+}
+
+const char* smode_current(uint8_t sn) {
+    return sn < SENSOR_DESC__LIMIT_ ? current_mode(sn) : NULL;
+}
+
+// ---------- Statistics ----------
+void smode_print_stats(FILE* out) {
+    fprintf(out, "--- Sensor modes ---\n");
+    for (int sn = 0; sn < SENSOR_DESC__LIMIT_; sn++) {
+        const smode_sensor_t* s = &sensors[sn];
+        if (!s->wanted) continue;
+        fprintf(out, "sensor %d (%s): %u switches, %u skipped, %u failed, %u settled by timeout\n", sn,
+                s->current ? s->current : "?", s->switches, s->skipped, s->failures, s->timeouts);
+        if (s->switches) hist_print(&s->first_value, out, "  first new value", 1000000, "ms");
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef SENSOR_MODES_H
+#define SENSOR_MODES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Sensor mode manager. Tracks the mode each sensor is in and only writes
+// the mode attribute when the wanted mode differs, since an EV3 UART
+// sensor needs tens of milliseconds after a switch before its values are
+// from the new mode.
+//
+// Modes are requested up front and applied lazily: the first read through
+// smode_ensure() switches that one sensor and waits for it. smode_apply()
+// instead issues every pending switch back to back and then waits for all
+// sensors together, so N switches cost about one settling time instead of
+// N. A sensor counts as settled at its first value that only the new mode
+// can report (e.g. reflectance 42 after COL-COLOR), else at the first value
+// outside all values read since the switch once SMODE_SETTLE_MIN_MS have
+// passed, or after SMODE_SETTLE_MAX_MS if no value tells the modes apart.
+//
+// A sensor's current mode is read from sysfs on first use; the mode it
+// powers up in, or one another program left, is never assumed.
+//
+// Mode strings must be string literals (they are stored as pointers).
+// A sensor's state is not locked: use each sensor from one thread.
+
+#define SMODE_SETTLE_MIN_MS 20
+#define SMODE_SETTLE_MAX_MS 100
+#define SMODE_POLL_US       1000
+
+// Optional store of known modes, e.g. the discovery manifest. Switches are
+// recorded there; its modes are only used when the sensor's mode cannot be
+// read.
+typedef const char* (*smode_known_fn)(uint8_t sn);
+typedef void (*smode_note_fn)(uint8_t sn, const char* mode);
+
+// --- Setup ---
+void smode_set_store(smode_known_fn known, smode_note_fn note);
+// Marks a switch as needed if the sensor is not already in 'mode'.
+void smode_request(uint8_t sn, const char* mode);
+
+// --- Switching ---
+// Applies a pending switch for this sensor and waits until it settled.
+// Cheap when there is nothing to do. False if the switch failed.
+bool smode_ensure(uint8_t sn);
+// Issues a pending switch without waiting; poll smode_ready() for the end.
+bool smode_start(uint8_t sn);
+// Issues all pending switches back to back without waiting, so they settle
+// while the caller does other work. Returns the number of sensors switched.
+int  smode_start_all(void);
+// As smode_start_all(), then waits for every sensor to settle.
+int  smode_apply(void);
+// Non-blocking: true once the sensor has a value from its current mode.
+bool smode_ready(uint8_t sn);
+const char* smode_current(uint8_t sn);      // NULL if unknown
+
+// --- Statistics ---
+// Switches made and skipped, and the time from each switch to the first
+// value from the new mode.
+void smode_print_stats(FILE* out);
+
+#endif // SENSOR_MODES_H
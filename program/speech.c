@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#ifndef SPEECH_NO_ESPEAK
+#include <espeak/speak_lib.h>
+#endif
+#include "spsc_ring.h"
+#include "histogram.h"
+#include "timing.h"
+#include "logger.h"
+#include "audio_cache.h"
+#include "speech.h"
+
+#define SPEECH_MAX_ENTRIES  32
+#define SPEECH_QUEUE_SLOTS  16
+#define SPEECH_SYNTH_RATE   22050   // rate of the stand-in; espeak reports its own
+
+typedef struct {
+    char text[SPEECH_MAX_TEXT];
+    int16_t speed, pitch;
+    uint64_t t_ns;
+} speech_req_t;
+
+typedef struct {
+    uint32_t hash;              // 0 = empty slot
+    char text[SPEECH_MAX_TEXT];
+    int16_t speed, pitch;
+    int16_t* pcm;               // at audio_rate()
+    size_t frames;
+    bool pinned;                // prerendered, never evicted
+    _Atomic int refs;           // playbacks still using pcm
+    uint64_t last_used;
+} speech_entry_t;
+
+// The cache is shared by the worker and speech_prerender(); the audio thread
+// only drops references.
+static speech_entry_t entries[SPEECH_MAX_ENTRIES];
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t cache_budget = 0;
+static size_t cache_bytes = 0;
+static uint64_t use_clock = 0;
+
+static spsc_ring_t req_ring;
+static pthread_mutex_t say_lock = PTHREAD_MUTEX_INITIALIZER;    // producer side of req_ring
+static speech_req_t req_slots[SPEECH_QUEUE_SLOTS];
+static sem_t req_sem;
+static pthread_t worker_thread;
+static _Atomic bool running = false;
+static _Atomic int outstanding = 0;         // said but not finished playing
+
+static unsigned synth_rate = SPEECH_SYNTH_RATE;
+static uint64_t hits = 0, misses = 0, evictions = 0, failures = 0;
+static _Atomic uint64_t dropped = 0;
+static histogram_t synth_hist;              // time to synthesize a miss
+static histogram_t queue_hist;              // speech_say() to audio queue
+
+// ---------- Synthesis ----------
+#ifndef SPEECH_NO_ESPEAK
+static int16_t* synth_buf = NULL;
+static size_t synth_len = 0, synth_cap = 0;
+
+static int synth_callback(short* wav, int samples, espeak_EVENT* events) {
+    (void)events;
+    if (!wav || samples <= 0) return 0;
+    if (synth_len + (size_t)samples > synth_cap) {
+        size_t cap = synth_cap ? synth_cap : 8192;
+        while (cap < synth_len + (size_t)samples) cap *= 2;
+        int16_t* grown = realloc(synth_buf, cap * sizeof(int16_t));
+        if (!grown) return 1;   // abort synthesis
+        synth_buf = grown;
+        synth_cap = cap;
+    }
+    memcpy(synth_buf + synth_len, wav, (size_t)samples * sizeof(int16_t));
+    synth_len += (size_t)samples;
+    return 0;
+}
+
+static bool synth_open(void) {
+    int rate = espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 0, NULL, 0);
+    if (rate <= 0) {
+        log_error("speech: espeak_Initialize failed\n");
+        return false;
+    }
+    synth_rate = (unsigned)rate;
+    espeak_SetSynthCallback(synth_callback);
+    return true;
+}
+
+static void synth_close(void) {
+    espeak_Terminate();
+    free(synth_buf);
+    synth_buf = NULL;
+    synth_len = synth_cap = 0;
+}
+
+// Returns malloc'd PCM at synth_rate.
+static int16_t* synth_text(const char* text, int speed, int pitch, size_t* frames) {
+    synth_len = 0;
+    espeak_SetParameter(espeakRATE, speed, 0);
+    espeak_SetParameter(espeakPITCH, pitch, 0);
+    if (espeak_Synth(text, strlen(text) + 1, 0, POS_CHARACTER, 0, espeakCHARS_AUTO, NULL, NULL) != EE_OK ||
+        synth_len == 0) {
+        return NULL;
+    }
+    int16_t* pcm = malloc(synth_len * sizeof(int16_t));
+    if (pcm) memcpy(pcm, synth_buf, synth_len * sizeof(int16_t));
+    *frames = synth_len;
+    return pcm;
+}
+#else
+static bool synth_open(void) {
+    synth_rate = SPEECH_SYNTH_RATE;
+    return true;
+}
+
+static void synth_close(void) {
+}
+
+// Stand-in: one triangle-wave blip per word, pitch sets the tone and speed
+// the word length, so timing and cache behaviour match the real thing.
+static int16_t* synth_text(const char* text, int speed, int pitch, size_t* frames) {
+    int words = 0;
+    for (const char* p = text; *p; p++) {
+        if (*p != ' ' && (p == text || p[-1] == ' ')) words++;
+    }
+    if (words == 0) return NULL;
+    size_t word_frames = (size_t)synth_rate * 60 / (speed > 0 ? (size_t)speed : 1);
+    size_t gap_frames = word_frames / 4;
+    size_t n = (size_t)words * (word_frames + gap_frames);
+    int16_t* pcm = calloc(n, sizeof(int16_t));
+    if (!pcm) return NULL;
+    unsigned period = synth_rate / (200 + (unsigned)pitch * 4);
+    for (int w = 0; w < words; w++) {
+        int16_t* out = pcm + (size_t)w * (word_frames + gap_frames);
+        for (size_t i = 0; i < word_frames; i++) {
+            unsigned ph = (unsigned)(i % period) * 4 * 8000 / period;   // 0 .. 32000
+            int s = ph < 16000 ? (int)ph - 8000 : 24000 - (int)ph;
+            out[i] = (int16_t)s;
+        }
+    }
+    *frames = n;
+    return pcm;
+}
+#endif
+
+// ---------- Cache ----------
+static uint32_t phrase_hash(const char* text, int speed, int pitch) {
+    uint32_t h = 2166136261u;   // FNV-1a
+    for (const char* p = text; *p; p++) h = (h ^ (uint8_t)*p) * 16777619u;
+    h = (h ^ (uint16_t)speed) * 16777619u;
+    h = (h ^ (uint16_t)pitch) * 16777619u;
+    return h ? h : 1;
+}
+
+static speech_entry_t* cache_find(uint32_t hash, const char* text, int speed, int pitch) {
+    for (int i = 0; i < SPEECH_MAX_ENTRIES; i++) {
+        speech_entry_t* e = &entries[i];
+        if (e->hash == hash && e->speed == speed && e->pitch == pitch && strcmp(e->text, text) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void cache_free_entry(speech_entry_t* e) {
+    cache_bytes -= e->frames * sizeof(int16_t);
+    free(e->pcm);
+    e->pcm = NULL;
+    e->hash = 0;
+}
+
+// Least recently used entry that is neither pinned nor playing.
+static speech_entry_t* cache_victim(void) {
+    speech_entry_t* victim = NULL;
+    for (int i = 0; i < SPEECH_MAX_ENTRIES; i++) {
+        speech_entry_t* e = &entries[i];
+        if (!e->hash || e->pinned || atomic_load(&e->refs) > 0) continue;
+        if (!victim || e->last_used < victim->last_used) victim = e;
+    }
+    return victim;
+}
+
+// Makes room for 'bytes' and returns a free slot, or NULL.
+static speech_entry_t* cache_reserve(size_t bytes) {
+    while (cache_bytes + bytes > cache_budget) {
+        speech_entry_t* victim = cache_victim();
+        if (!victim) break;     // everything left is pinned or playing; go over budget
+        cache_free_entry(victim);
+        evictions++;
+    }
+    for (int i = 0; i < SPEECH_MAX_ENTRIES; i++) {
+        if (!entries[i].hash) return &entries[i];
+    }
+    speech_entry_t* victim = cache_victim();
+    if (victim) {
+        cache_free_entry(victim);
+        evictions++;
+    }
+    return victim;
+}
+
+// Finds or synthesizes a phrase. Call with cache_lock held.
+static speech_entry_t* cache_get(const char* text, int speed, int pitch) {
+    uint32_t hash = phrase_hash(text, speed, pitch);
+    speech_entry_t* e = cache_find(hash, text, speed, pitch);
+    if (e) {
+        hits++;
+        e->last_used = ++use_clock;
+        return e;
+    }
+    misses++;
+
+    uint64_t t0 = now_ns();
+    size_t raw_frames = 0, frames = 0;
+    int16_t* raw = synth_text(text, speed, pitch, &raw_frames);
+    int16_t* pcm = raw ? audio_resample(raw, raw_frames, synth_rate, &frames) : NULL;
+    free(raw);
+    hist_record(&synth_hist, now_ns() - t0);
+    if (!pcm || frames == 0) {
+        free(pcm);
+        failures++;
+        log_warn("speech: could not synthesize \"%s\"\n", text);
+        return NULL;
+    }
+
+    e = cache_reserve(frames * sizeof(int16_t));
+    if (!e) {
+        free(pcm);
+        failures++;
+        return NULL;
+    }
+    snprintf(e->text, sizeof(e->text), "%s", text);
+    e->hash = hash;
+    e->speed = (int16_t)speed;
+    e->pitch = (int16_t)pitch;
+    e->pcm = pcm;
+    e->frames = frames;
+    e->pinned = false;
+    atomic_store(&e->refs, 0);
+    e->last_used = ++use_clock;
+    cache_bytes += frames * sizeof(int16_t);
+    return e;
+}
+
+// ---------- Worker ----------
+// Runs on the audio thread once a phrase stopped playing.
+static void playback_done(void* ctx) {
+    speech_entry_t* e = ctx;
+    atomic_fetch_sub(&e->refs, 1);
+    atomic_fetch_sub(&outstanding, 1);
+}
+
+static void speak_request(const speech_req_t* req) {
+    pthread_mutex_lock(&cache_lock);
+    speech_entry_t* e = cache_get(req->text, req->speed, req->pitch);
+    if (e) atomic_fetch_add(&e->refs, 1);
+    pthread_mutex_unlock(&cache_lock);
+
+    if (e) {
+        hist_record(&queue_hist, now_ns() - req->t_ns);
+        if (audio_play_buffer(e->pcm, e->frames, playback_done, e)) return;
+        atomic_fetch_sub(&e->refs, 1);
+    }
+    atomic_fetch_sub(&outstanding, 1);
+}
+
+static void* speech_main(void* arg) {
+    (void)arg;
+    speech_req_t req;
+    while (true) {
+        sem_wait(&req_sem);
+        if (!atomic_load_explicit(&running, memory_order_acquire)) break;
+        while (spsc_pop(&req_ring, &req)) speak_request(&req);
+    }
+    return NULL;
+}
+
+// ---------- Lifecycle ----------
+bool speech_init(size_t cache_budget_bytes) {
+    if (atomic_load(&running)) return true;
+    cache_budget = cache_budget_bytes;
+    cache_bytes = 0;
+    memset(entries, 0, sizeof(entries));
+    hist_reset(&synth_hist);
+    hist_reset(&queue_hist);
+    if (!synth_open()) return false;
+
+    spsc_init(&req_ring, req_slots, sizeof(speech_req_t), SPEECH_QUEUE_SLOTS);
+    sem_init(&req_sem, 0, 0);
+    atomic_store(&running, true);
+    if (pthread_create(&worker_thread, NULL, speech_main, NULL) != 0) {
+        atomic_store(&running, false);
+        sem_destroy(&req_sem);
+        synth_close();
+        return false;
+    }
+    return true;
+}
+
+// Call after audio_shutdown(), which releases every buffer still playing.
+void speech_shutdown(void) {
+    if (!atomic_load(&running)) return;
+    atomic_store_explicit(&running, false, memory_order_release);
+    sem_post(&req_sem);
+    pthread_join(worker_thread, NULL);
+    sem_destroy(&req_sem);
+    synth_close();
+
+    for (int i = 0; i < SPEECH_MAX_ENTRIES; i++) {
+        if (!entries[i].hash) continue;
+        if (atomic_load(&entries[i].refs) > 0) {
+            log_warn("speech: \"%s\" still playing at shutdown\n", entries[i].text);
+            continue;   // leak rather than free under the audio thread
+        }
+        cache_free_entry(&entries[i]);
+    }
+}
+
+// ---------- Speaking ----------
+bool speech_prerender(const char* text, int speed, int pitch) {
+    if (!atomic_load(&running) || !text) return false;
+    char key[SPEECH_MAX_TEXT];
+    snprintf(key, sizeof(key), "%s", text);
+    pthread_mutex_lock(&cache_lock);
+    speech_entry_t* e = cache_get(key, speed, pitch);
+    if (e) e->pinned = true;
+    pthread_mutex_unlock(&cache_lock);
+    return e != NULL;
+}
+
+bool speech_say(const char* text, int speed, int pitch) {
+    if (!atomic_load_explicit(&running, memory_order_relaxed) || !text) return false;
+    // The ring has one producer side; callers take turns on it.
+    pthread_mutex_lock(&say_lock);
+    speech_req_t* req = spsc_reserve(&req_ring);
+    if (!req) {
+        pthread_mutex_unlock(&say_lock);
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    snprintf(req->text, sizeof(req->text), "%s", text);
+    req->speed = (int16_t)speed;
+    req->pitch = (int16_t)pitch;
+    req->t_ns = now_ns();
+    atomic_fetch_add(&outstanding, 1);
+    spsc_commit(&req_ring);
+    pthread_mutex_unlock(&say_lock);
+    sem_post(&req_sem);
+    return true;
+}
+
+bool speech_busy(void) {
+    return atomic_load(&outstanding) > 0;
+}
+
+// ---------- Statistics ----------
+void speech_print_stats(FILE* out) {
+    int count = 0, pinned = 0;
+    pthread_mutex_lock(&cache_lock);
+    for (int i = 0; i < SPEECH_MAX_ENTRIES; i++) {
+        if (!entries[i].hash) continue;
+        count++;
+        if (entries[i].pinned) pinned++;
+    }
+    fprintf(out, "--- Speech stats ---\n");
+    fprintf(out, "%d phrases cached (%d pinned), %zu/%zu bytes\n", count, pinned, cache_bytes, cache_budget);
+    fprintf(out, "%llu hits, %llu misses, %llu evictions, %llu failures, %llu dropped\n",
+            (unsigned long long)hits, (unsigned long long)misses, (unsigned long long)evictions,
+            (unsigned long long)failures, (unsigned long long)atomic_load(&dropped));
+    hist_print(&synth_hist, out, "synthesis", 1000, "us");
+    hist_print(&queue_hist, out, "say->audio queue", 1000, "us");
+    pthread_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,37 @@
+#ifndef SPEECH_H
+#define SPEECH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// In-process text-to-speech. Phrases are synthesized with the espeak
+// library on a worker thread (no fork/exec of the espeak binary) and the PCM
+// is kept in an LRU cache keyed by (text, speed, pitch) under a memory
+// budget, so repeated announcements cost only a cache lookup. Playback goes
+// through the audio cache thread; speech_say() does not wait for synthesis
+// or playback, but may briefly block on the producer lock: it may be called
+// from several threads (the navigator's stages), and a short lock serializes
+// them. The worker side stays lock-free.
+//
+// Build with -DSPEECH_NO_ESPEAK to use a tone stand-in instead of libespeak.
+
+#define SPEECH_MAX_TEXT     64
+#define SPEECH_DEFAULT_SPEED 160   // words per minute
+#define SPEECH_DEFAULT_PITCH 50    // 0-99
+
+// --- Lifecycle (audio_init() must have succeeded first) ---
+bool speech_init(size_t cache_budget_bytes);
+void speech_shutdown(void);
+
+// --- Speaking ---
+// Synthesizes into the cache synchronously; the entry is pinned. Use at startup.
+bool speech_prerender(const char* text, int speed, int pitch);
+// Queues a phrase; returns false if the request queue is full.
+bool speech_say(const char* text, int speed, int pitch);
+bool speech_busy(void);                 // queued, synthesizing or playing
+
+// --- Statistics ---
+void speech_print_stats(FILE* out);
+
+#endif // SPEECH_H
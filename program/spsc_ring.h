@@ -0,0 +1,87 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-producer/single-consumer ring of fixed-size slots. The caller owns
+// the slot storage (usually a static array), capacity must be a power of two.
+// Producer: spsc_reserve() -> fill slot -> spsc_commit().
+// Consumer: spsc_peek()    -> read slot -> spsc_release().
+
+typedef struct {
+    _Atomic size_t head;            // next slot to write (producer)
+    char pad0[64 - sizeof(size_t)];
+    _Atomic size_t tail;            // next slot to read (consumer)
+    char pad1[64 - sizeof(size_t)];
+    unsigned char* slots;
+    size_t elem_size;
+    size_t mask;
+} spsc_ring_t;
+
+static inline bool spsc_init(spsc_ring_t* r, void* storage, size_t elem_size, size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) return false;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->slots = (unsigned char*)storage;
+    r->elem_size = elem_size;
+    r->mask = capacity - 1;
+    return true;
+}
+
+static inline size_t spsc_capacity(const spsc_ring_t* r) {
+    return r->mask + 1;
+}
+
+static inline size_t spsc_size(spsc_ring_t* r) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    return head - tail;
+}
+
+// Returns a free slot or NULL if the ring is full. Never blocks.
+static inline void* spsc_reserve(spsc_ring_t* r) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail > r->mask) return NULL;
+    return r->slots + (head & r->mask) * r->elem_size;
+}
+
+static inline void spsc_commit(spsc_ring_t* r) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+// Returns the oldest filled slot or NULL if the ring is empty.
+static inline void* spsc_peek(spsc_ring_t* r) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (tail == head) return NULL;
+    return r->slots + (tail & r->mask) * r->elem_size;
+}
+
+static inline void spsc_release(spsc_ring_t* r) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+// Copy-in / copy-out helpers for small message types.
+static inline bool spsc_push(spsc_ring_t* r, const void* elem) {
+    void* slot = spsc_reserve(r);
+    if (!slot) return false;
+    __builtin_memcpy(slot, elem, r->elem_size);
+    spsc_commit(r);
+    return true;
+}
+
+static inline bool spsc_pop(spsc_ring_t* r, void* elem) {
+    void* slot = spsc_peek(r);
+    if (!slot) return false;
+    __builtin_memcpy(elem, slot, r->elem_size);
+    spsc_release(r);
+    return true;
+}
+
+#endif // SPSC_RING_H
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "ev3.h"
+#include "ev3_tacho.h"
+#include "scheduler.h"
+#include "histogram.h"
+#include "timing.h"
+#include "logger.h"
+#include "stall_watch.h"
+
+typedef struct {
+    uint8_t sn[2];
+    int setpoint[2];
+    bool armed;
+    bool tripped;
+    uint32_t generation;        // bumped by every arm and disarm
+    uint64_t armed_ns;
+    uint64_t low_since_ns[2];   // 0 = speed currently fine
+    stall_event_t event;
+} stall_state_t;
+
+static scheduler_t watch_sched;
+static stall_state_t state;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tripped_cond;
+static bool active = false;
+
+static uint64_t trips = 0, polls = 0, read_errors = 0;
+static histogram_t detect_hist;
+
+// ---------- Detection ----------
+// 'generation' is the motion the samples were taken for. The motors are
+// stopped under the lock, so a motion disarmed or re-armed since then is
+// left alone; arming waits out the two stop commands at most.
+static void trip(stall_state_t* s, uint32_t generation, uint8_t reason, int motor, int speed, uint64_t onset_ns) {
+    pthread_mutex_lock(&lock);
+    if (s->armed && !s->tripped && s->generation == generation) {
+        // Stop first, bookkeeping after: every ms here is spent pushing.
+        set_tacho_command_inx(s->sn[0], TACHO_STOP);
+        set_tacho_command_inx(s->sn[1], TACHO_STOP);
+        uint64_t t = now_ns();
+        s->tripped = true;
+        s->event = (stall_event_t){ .reason = reason, .motor = (uint8_t)motor, .speed = speed,
+                                    .setpoint = s->setpoint[motor], .t_ns = t,
+                                    .detect_us = (uint32_t)((t - onset_ns) / 1000) };
+        trips++;
+        hist_record(&detect_hist, t - onset_ns);
+        pthread_cond_broadcast(&tripped_cond);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+// Tracks how long motor m has been too slow; true once that is confirmed.
+// Under the lock with the rest of the state, and only for the motion the
+// samples were taken for (arming clears the timers).
+static bool confirm_low(stall_state_t* s, uint32_t generation, int m, bool low, uint64_t t, uint64_t* onset_ns) {
+    bool confirmed = false;
+    pthread_mutex_lock(&lock);
+    if (s->generation == generation) {
+        if (!low) {
+            s->low_since_ns[m] = 0;
+        } else if (!s->low_since_ns[m]) {
+            s->low_since_ns[m] = t;
+        } else if (t - s->low_since_ns[m] >= (uint64_t)STALL_CONFIRM_MS * 1000000ull) {
+            *onset_ns = s->low_since_ns[m];
+            confirmed = true;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return confirmed;
+}
+
+static bool watch_task(void* arg) {
+    stall_state_t* s = arg;
+    pthread_mutex_lock(&lock);
+    bool armed = s->armed && !s->tripped;
+    int setpoint[2] = { s->setpoint[0], s->setpoint[1] };
+    uint32_t generation = s->generation;
+    uint64_t armed_ns = s->armed_ns;
+    pthread_mutex_unlock(&lock);
+    if (!armed) return true;
+
+    polls++;
+    uint64_t t = now_ns();
+    bool in_grace = t - armed_ns < (uint64_t)STALL_GRACE_MS * 1000000ull;
+    for (int m = 0; m < 2; m++) {
+        if (setpoint[m] == 0) continue;
+        FLAGS_T flags = TACHO_STATE__NONE_;
+        int speed = 0;
+        if (!get_tacho_state_flags(s->sn[m], &flags) || !get_tacho_speed(s->sn[m], &speed)) {
+            read_errors++;
+            continue;
+        }
+        if (flags & TACHO_STALLED) {
+            trip(s, generation, STALL_KERNEL, m, speed, t);
+            return true;
+        }
+        // Only a motor that should be cruising is checked: not while spinning
+        // up, ramping, or after the move finished on its own.
+        bool cruising = (flags & TACHO_RUNNING) && !(flags & TACHO_RAMPING) && !in_grace;
+        bool low = cruising && abs(setpoint[m]) >= STALL_MIN_SPEED &&
+                   abs(speed) * 100 < abs(setpoint[m]) * STALL_SPEED_PERCENT;
+        uint64_t onset_ns;
+        if (confirm_low(s, generation, m, low, t, &onset_ns)) {
+            trip(s, generation, STALL_SPEED_DROP, m, speed, onset_ns);
+            return true;
+        }
+    }
+    return true;
+}
+
+// ---------- Lifecycle ----------
+bool stall_watch_start(uint8_t sn_left, uint8_t sn_right) {
+    if (active) return true;
+    memset(&state, 0, sizeof(state));
+    state.sn[0] = sn_left;
+    state.sn[1] = sn_right;
+    hist_reset(&detect_hist);
+    trips = polls = read_errors = 0;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&tripped_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    sched_init(&watch_sched);
+    sched_add(&watch_sched, "stall-watch", STALL_WATCH_PERIOD_US, 0, watch_task, &state);
+    if (!sched_start(&watch_sched)) {
+        pthread_cond_destroy(&tripped_cond);
+        return false;
+    }
+    active = true;
+    return true;
+}
+
+void stall_watch_stop(void) {
+    if (!active) return;
+    sched_stop(&watch_sched);
+    pthread_cond_destroy(&tripped_cond);
+    active = false;
+}
+
+bool stall_watch_active(void) {
+    return active;
+}
+
+// ---------- Arming ----------
+void stall_watch_arm(int left_sp, int right_sp) {
+    pthread_mutex_lock(&lock);
+    state.setpoint[0] = left_sp;
+    state.setpoint[1] = right_sp;
+    state.low_since_ns[0] = state.low_since_ns[1] = 0;
+    state.armed_ns = now_ns();
+    state.tripped = false;
+    memset(&state.event, 0, sizeof(state.event));
+    state.generation++;
+    state.armed = true;
+    pthread_mutex_unlock(&lock);
+}
+
+void stall_watch_update(int left_sp, int right_sp) {
+    pthread_mutex_lock(&lock);
+    state.setpoint[0] = left_sp;
+    state.setpoint[1] = right_sp;
+    pthread_mutex_unlock(&lock);
+}
+
+void stall_watch_disarm(void) {
+    pthread_mutex_lock(&lock);
+    state.armed = false;
+    state.generation++;
+    pthread_mutex_unlock(&lock);
+}
+
+bool stall_watch_wait(uint32_t timeout_ms) {
+    if (!active) {
+        struct timespec ts = { timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L };
+        nanosleep(&ts, NULL);
+        return false;
+    }
+    struct timespec deadline = ns_to_timespec(now_ns() + (uint64_t)timeout_ms * 1000000ull);
+    pthread_mutex_lock(&lock);
+    while (!state.tripped) {
+        if (pthread_cond_timedwait(&tripped_cond, &lock, &deadline) != 0) break;
+    }
+    bool tripped = state.tripped;
+    pthread_mutex_unlock(&lock);
+    return tripped;
+}
+
+bool stall_watch_tripped(void) {
+    pthread_mutex_lock(&lock);
+    bool tripped = state.tripped;
+    pthread_mutex_unlock(&lock);
+    return tripped;
+}
+
+bool stall_watch_event(stall_event_t* ev) {
+    pthread_mutex_lock(&lock);
+    bool tripped = state.tripped;
+    if (tripped) *ev = state.event;
+    pthread_mutex_unlock(&lock);
+    return tripped;
+}
+
+// ---------- Statistics ----------
+const char* stall_reason_name(uint8_t reason) {
+    switch (reason) {
+        case STALL_NONE:       return "none";
+        case STALL_KERNEL:     return "stalled";
+        case STALL_SPEED_DROP: return "speed drop";
+    }
+    return "?";
+}
+
+void stall_watch_print_stats(FILE* out) {
+    fprintf(out, "--- Stall watch ---\n");
+    fprintf(out, "%llu trips, %llu polls, %llu read errors\n", (unsigned long long)trips,
+            (unsigned long long)polls, (unsigned long long)read_errors);
+    hist_print(&detect_hist, out, "onset->stop", 1000, "us");
+    sched_print_stats(&watch_sched, out);
+}
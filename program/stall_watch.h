@@ -0,0 +1,58 @@
+#ifndef STALL_WATCH_H
+#define STALL_WATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Motor stall / collision watchdog. A 200 Hz scheduler thread streams the
+// tacho state flags and speed of both drive motors while a motion is armed.
+// It trips when the kernel reports a stall, or when a running motor stays
+// well below its commanded speed, then stops both motors itself so the
+// robot does not keep pushing until the motion's timer runs out.
+//
+// Motion primitives in sensor_methods.c arm the watch and wait through
+// stall_watch_wait(), so a trip also ends their wait early.
+
+#define STALL_WATCH_PERIOD_US   5000
+#define STALL_GRACE_MS          150     // ignore speed while spinning up
+#define STALL_CONFIRM_MS        30      // low speed must persist this long
+#define STALL_SPEED_PERCENT     40      // "low" = below this share of the setpoint
+#define STALL_MIN_SPEED         50      // slower setpoints are not speed-checked
+
+typedef enum {
+    STALL_NONE,
+    STALL_KERNEL,               // tacho state reported "stalled"
+    STALL_SPEED_DROP,           // speed below setpoint for STALL_CONFIRM_MS
+} stall_reason_t;
+
+typedef struct {
+    uint8_t reason;             // stall_reason_t
+    uint8_t motor;              // 0 = left, 1 = right
+    int speed;                  // deg/s when tripped
+    int setpoint;
+    uint64_t t_ns;              // when the motors were stopped
+    uint32_t detect_us;         // first suspicious sample -> stop
+} stall_event_t;
+
+// --- Lifecycle ---
+bool stall_watch_start(uint8_t sn_left, uint8_t sn_right);
+void stall_watch_stop(void);
+bool stall_watch_active(void);
+
+// --- Arming (control thread) ---
+// Setpoints in deg/s, sign ignored; 0 means that motor is not checked.
+void stall_watch_arm(int left_sp, int right_sp);
+// New setpoints for a motion whose speed is streamed; keeps the grace period.
+void stall_watch_update(int left_sp, int right_sp);
+void stall_watch_disarm(void);
+// Sleeps up to timeout_ms; returns true early if the watch tripped.
+bool stall_watch_wait(uint32_t timeout_ms);
+bool stall_watch_tripped(void);                 // since the last arm
+bool stall_watch_event(stall_event_t* ev);      // details of that trip
+
+// --- Statistics ---
+const char* stall_reason_name(uint8_t reason);
+void stall_watch_print_stats(FILE* out);
+
+#endif // STALL_WATCH_H
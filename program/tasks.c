@@ -0,0 +1,119 @@
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include "timing.h"
+#include "tasks.h"
+
+// ---------- Heap ----------
+static bool before(const tasks_t* ts, int a, int b) {
+    const task_t* x = &ts->tasks[a];
+    const task_t* y = &ts->tasks[b];
+    return x->wake_ns < y->wake_ns || (x->wake_ns == y->wake_ns && x->seq < y->seq);
+}
+
+static void heap_push(tasks_t* ts, int id) {
+    ts->tasks[id].seq = ts->seq++;
+    int i = ts->heap_len++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!before(ts, id, ts->heap[parent])) break;
+        ts->heap[i] = ts->heap[parent];
+        i = parent;
+    }
+    ts->heap[i] = id;
+}
+
+static int heap_pop(tasks_t* ts) {
+    int top = ts->heap[0];
+    int last = ts->heap[--ts->heap_len];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= ts->heap_len) break;
+        if (child + 1 < ts->heap_len && before(ts, ts->heap[child + 1], ts->heap[child])) child++;
+        if (!before(ts, ts->heap[child], last)) break;
+        ts->heap[i] = ts->heap[child];
+        i = child;
+    }
+    ts->heap[i] = last;
+    return top;
+}
+
+// ---------- Setup ----------
+void tasks_init(tasks_t* ts) {
+    memset(ts, 0, sizeof(*ts));
+}
+
+int tasks_add(tasks_t* ts, const char* name, task_fn fn, void* ctx) {
+    if (ts->count >= TASKS_MAX || !fn) return -1;
+    int id = ts->count++;
+    task_t* t = &ts->tasks[id];
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->fn = fn;
+    t->ctx = ctx;
+    t->poll_ns = TASK_POLL_US * 1000ull;
+    t->wake_ns = now_ns();
+    heap_push(ts, id);
+    return id;
+}
+
+void tasks_set_poll(tasks_t* ts, int id, uint32_t poll_us) {
+    if (id >= 0 && id < ts->count && poll_us > 0) ts->tasks[id].poll_ns = poll_us * 1000ull;
+}
+
+bool tasks_done(const tasks_t* ts, int id) {
+    return id < 0 || id >= ts->count || ts->tasks[id].done;
+}
+
+// ---------- Running ----------
+static void sleep_until(uint64_t deadline_ns) {
+    struct timespec ts = ns_to_timespec(deadline_ns);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+void tasks_run(tasks_t* ts) {
+    ts->stop = false;
+    uint64_t start = now_ns();
+    while (!ts->stop && ts->heap_len > 0) {
+        task_t* t = &ts->tasks[ts->heap[0]];
+        uint64_t now = now_ns();
+        if (t->wake_ns > now) {
+            sleep_until(t->wake_ns);
+            uint64_t woke = now_ns();
+            ts->idle_ns += woke - now;
+            now = woke;
+        }
+        int id = heap_pop(ts);
+        hist_record(&t->late, now - t->wake_ns);
+        t->now = now;
+        task_status_t status = t->fn(t, t->ctx);
+        uint64_t end = now_ns();
+        hist_record(&t->run_ns, end - now);
+        t->resumes++;
+        ts->switches++;
+        if (status == TASK_DONE) t->done = true;
+        else heap_push(ts, id);
+    }
+    ts->run_ns += now_ns() - start;
+}
+
+void tasks_stop(tasks_t* ts) {
+    ts->stop = true;
+}
+
+// ---------- Statistics ----------
+void tasks_print_stats(const tasks_t* ts, FILE* out) {
+    fprintf(out, "--- Tasks ---\n");
+    double busy = ts->run_ns > ts->idle_ns ? (double)(ts->run_ns - ts->idle_ns) : 0.0;
+    fprintf(out, "%d tasks, %llu switches in %.1f s, %.0f%% idle, %.2f us busy per switch\n", ts->count,
+            (unsigned long long)ts->switches, ts->run_ns / 1e9, ts->run_ns ? 100.0 * ts->idle_ns / ts->run_ns : 0.0,
+            ts->switches ? busy / 1000.0 / ts->switches : 0.0);
+    for (int i = 0; i < ts->count; i++) {
+        const task_t* t = &ts->tasks[i];
+        fprintf(out, "%s: %llu resumes%s\n", t->name, (unsigned long long)t->resumes, t->done ? ", done" : "");
+        hist_print(&t->late, out, "  late", 1000, "us");
+        hist_print(&t->run_ns, out, "  run", 1000, "us");
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "histogram.h"
+
+// Cooperative tasks on one thread (protothreads). A task is a function that
+// the scheduler calls again each time the task resumes; the TASK_* macros
+// below turn it into a sequence of steps with waits in between:
+//
+//     static task_status_t scan(task_t* t, void* ctx) {
+//         scan_t* s = ctx;
+//         TASK_BEGIN(t);
+//         start_tank_turn(200, 360);
+//         TASK_AWAIT(t, !motors_running());
+//         TASK_SLEEP_MS(t, 500);
+//         TASK_END(t);
+//     }
+//
+// A wait saves the line to come back to and returns to the scheduler, so a
+// switch is one function return and one call, with no stack per task. The
+// scheduler keeps the waiting tasks in a heap ordered by the time each is
+// due and sleeps until the earliest one.
+//
+// Rules that come with stackless tasks:
+// - Locals do not survive a wait; keep state in ctx.
+// - Waits only in the task function itself, not in functions it calls.
+// - No waits inside a switch statement, and at most one per source line.
+
+#define TASKS_MAX           16
+#define TASK_POLL_US        10000       // default re-check period of TASK_AWAIT
+
+typedef enum {
+    TASK_WAITING,                       // resume at wake_ns
+    TASK_DONE,
+} task_status_t;
+
+typedef struct task task_t;
+typedef task_status_t (*task_fn)(task_t* t, void* ctx);
+
+struct task {
+    const char* name;
+    task_fn fn;
+    void* ctx;
+    int line;                           // resume point, 0 = start
+    uint64_t now;                       // when the current resume started
+    uint64_t wake_ns;                   // next resume
+    uint64_t deadline;                  // for TASK_AWAIT_MS
+    uint64_t poll_ns;                   // TASK_AWAIT re-check period
+    uint64_t seq;                       // FIFO order among equal wake times
+    bool done;
+
+    uint64_t resumes;
+    histogram_t late;                   // ns resumed after wake_ns
+    histogram_t run_ns;                 // ns per resume
+};
+
+typedef struct {
+    task_t tasks[TASKS_MAX];
+    int count;
+    int heap[TASKS_MAX];                // waiting tasks by (wake_ns, seq)
+    int heap_len;
+    uint64_t seq;
+    bool stop;
+
+    uint64_t switches;
+    uint64_t run_ns;
+    uint64_t idle_ns;                   // asleep waiting for the next task
+} tasks_t;
+
+// --- Task body macros ---
+#define TASK_BEGIN(t)       switch ((t)->line) { case 0:
+#define TASK_END(t)         } (t)->line = 0; return TASK_DONE
+
+// Ends the task from anywhere in its body.
+#define TASK_EXIT(t)        do { (t)->line = 0; return TASK_DONE; } while (0)
+
+// Lets every other task that is due run first.
+#define TASK_YIELD(t) \
+    do { (t)->wake_ns = (t)->now; (t)->line = __LINE__; return TASK_WAITING; case __LINE__:; } while (0)
+
+#define TASK_SLEEP_MS(t, ms) \
+    do { (t)->wake_ns = (t)->now + (uint64_t)(ms) * 1000000ull; (t)->line = __LINE__; return TASK_WAITING; \
+         case __LINE__:; } while (0)
+
+// Re-checks cond every poll period until it holds.
+#define TASK_AWAIT(t, cond) \
+    do { (t)->line = __LINE__; __attribute__((fallthrough)); case __LINE__: \
+         if (!(cond)) { (t)->wake_ns = (t)->now + (t)->poll_ns; return TASK_WAITING; } } while (0)
+
+// As TASK_AWAIT, giving up after ms; TASK_TIMED_OUT() tells which it was.
+#define TASK_AWAIT_MS(t, cond, ms) \
+    do { (t)->deadline = (t)->now + (uint64_t)(ms) * 1000000ull; (t)->line = __LINE__; \
+         __attribute__((fallthrough)); case __LINE__: \
+         if (!(cond) && (t)->now < (t)->deadline) { \
+             (t)->wake_ns = (t)->now + (t)->poll_ns < (t)->deadline ? (t)->now + (t)->poll_ns : (t)->deadline; \
+             return TASK_WAITING; } } while (0)
+#define TASK_TIMED_OUT(t)   ((t)->now >= (t)->deadline)
+
+// --- Setup ---
+void tasks_init(tasks_t* ts);
+// Returns the task id, or -1 if the table is full. The task first runs on
+// the next tasks_run() pass.
+int  tasks_add(tasks_t* ts, const char* name, task_fn fn, void* ctx);
+void tasks_set_poll(tasks_t* ts, int id, uint32_t poll_us);
+bool tasks_done(const tasks_t* ts, int id);
+
+// --- Running ---
+// Runs until every task has ended or tasks_stop() is called from a task.
+void tasks_run(tasks_t* ts);
+void tasks_stop(tasks_t* ts);
+
+// --- Statistics ---
+void tasks_print_stats(const tasks_t* ts, FILE* out);
+
+#endif // TASKS_H
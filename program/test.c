@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>         // ← for INT_MAX
 #include <stdint.h>         // ← for uint8_t
@@ -6,6 +7,19 @@
 #include "ev3_sensor.h"
 #include "ev3_tacho.h"
 #include "sensor_methods.h"
+#include "discovery.h"
+#include "gyro_service.h"
+#include "logger.h"
+#include "scheduler.h"
+#include "event_loop.h"
+#include "gestures.h"
+#include "timing.h"
+#include "filters.h"
+#include "stall_watch.h"
+#include "motion_profile.h"
+#include "line_follow.h"
+#include "tasks.h"
+#include "latency_stats.h"
 
 
 #define Sleep(ms) usleep((ms) * 1000)
@@ -29,8 +43,21 @@ static bool check_back_button_once() {
     return false;
 }
 
+static void on_back_changed(void* ctx, uint8_t keys, uint8_t changed, uint64_t t_ns) {
+    (void)t_ns;
+    if ((changed & EV3_KEY_BACK) && !(keys & EV3_KEY_BACK)) evloop_stop(ctx);
+}
+
 static void wait_until_back_released() {
-    printf("...release BACK button to continue.\n");
+    log_info("...release BACK button to continue.\n");
+    evloop_t loop;
+    if (evloop_init(&loop) && evloop_add_buttons(&loop, NULL, on_back_changed, &loop) >= 0) {
+        if (evloop_keys(&loop) & EV3_KEY_BACK) evloop_run(&loop);
+        evloop_close(&loop);
+        return;
+    }
+    // No input device: fall back to polling
+    evloop_close(&loop);
     while (is_button_pressed(EV3_KEY_BACK)) {
         Sleep(100);
     }
@@ -38,44 +65,44 @@ static void wait_until_back_released() {
 
 // --- Helper Methods ---
 static void wait_and_print_sensor(const char* test_name, const char* label, bool (*read_fn)(uint8_t, int*), uint8_t sensor) {
-    printf("Starting test. Press BACK to skip.\n");
+    log_info("Starting test. Press BACK to skip.\n");
     for (int i = 0; i < 25; i++) {
         if (check_back_button_once()) {
-            printf("\n%s test skipped.\n", test_name);
+            log_info("\n%s test skipped.\n", test_name);
             wait_until_back_released();
             return;
         }
         int value;
         if (read_fn(sensor, &value)) {
-            printf("\r%s: %-5d", label, value);
-            fflush(stdout);
+            log_info("\r%s: %-5d", label, value);
         }
         Sleep(300);
     }
-    printf("\n");
+    log_info("\n");
 }
 
 static void display_color_sensor_readings(uint8_t sensors[], int count) {
-    printf("Starting test. Press BACK to skip.\n");
+    log_info("Starting test. Press BACK to skip.\n");
     for (int i = 0; i < 25; i++) {
         if (check_back_button_once()) {
-            printf("\nColor sensor test skipped.\n");
+            log_info("\nColor sensor test skipped.\n");
             wait_until_back_released();
             return;
         }
+        char line[MAX_SENSORS * 24 + 1];
+        int len = 0;
         for (int j = 0; j < count; j++) {
             int value;
             if (get_color_value(sensors[j], &value)) {
-                printf("Sensor %d: %-7s | ", j + 1, color_names[value]);
+                len += snprintf(line + len, sizeof(line) - len, "Sensor %d: %-7s | ", j + 1, color_names[value]);
             } else {
-                printf("Sensor %d: ERROR    | ", j + 1);
+                len += snprintf(line + len, sizeof(line) - len, "Sensor %d: ERROR    | ", j + 1);
             }
         }
+        log_info("%s\r", line);
         Sleep(500);
-        printf("\r");
-        fflush(stdout);
     }
-    printf("\n");
+    log_info("\n");
 }
 
 // --- Device Testing Methods ---
@@ -92,28 +119,68 @@ static void test_color_sensors() {
     }
 }
 
-static void test_buttons() {
-    printf("\n--- Testing Buttons ---\nPress buttons to see their names.\nPress BACK to finish this test.\n");
-    while (true) {
-        uint8_t keys;
-        ev3_read_keys(&keys);
-        if (keys) {
-            const char* name = get_button_name(keys);
-            if (name) {
-                printf("Pressed: %s\n", name);
-                if (keys & EV3_KEY_BACK) {
-                    wait_until_back_released();
-                    break;
-                }
-                while(is_button_pressed(keys)) {
-                    Sleep(50);
-                }
-            }
+typedef struct {
+    evloop_t loop;
+    gesture_t gestures;
+    int timer;                  // one-shot, armed for the next gesture deadline
+} button_test_t;
+
+static void report_gestures(button_test_t* bt) {
+    gesture_event_t ev;
+    char names[48];
+    while (gesture_poll(&bt->gestures, &ev)) {
+        if (ev.type == GESTURE_RELEASE) continue;
+        printf("%s: %s\n", gesture_type_name(ev.type), gesture_keys_name(ev.keys, names, sizeof(names)));
+        if (ev.type == GESTURE_PRESS && (ev.keys & EV3_KEY_BACK)) {
+            evloop_stop(&bt->loop);
         }
-        Sleep(50);
     }
 }
 
+// Wakes the loop only when a debounce or long-press timeout is due.
+static void arm_gesture_timer(button_test_t* bt, uint32_t now) {
+    uint32_t due, delay_us = 0;                 // 0 disarms while idle
+    if (gesture_next_deadline(&bt->gestures, &due)) {
+        int32_t ms = (int32_t)(due - now);
+        delay_us = ms >= 0 ? (uint32_t)(ms + 1) * 1000 : 1;
+    }
+    evloop_set_timer(&bt->loop, bt->timer, 0, delay_us);
+}
+
+static void on_test_button(void* ctx, uint8_t keys, uint8_t changed, uint64_t t_ns) {
+    button_test_t* bt = ctx;
+    (void)changed;
+    uint32_t t_ms = (uint32_t)(t_ns / 1000000ull);
+    gesture_input(&bt->gestures, keys, t_ms);
+    report_gestures(bt);
+    arm_gesture_timer(bt, t_ms);
+}
+
+static bool on_gesture_tick(void* ctx, uint64_t expirations) {
+    button_test_t* bt = ctx;
+    (void)expirations;
+    uint32_t t_ms = now_ms();
+    gesture_tick(&bt->gestures, t_ms);
+    report_gestures(bt);
+    arm_gesture_timer(bt, t_ms);
+    return true;
+}
+
+static void test_buttons() {
+    printf("\n--- Testing Buttons ---\nPress, hold, double-tap or combine buttons.\nPress BACK to finish this test.\n");
+    button_test_t bt;
+    gesture_init(&bt.gestures, NULL);
+    if (!evloop_init(&bt.loop) || evloop_add_buttons(&bt.loop, NULL, on_test_button, &bt) < 0 ||
+        (bt.timer = evloop_add_timer(&bt.loop, 0, 0, on_gesture_tick, &bt)) < 0) {
+        printf("Button input device not available.\n");
+        evloop_close(&bt.loop);
+        return;
+    }
+    evloop_run(&bt.loop);
+    evloop_close(&bt.loop);
+    wait_until_back_released();
+}
+
 static void test_motors() {
     printf("\n--- Testing Motors ---\n");
     if (check_back_button_once()) {
@@ -184,135 +251,308 @@ static void test_everything() {
 }
 
 // --- Compoud tests ---
-static void test_360_scan() {
-    printf("\n--- Testing 360° Scan ---\n");
-    uint8_t sn_gyro, sn_us;
-
-    if (!init_gyro(&sn_gyro, true)) {
-        printf("Gyro sensor not found.\n");
-        return;
-    }
-    if (!init_ultrasonic(&sn_us)) {
-        printf("Ultrasonic sensor not found.\n");
-        return;
-    }
-    if (!init_motors()) {
-        printf("Motors not found.\n");
-        return;
-    }
-
-    // Reset gyro to 0
-    reset_gyro(sn_gyro);
-    Sleep(1000);  // Allow reset to settle
-
-    printf("Starting 360° scan. Press BACK to abort.\n");
-
-    int min_dist = INT_MAX;
-    int min_angle = 0;
-
+// The 360° scan runs as three cooperative tasks on this thread: one drives
+// (turn, then head for the nearest object), one samples gyro and ultrasonic
+// every 30 ms, and one watches BACK. None of them blocks the others.
+typedef struct {
+    tasks_t* tasks;
+    uint8_t sn_gyro;
+    filtered_sensor_t us;
+    int angle;                  // last gyro reading
+    int dist_mm;                // last filtered distance, INT_MAX = none
+    int min_dist, min_angle;
+    bool scanning;              // sampler records the nearest echo
+    bool finished;
+    bool aborted;
+} scan_job_t;
+
+static task_status_t scan_drive_task(task_t* t, void* ctx) {
+    scan_job_t* j = ctx;
+    TASK_BEGIN(t);
     // Start rotation: clockwise
     set_tacho_speed_sp(left_motor,  200);
     set_tacho_speed_sp(right_motor, -200);
     set_tacho_command_inx(left_motor,  TACHO_RUN_FOREVER);
     set_tacho_command_inx(right_motor, TACHO_RUN_FOREVER);
+    j->scanning = true;
+    TASK_AWAIT(t, j->angle >= 360);
+    j->scanning = false;
+    stop_motors();
 
-    while (true) {
-        if (check_back_button_once()) {
-            printf("360° scan aborted.\n");
-            wait_until_back_released();
-            stop_motors();
-            return;
-        }
+    if (j->min_dist == INT_MAX) {
+        log_info("No object detected within range.\n");
+        j->finished = true;
+        TASK_EXIT(t);
+    }
+    log_info("Nearest object at %d°, %d mm away.\n", j->min_angle, j->min_dist);
 
-        int angle;
-        if (get_gyro_angle(sn_gyro, &angle)) {
-            int dist_cm;
-            if (get_distance_mm(sn_us, &dist_cm) && dist_cm < 255) {
-                int dist_mm = dist_cm * 10;
-                if (dist_mm < min_dist) {
-                    min_dist = dist_mm;
-                    min_angle = angle;
-                }
-            }
+    // Shortest turning direction
+    int turn_deg = (j->min_angle - j->angle + 360) % 360;
+    if (turn_deg > 180) turn_deg -= 360;
+    start_tank_turn(200, turn_deg);
+    TASK_AWAIT_MS(t, !motors_running(), 5000);
+    if (TASK_TIMED_OUT(t)) log_warn("scan: turn did not finish, approaching anyway\n");
 
-            if (angle >= 360) break;
-        }
+    log_info("Moving towards object...\n");
+    set_speed(200);
+    set_tacho_command_inx(left_motor,  TACHO_RUN_FOREVER);
+    set_tacho_command_inx(right_motor, TACHO_RUN_FOREVER);
+    TASK_AWAIT_MS(t, j->dist_mm <= 50, 15000);
+    stop_motors();
+    if (TASK_TIMED_OUT(t)) log_info("Object not reached, gave up.\n");
+    else log_info("Reached object.\n");
+    j->finished = true;
+    TASK_END(t);
+}
 
-        Sleep(30); // Smooth scan
+static task_status_t scan_sample_task(task_t* t, void* ctx) {
+    scan_job_t* j = ctx;
+    TASK_BEGIN(t);
+    while (!j->finished) {
+        get_gyro_angle(j->sn_gyro, &j->angle);
+        int dist_cm;
+        if (filtered_sensor_read(&j->us, &dist_cm)) {
+            j->dist_mm = dist_cm * 10;
+            if (j->scanning && j->dist_mm < j->min_dist) {
+                j->min_dist = j->dist_mm;
+                j->min_angle = j->angle;
+            }
+        }
+        TASK_SLEEP_MS(t, 30); // Smooth scan
     }
+    TASK_END(t);
+}
 
-    stop_motors();
+static task_status_t scan_abort_task(task_t* t, void* ctx) {
+    scan_job_t* j = ctx;
+    TASK_BEGIN(t);
+    TASK_AWAIT(t, j->finished || check_back_button_once());
+    if (!j->finished) {
+        j->aborted = true;
+        stop_motors();
+        tasks_stop(j->tasks);
+    }
+    TASK_END(t);
+}
 
-    if (min_dist < INT_MAX) {
-        printf("Nearest object at %d°, %d mm away.\n", min_angle, min_dist);
+static void test_360_scan() {
+    log_info("\n--- Testing 360° Scan ---\n");
+    uint8_t sn_us;
+    scan_job_t job = { .dist_mm = INT_MAX, .min_dist = INT_MAX };
 
-        // Determine shortest turning direction
-        int current_angle;
-        get_gyro_angle(sn_gyro, &current_angle);
-        int turn_deg = (min_angle - current_angle + 360) % 360;
-        if (turn_deg > 180) turn_deg -= 360;
+    if (!init_motors()) {
+        log_info("Motors not found.\n");
+        return;
+    }
+    // Heading integrated in software: no reset stall before the scan
+    if (!init_gyro_service(&job.sn_gyro)) {
+        log_info("Gyro sensor not found.\n");
+        return;
+    }
+    if (!init_ultrasonic(&sn_us)) {
+        log_info("Ultrasonic sensor not found.\n");
+        gyro_service_stop();
+        return;
+    }
 
-        tank_turn(200, turn_deg);
-        printf("Moving towards object...\n");
+    // Median of 3 drops single spurious echoes; out-of-range reads are ignored
+    filtered_sensor_init(&job.us, sn_us, get_distance_mm, 3, 0);
+    filtered_sensor_set_range(&job.us, 0, 254);
+
+    log_info("Starting 360° scan. Press BACK to abort.\n");
+    tasks_t tasks;
+    tasks_init(&tasks);
+    job.tasks = &tasks;
+    tasks_add(&tasks, "scan-drive", scan_drive_task, &job);
+    tasks_add(&tasks, "scan-sample", scan_sample_task, &job);
+    int watch = tasks_add(&tasks, "back-watch", scan_abort_task, &job);
+    tasks_set_poll(&tasks, watch, 50000);
+    tasks_run(&tasks);
+
+    if (job.aborted) {
+        log_info("360° scan aborted.\n");
+        wait_until_back_released();
+    }
+    stop_motors();
+    tasks_print_stats(&tasks, stdout);
+    if (gyro_service_active()) {
+        gyro_service_print_stats(stdout);
+        gyro_service_stop();
+    }
+}
 
-        while (true) {
-            int dist_cm;
-            if (get_distance_mm(sn_us, &dist_cm) && dist_cm * 10 > 50) {
-                move_for_time(200, 200); // Move forward in small steps
-            } else {
-                break;
-            }
-        }
+typedef struct {
+    uint8_t sn_color;
+    bool aborted;
+    bool stalled;
+} black_watch_t;
 
-        stop_motors();
-        printf("Reached object.\n");
-    } else {
-        printf("No object detected within range.\n");
+// Periodic task: keeps running until BACK is pressed, the robot runs into
+// something or black is seen
+static bool watch_for_black(void* arg) {
+    black_watch_t* w = arg;
+    if (check_back_button_once()) {
+        w->aborted = true;
+        return false;
+    }
+    if (stall_watch_tripped()) {
+        w->stalled = true;
+        return false;
     }
+    int color;
+    return !(get_color_value(w->sn_color, &color) && color == 1);
 }
 
 static void forward_until_black() {
-    printf("--- Moving Forward Until Black Detected ---\n"); // Added newline
+    log_info("--- Moving Forward Until Black Detected ---\n"); // Added newline
     uint8_t color_sensors[MAX_SENSORS];
     int count = init_all_color_sensors(color_sensors, MAX_SENSORS);
     if (count < 1) {
-        printf("No color sensor found.\n"); // Added newline
+        log_info("No color sensor found.\n"); // Added newline
         return;
     }
     // Initialize motors
     if (!init_motors()) { // Added motor initialization check
-        printf("Failed to initialize motors.\n"); // Added newline
+        log_info("Failed to initialize motors.\n"); // Added newline
         return;
     }
 
     uint8_t sn_color = color_sensors[0];
 
-    printf("Moving forward. Press BACK to abort.\n"); // Added newline
+    log_info("Moving forward. Press BACK to abort.\n"); // Added newline
+    stall_watch_start(left_motor, right_motor);
+    stall_watch_arm(200, 200);
     // drive forward
     set_tacho_speed_sp(left_motor,  200);
     set_tacho_speed_sp(right_motor, 200);
     set_tacho_command_inx(left_motor,  TACHO_RUN_FOREVER);
     set_tacho_command_inx(right_motor, TACHO_RUN_FOREVER);
 
-    // wait for black (color code 1)
-    while (true) {
-        if (check_back_button_once()) {
-            printf("Forward-until-black aborted.\n"); // Added newline
-            stop_motors();
-            wait_until_back_released();
-            return;
-        }
-        int color;
-        if (get_color_value(sn_color, &color) && color == 1) {
-            printf("Black detected. Stopping.\n"); // Added newline
-            break;
+    // wait for black (color code 1), sampled at a fixed 50 ms rate
+    black_watch_t watch = { .sn_color = sn_color, .aborted = false, .stalled = false };
+    scheduler_t sched;
+    sched_init(&sched);
+    sched_add(&sched, "black-watch", 50000, 0, watch_for_black, &watch);
+    sched_run(&sched);
+    stall_watch_disarm();
+
+    if (watch.aborted) {
+        log_info("Forward-until-black aborted.\n"); // Added newline
+        stop_motors();
+        stall_watch_stop();
+        wait_until_back_released();
+        return;
+    }
+    if (watch.stalled) {
+        stall_event_t ev;
+        stall_watch_event(&ev);
+        log_info("Hit an obstacle (%s, motor %d at %d/%d deg/s). Stopped.\n",
+                 stall_reason_name(ev.reason), ev.motor, ev.speed, ev.setpoint);
+    } else {
+        log_info("Black detected. Stopping.\n"); // Added newline
+    }
+    stop_motors();
+    sched_print_stats(&sched, stdout);
+    stall_watch_print_stats(stdout);
+    stall_watch_stop();
+}
+
+
+// Drives one tile out and back per profile and peak speed, and reports the
+// landing error from the tachos, the time taken and the heading change.
+// Slip shows up as heading drift and, over the repeats, as the robot walking
+// off its start mark, which has to be measured on the mat.
+static void bench_motion_profiles() {
+    log_info("\n--- Motion Profile Bench ---\n");
+    if (check_back_button_once()) {
+        log_info("Motion bench skipped.\n");
+        wait_until_back_released();
+        return;
+    }
+    if (!init_motors()) {
+        log_info("Failed to initialize motors.\n");
+        return;
+    }
+    uint8_t sn_gyro;
+    bool have_gyro = init_gyro_service(&sn_gyro);
+    stall_watch_start(left_motor, right_motor);
+
+    const int tile_deg = 253;
+    const motion_limits_t configs[] = {
+        { 200, 0, 0 }, { 400, 0, 0 },
+        { 400, 1000, 0 }, { 600, 1000, 0 },
+        { 400, 1000, 8000 }, { 600, 1000, 8000 },
+    };
+    log_info("%-10s %5s %8s %8s %8s\n", "profile", "v_max", "err deg", "time ms", "heading");
+    for (unsigned c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+        int err_sum = 0, err_max = 0, heading = 0;
+        uint64_t time_sum = 0;
+        motion_profile_t p;
+        motion_plan(&p, tile_deg, &configs[c]);
+        if (have_gyro) gyro_service_zero();
+        for (int dir = 1; dir >= -1; dir -= 2) {
+            int before = 0, after = 0;
+            get_tacho_position(left_motor, &before);
+            uint64_t t0 = now_ns();
+            bool ok = move_for_degrees_profiled(dir * tile_deg, &configs[c]);
+            time_sum += now_ns() - t0;
+            Sleep(200);
+            get_tacho_position(left_motor, &after);
+            int err = abs((after - before) - dir * tile_deg);
+            err_sum += err;
+            if (err > err_max) err_max = err;
+            if (!ok) log_warn("motion bench: move aborted\n");
         }
-        Sleep(50);
+        if (have_gyro) heading = gyro_service_angle();
+        log_info("%-10s %5d %4d/%-3d %8llu %8d\n", motion_profile_name(p.type), configs[c].v_max,
+                 err_sum / 2, err_max, (unsigned long long)(time_sum / 2000000ull), heading);
+        if (check_back_button_once()) break;
     }
     stop_motors();
+    stall_watch_stop();
+    if (have_gyro) gyro_service_stop();
 }
 
+static bool line_back_pressed(void* ctx) {
+    (void)ctx;
+    return check_back_button_once();
+}
 
+// Calibrates on the line, finds the fastest speed that still holds it, then
+// follows at 80% of that until BACK is pressed or the line ends.
+static void test_line_follow() {
+    log_info("\n--- Line Follow Test ---\n");
+    log_info("Place the robot on the line's left edge. Press BACK to skip.\n");
+    Sleep(2000);
+    if (check_back_button_once()) {
+        log_info("Line follow test skipped.\n");
+        wait_until_back_released();
+        return;
+    }
+    uint8_t color_sensors[MAX_SENSORS];
+    int count = init_all_color_sensors(color_sensors, MAX_SENSORS);
+    if (count < 1 || !init_motors()) {
+        log_info("Line follow needs a color sensor and both motors.\n");
+        return;
+    }
+    line_follower_t lf;
+    line_init(&lf, color_sensors, count, NULL);
+    if (!line_calibrate(&lf)) {
+        log_info("Calibration failed, is a sensor over the line?\n");
+        return;
+    }
+    stall_watch_start(left_motor, right_motor);
+    int max_speed = line_find_max_speed(&lf, 150, 700, 50, 2000);
+    if (max_speed > 0) {
+        lf.cfg.base_speed = max_speed * 4 / 5;
+        log_info("Following at %d deg/s. Press BACK to stop.\n", lf.cfg.base_speed);
+        line_result_t r = line_follow(&lf, 0, line_back_pressed, NULL);
+        log_info("Line follow ended: %s\n", line_result_name(r));
+    }
+    line_print_stats(&lf, stdout);
+    stall_watch_stop();
+    wait_until_back_released();
+}
 
 int main() {
     printf("============================\n");
@@ -325,11 +565,20 @@ int main() {
         return 1;
     }
     
-    ev3_sensor_init();
-    ev3_tacho_init();
+    if (discovery_init(NULL) == DISCOVERY_FAILED) {
+        printf("Error: device discovery failed.\n");
+        return 1;
+    }
+    discovery_print(stdout);
 
+    log_start();
     forward_until_black();
+    bench_motion_profiles();
+    test_line_follow();
+    log_stop();
+    lat_print_stats(stdout);
 
+    discovery_close();
     ev3_uninit();
     printf("\nTest suite finished.\n");
     return 0;
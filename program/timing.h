@@ -0,0 +1,25 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <time.h>
+
+// --- Monotonic Clock Helpers ---
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint32_t now_ms(void) {
+    return (uint32_t)(now_ns() / 1000000ull);
+}
+
+static inline struct timespec ns_to_timespec(uint64_t ns) {
+    struct timespec ts;
+    ts.tv_sec  = (time_t)(ns / 1000000000ull);
+    ts.tv_nsec = (long)(ns % 1000000000ull);
+    return ts;
+}
+
+#endif // TIMING_H
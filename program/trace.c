@@ -0,0 +1,104 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+typedef struct {
+    trace_event_t events[TRACE_RING_EVENTS];
+    uint64_t head;                      // spans ever recorded
+    const char* name;
+} trace_ring_t;
+
+volatile bool trace_on;
+static uint64_t trace_zero;
+
+// Rings are claimed once and kept, so a thread's spans outlive it.
+static trace_ring_t* rings[TRACE_MAX_THREADS];
+static atomic_int ring_count;
+static _Thread_local trace_ring_t* self;
+static _Thread_local bool refused;
+
+// ---------- Setup ----------
+void trace_enable(bool on) {
+    if (on && trace_zero == 0) trace_zero = now_ns();
+    trace_on = on;
+}
+
+static trace_ring_t* own_ring(void) {
+    if (self || refused) return self;
+    int slot = atomic_fetch_add(&ring_count, 1);
+    trace_ring_t* r = slot < TRACE_MAX_THREADS ? calloc(1, sizeof(*r)) : NULL;
+    if (!r) {
+        refused = true;
+        return NULL;
+    }
+    rings[slot] = r;
+    self = r;
+    return r;
+}
+
+void trace_thread_name(const char* name) {
+    trace_ring_t* r = own_ring();
+    if (r) r->name = name;
+}
+
+// ---------- Recording ----------
+void trace_span(const char* cat, const char* name, uint64_t start_ns, uint64_t end_ns) {
+    trace_ring_t* r = self ? self : own_ring();
+    if (!r) return;
+    trace_event_t* e = &r->events[r->head & (TRACE_RING_EVENTS - 1)];
+    e->name = name;
+    e->cat = cat;
+    e->start_ns = start_ns;
+    e->dur_ns = end_ns - start_ns;
+    r->head++;
+}
+
+// ---------- Export ----------
+static int ring_total(void) {
+    int n = atomic_load(&ring_count);
+    return n < TRACE_MAX_THREADS ? n : TRACE_MAX_THREADS;
+}
+
+bool trace_write_json(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (int t = 0; t < ring_total(); t++) {
+        const trace_ring_t* r = rings[t];
+        if (!r) continue;
+        int tid = t + 1;
+        if (r->name) {
+            fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", tid, r->name);
+            first = false;
+        }
+        uint64_t head = r->head;
+        uint64_t begin = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        for (uint64_t i = begin; i < head; i++) {
+            const trace_event_t* e = &r->events[i & (TRACE_RING_EVENTS - 1)];
+            if (e->start_ns < trace_zero) continue;
+            fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", e->name, e->cat, tid, (e->start_ns - trace_zero) / 1000.0,
+                    e->dur_ns / 1000.0);
+            first = false;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+void trace_print_stats(FILE* out) {
+    fprintf(out, "--- Trace ---\n");
+    for (int t = 0; t < ring_total(); t++) {
+        const trace_ring_t* r = rings[t];
+        if (!r) continue;
+        unsigned long long lost = r->head > TRACE_RING_EVENTS ? r->head - TRACE_RING_EVENTS : 0;
+        fprintf(out, "%-10s %llu spans, %llu overwritten\n", r->name ? r->name : "(unnamed)",
+                (unsigned long long)r->head, lost);
+    }
+    if (atomic_load(&ring_count) > TRACE_MAX_THREADS) {
+        fprintf(out, "(%d threads not traced)\n", atomic_load(&ring_count) - TRACE_MAX_THREADS);
+    }
+}
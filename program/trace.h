@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "timing.h"
+
+// Timeline tracing. Spans (a name, a category, a start and a duration) go
+// into a ring buffer owned by the recording thread, so recording takes no
+// lock: a clock read at each end and one small store (two pointers and two
+// timestamps, see trace_event_t). When a ring is full the oldest spans are
+// overwritten, so a long mission keeps its last TRACE_RING_EVENTS spans per
+// thread.
+//
+// After the run trace_write_json() exports everything in Chrome trace-event
+// format; open the file in Perfetto (ui.perfetto.dev) or chrome://tracing.
+// Export only once the traced threads have finished or are idle: a span
+// being written during the export can come out torn.
+//
+// Names and categories must be string literals (or otherwise outlive the
+// export); they are stored as pointers and written without escaping.
+
+#define TRACE_RING_EVENTS   8192        // per thread, power of two
+#define TRACE_MAX_THREADS   16
+#define TRACE_FILE          "/home/robot/nav_trace.json"
+
+typedef struct {
+    const char* name;
+    const char* cat;
+    uint64_t start_ns;
+    uint64_t dur_ns;
+} trace_event_t;
+
+// Spans are recorded only while tracing is on.
+extern volatile bool trace_on;
+
+// --- Setup ---
+// Turning tracing on the first time sets the zero of the timeline.
+void trace_enable(bool on);
+// Names the calling thread's row in the viewer.
+void trace_thread_name(const char* name);
+
+// --- Recording ---
+void trace_span(const char* cat, const char* name, uint64_t start_ns, uint64_t end_ns);
+
+typedef struct {
+    const char* cat;
+    const char* name;
+    uint64_t t0;                        // 0 = tracing was off at the start
+} trace_scope_t;
+
+static inline void trace_scope_end(trace_scope_t* s) {
+    if (s->t0) trace_span(s->cat, s->name, s->t0, now_ns());
+}
+
+// Records a span from here to the end of the enclosing block.
+#define TRACE_SCOPE(cat, name) \
+    trace_scope_t trace_scope_ __attribute__((cleanup(trace_scope_end))) = { cat, name, trace_on ? now_ns() : 0 }
+
+// --- Export ---
+bool trace_write_json(const char* path);
+void trace_print_stats(FILE* out);
+
+#endif // TRACE_H